@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MAX_ENDPOINTS 16
+#define RESPONSE_BUFFER 65536
+
+typedef struct {
+    const char *host;
+    const char *port;
+    const char *endpoint;
+    int keep_alive;
+    double duration;
+    struct addrinfo *addr;
+} LoadConfig;
+
+typedef struct {
+    const LoadConfig *config;
+    uint32_t *latencies_us;
+    size_t count;
+    size_t capacity;
+    unsigned long errors;
+    unsigned long connects;
+    unsigned long server_closes;  // Responses that came with Connection: close
+} Worker;
+
+static void usage() {
+    printf("Usage: loadgen [options] [endpoint ...]\n");
+    printf("Options:\n");
+    printf("  -H HOST     Server host (default: 127.0.0.1)\n");
+    printf("  -p PORT     Server port (default: 8080)\n");
+    printf("  -c N        Concurrent connections (default: 8)\n");
+    printf("  -d SECONDS  Duration per endpoint and mode (default: 5)\n");
+    printf("  -m MODE     keepalive, close or both (default: both)\n");
+    printf("Endpoints default to /, /api/network-info, /api/interface-stats,\n");
+    printf("/api/isp-info, /api/all and /metrics. Results are printed as JSON lines.\n");
+}
+
+static uint64_t now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int open_connection(const LoadConfig *config) {
+    int fd = socket(config->addr->ai_family, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, config->addr->ai_addr, config->addr->ai_addrlen) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Reads one response. Returns 1 if the connection can be reused, 0 if the
+// server closed it, -1 on error.
+static int read_response(int fd, char *buffer) {
+    size_t size = 0;
+    char *body = NULL;
+    long content_length = -1;
+    int server_closes = 0;
+
+    for (;;) {
+        ssize_t n = recv(fd, buffer + size, RESPONSE_BUFFER - 1 - size, 0);
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            return (body && content_length < 0) ? 0 : -1;
+        size += n;
+        buffer[size] = '\0';
+
+        if (!body) {
+            body = strstr(buffer, "\r\n\r\n");
+            if (!body)
+                continue;
+            body += 4;
+
+            char *length = strcasestr(buffer, "\r\nContent-Length:");
+            if (length && length < body)
+                content_length = strtol(length + 17, NULL, 10);
+            char *connection = strcasestr(buffer, "\r\nConnection: close");
+            server_closes = connection && connection < body;
+        }
+
+        if (content_length >= 0 && (long)(size - (body - buffer)) >= content_length)
+            return server_closes ? 0 : 1;
+
+        // Large bodies: keep only the headers around
+        if (size >= RESPONSE_BUFFER - 1 && content_length >= 0) {
+            content_length -= size - (body - buffer);
+            size = body - buffer;
+        }
+    }
+}
+
+static void record_latency(Worker *worker, uint64_t latency) {
+    if (worker->count == worker->capacity) {
+        worker->capacity = worker->capacity ? worker->capacity * 2 : 4096;
+        worker->latencies_us = realloc(worker->latencies_us, worker->capacity * sizeof(uint32_t));
+    }
+    worker->latencies_us[worker->count++] = latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency;
+}
+
+static void *worker_loop(void *arg) {
+    Worker *worker = (Worker *)arg;
+    const LoadConfig *config = worker->config;
+    char *buffer = malloc(RESPONSE_BUFFER);
+    char request[512];
+    int request_len = snprintf(request, sizeof(request),
+                               "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+                               config->endpoint, config->host,
+                               config->keep_alive ? "keep-alive" : "close");
+
+    uint64_t deadline = now_us() + (uint64_t)(config->duration * 1e6);
+    int fd = -1;
+
+    while (now_us() < deadline) {
+        uint64_t start = now_us();
+        if (fd < 0) {
+            fd = open_connection(config);
+            worker->connects++;
+            if (fd < 0) {
+                worker->errors++;
+                continue;
+            }
+        }
+
+        int reusable = -1;
+        if (send(fd, request, request_len, MSG_NOSIGNAL) == request_len)
+            reusable = read_response(fd, buffer);
+
+        if (reusable < 0) {
+            worker->errors++;
+        } else {
+            record_latency(worker, now_us() - start);
+            if (reusable == 0)
+                worker->server_closes++;
+        }
+        if (reusable != 1 || !config->keep_alive) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd >= 0)
+        close(fd);
+    free(buffer);
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t count, double p) {
+    if (count == 0)
+        return 0;
+    size_t index = (size_t)(p * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static void run_endpoint(LoadConfig *config, int concurrency) {
+    Worker *workers = calloc(concurrency, sizeof(Worker));
+    pthread_t *threads = calloc(concurrency, sizeof(pthread_t));
+
+    uint64_t start = now_us();
+    for (int i = 0; i < concurrency; i++) {
+        workers[i].config = config;
+        pthread_create(&threads[i], NULL, worker_loop, &workers[i]);
+    }
+
+    size_t total = 0;
+    unsigned long errors = 0, connects = 0, server_closes = 0;
+    for (int i = 0; i < concurrency; i++) {
+        pthread_join(threads[i], NULL);
+        total += workers[i].count;
+        errors += workers[i].errors;
+        connects += workers[i].connects;
+        server_closes += workers[i].server_closes;
+    }
+    double elapsed = (now_us() - start) / 1e6;
+
+    uint32_t *all = malloc((total ? total : 1) * sizeof(uint32_t));
+    size_t offset = 0;
+    for (int i = 0; i < concurrency; i++) {
+        memcpy(all + offset, workers[i].latencies_us, workers[i].count * sizeof(uint32_t));
+        offset += workers[i].count;
+        free(workers[i].latencies_us);
+    }
+    qsort(all, total, sizeof(uint32_t), compare_u32);
+
+    // A server that answers keep-alive requests with Connection: close makes
+    // every request reconnect, so the run really measured close mode
+    int honoured = !config->keep_alive || server_closes == 0;
+    if (!honoured)
+        fprintf(stderr, "loadgen: %s: keep-alive not honoured, %lu of %zu responses closed the "
+                        "connection\n", config->endpoint, server_closes, total);
+
+    printf("{\"bench\":\"loadgen\",\"endpoint\":\"%s\",\"mode\":\"%s\",\"concurrency\":%d,"
+           "\"requests\":%zu,\"errors\":%lu,\"connections\":%lu,\"server_closes\":%lu,"
+           "\"keepalive_honoured\":%s,\"rps\":%.1f,"
+           "\"p50_us\":%u,\"p99_us\":%u,\"p999_us\":%u,\"max_us\":%u}\n",
+           config->endpoint, config->keep_alive ? "keepalive" : "close", concurrency,
+           total, errors, connects, server_closes, honoured ? "true" : "false", total / elapsed,
+           percentile(all, total, 0.50), percentile(all, total, 0.99),
+           percentile(all, total, 0.999), total ? all[total - 1] : 0);
+    fflush(stdout);
+
+    free(all);
+    free(workers);
+    free(threads);
+}
+
+int main(int argc, char *argv[]) {
+    LoadConfig config = { "127.0.0.1", "8080", NULL, 0, 5.0, NULL };
+    const char *mode = "both";
+    int concurrency = 8;
+    const char *endpoints[MAX_ENDPOINTS];
+    int endpoint_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            config.host = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            config.port = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            concurrency = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            config.duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            usage();
+            return 0;
+        } else if (argv[i][0] == '/' && endpoint_count < MAX_ENDPOINTS) {
+            endpoints[endpoint_count++] = argv[i];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (endpoint_count == 0) {
+        endpoints[endpoint_count++] = "/";
+        endpoints[endpoint_count++] = "/api/network-info";
+        endpoints[endpoint_count++] = "/api/interface-stats";
+        endpoints[endpoint_count++] = "/api/isp-info";
+        endpoints[endpoint_count++] = "/api/all";
+        endpoints[endpoint_count++] = "/metrics";
+    }
+    if (concurrency < 1)
+        concurrency = 1;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(config.host, config.port, &hints, &config.addr) != 0) {
+        fprintf(stderr, "Cannot resolve %s:%s\n", config.host, config.port);
+        return 1;
+    }
+
+    for (int e = 0; e < endpoint_count; e++) {
+        config.endpoint = endpoints[e];
+        if (strcmp(mode, "close") != 0) {
+            config.keep_alive = 1;
+            run_endpoint(&config, concurrency);
+        }
+        if (strcmp(mode, "keepalive") != 0) {
+            config.keep_alive = 0;
+            run_endpoint(&config, concurrency);
+        }
+    }
+
+    freeaddrinfo(config.addr);
+    return 0;
+}
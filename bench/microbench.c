@@ -0,0 +1,1350 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <math.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+#include "../include/json.h"
+#include "../include/emit.h"
+#include "../include/network.h"
+#include "../include/server.h"
+#include "../include/history.h"
+#include "../include/log.h"
+#include "../include/shm_export.h"
+#include "../include/wireless.h"
+#include "../include/sockstat.h"
+#include "../include/tzdb.h"
+#include "../include/executor.h"
+#include "../include/arena.h"
+#include "../include/uring.h"
+#include "../include/metrics.h"
+#include "../include/fleet.h"
+
+// Each benchmark is calibrated to run for roughly this long
+#define BENCH_TARGET_NS 200000000ULL
+
+typedef void (*BenchFn)(void *ctx);
+
+// Counting allocator: these replace the C library's entry points for the
+// whole process, and count the calls a thread makes while it asks them to
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread int counting_heap_calls = 0;
+static __thread uint64_t heap_calls = 0;
+
+void *malloc(size_t size) {
+    heap_calls += counting_heap_calls;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    heap_calls += counting_heap_calls;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    heap_calls += counting_heap_calls;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    heap_calls += counting_heap_calls && ptr;
+    __libc_free(ptr);
+}
+
+static const char net_dev_fixture[] =
+    "Inter-|   Receive                                                |  Transmit\n"
+    " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+    "    lo: 8273645    91234    0    0    0     0          0         0  8273645    91234    0    0    0     0       0          0\n"
+    "  eth0: 2048123456 1934567    0   12    0     0          0      2345 1024987654  987654    0    0    0     0       0          0\n"
+    " wlan0: 987654321  765432    0    3    0     0          0       123 123456789  234567    0    0    0     0       0          0\n"
+    "docker0:  123456     1234    0    0    0     0          0         0   654321     4321    0    0    0     0       0          0\n"
+    "veth12ab:  98765      876    0    0    0     0          0         0    56789      567    0    0    0     0       0          0\n";
+
+static const char net_route_fixture[] =
+    "Iface\tDestination\tGateway \tFlags\tRefCnt\tUse\tMetric\tMask\t\tMTU\tWindow\tIRTT\n"
+    "eth0\t0002000A\t00000000\t0001\t0\t0\t100\t00FFFFFF\t0\t0\t0\n"
+    "docker0\t000011AC\t00000000\t0001\t0\t0\t0\t0000FFFF\t0\t0\t0\n"
+    "eth0\t00000000\t0102000A\t0003\t0\t0\t100\t00000000\t0\t0\t0\n";
+
+// Excerpts of zone1970.tab, iso3166.tab and tzdata.zi, malformed lines included
+static const char zone1970_fixture[] =
+    "# tzdb timezone descriptions\n"
+    "#codes\tcoordinates\tTZ\tcomments\n"
+    "AR\t-3436-05827\tAmerica/Argentina/Buenos_Aires\tBuenos Aires (BA, CF)\n"
+    "DE,DK,NO,SE,SJ\t+5230+01322\tEurope/Berlin\tmost of Germany\n"
+    "IN\t+2232+08822\tAsia/Kolkata\n"
+    "US\t+404251-0740023\tAmerica/New_York\tEastern (most areas)\n"
+    "XX\t+9999\tBroken/Coordinates\n"
+    "ZZ\n";
+
+static const char iso3166_fixture[] =
+    "# ISO 3166 alpha-2 country codes\n"
+    "AR\tArgentina\n"
+    "DE\tGermany\n"
+    "IN\tIndia\n"
+    "US\tUnited States\n";
+
+static const char tzdata_fixture[] =
+    "# version 2024a\n"
+    "R d 1916 o - Ap 30 23 1 S\n"
+    "Z Asia/Kolkata 5:53:28 - LMT 1854 Jun 28\n"
+    "L Asia/Kolkata Asia/Calcutta\n"
+    "L America/New_York US/Eastern\n"
+    "L US/Eastern Legacy/Eastern\n"
+    "L Etc/UTC UTC\n"
+    "L Europe/Berlin\n";
+
+// Generic-netlink messages as a kernel dump returns them, attributes the
+// parser does not use included (a test machine has no radio to record from)
+
+// NL80211_CMD_NEW_INTERFACE for wlp2s0 (ifindex 3, station mode, SSID "home-5g")
+static const unsigned char nl80211_interface_fixture[] = {
+    0x74, 0x00, 0x00, 0x00, 0x22, 0x00, 0x02, 0x00, 0xc2, 0xa1, 0xf0, 0x65,
+    0x92, 0x10, 0x00, 0x00, 0x07, 0x01, 0x00, 0x00, 0x08, 0x00, 0x03, 0x00,
+    0x03, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x04, 0x00, 0x77, 0x6c, 0x70, 0x32,
+    0x73, 0x30, 0x00, 0x00, 0x08, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x08, 0x00, 0x05, 0x00, 0x02, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x99, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x06, 0x00,
+    0x3c, 0x58, 0xc2, 0x1d, 0x7e, 0x90, 0x00, 0x00, 0x08, 0x00, 0x2e, 0x00,
+    0x05, 0x00, 0x00, 0x00, 0x05, 0x00, 0x53, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x08, 0x00, 0x26, 0x00, 0x3c, 0x14, 0x00, 0x00, 0x0b, 0x00, 0x34, 0x00,
+    0x68, 0x6f, 0x6d, 0x65, 0x2d, 0x35, 0x67, 0x00,
+};
+
+// NL80211_CMD_NEW_STATION for the access point of wlp2s0: signal -52 dBm (avg -54),
+// TX 866.7 / RX 780 Mbit/s VHT, 1234/4321 packets, 87 retries, 3 failures
+static const unsigned char nl80211_station_fixture[] = {
+    0x24, 0x01, 0x00, 0x00, 0x22, 0x00, 0x02, 0x00, 0xc2, 0xa1, 0xf0, 0x65,
+    0x92, 0x10, 0x00, 0x00, 0x13, 0x01, 0x00, 0x00, 0x08, 0x00, 0x03, 0x00,
+    0x03, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x06, 0x00, 0xa4, 0x2b, 0xb0, 0xd1,
+    0x13, 0x07, 0x00, 0x00, 0x08, 0x00, 0x2e, 0x00, 0x05, 0x00, 0x00, 0x00,
+    0xf4, 0x00, 0x15, 0x80, 0x08, 0x00, 0x01, 0x00, 0x0c, 0x00, 0x00, 0x00,
+    0x08, 0x00, 0x02, 0x00, 0x00, 0x00, 0x10, 0x00, 0x08, 0x00, 0x03, 0x00,
+    0x00, 0x00, 0x04, 0x00, 0x0c, 0x00, 0x17, 0x00, 0x00, 0x00, 0x10, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x18, 0x00, 0x00, 0x00, 0x04, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x07, 0x00, 0xcc, 0x00, 0x00, 0x00,
+    0x05, 0x00, 0x0d, 0x00, 0xca, 0x00, 0x00, 0x00, 0x14, 0x00, 0x19, 0x80,
+    0x05, 0x00, 0x00, 0x00, 0xce, 0x00, 0x00, 0x00, 0x05, 0x00, 0x01, 0x00,
+    0xc9, 0x00, 0x00, 0x00, 0x28, 0x00, 0x08, 0x80, 0x06, 0x00, 0x01, 0x00,
+    0xdb, 0x21, 0x00, 0x00, 0x08, 0x00, 0x05, 0x00, 0xdb, 0x21, 0x00, 0x00,
+    0x05, 0x00, 0x06, 0x00, 0x09, 0x00, 0x00, 0x00, 0x05, 0x00, 0x07, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x04, 0x00, 0x08, 0x00, 0x28, 0x00, 0x0e, 0x80,
+    0x08, 0x00, 0x05, 0x00, 0x78, 0x1e, 0x00, 0x00, 0x06, 0x00, 0x01, 0x00,
+    0x78, 0x1e, 0x00, 0x00, 0x05, 0x00, 0x06, 0x00, 0x08, 0x00, 0x00, 0x00,
+    0x05, 0x00, 0x07, 0x00, 0x02, 0x00, 0x00, 0x00, 0x04, 0x00, 0x08, 0x00,
+    0x08, 0x00, 0x09, 0x00, 0xe1, 0x10, 0x00, 0x00, 0x08, 0x00, 0x0a, 0x00,
+    0xd2, 0x04, 0x00, 0x00, 0x08, 0x00, 0x0b, 0x00, 0x57, 0x00, 0x00, 0x00,
+    0x08, 0x00, 0x0c, 0x00, 0x03, 0x00, 0x00, 0x00, 0x18, 0x00, 0x0f, 0x80,
+    0x04, 0x00, 0x02, 0x00, 0x05, 0x00, 0x04, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x06, 0x00, 0x05, 0x00, 0x64, 0x00, 0x00, 0x00, 0x08, 0x00, 0x10, 0x00,
+    0x10, 0x0e, 0x00, 0x00, 0x0c, 0x00, 0x11, 0x00, 0x7e, 0x00, 0x00, 0x00,
+    0x22, 0x00, 0x00, 0x00,
+};
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Runs fn until the calibrated iteration count takes about BENCH_TARGET_NS and
+// prints one JSON line per benchmark
+static void run_bench(const char *name, BenchFn fn, void *ctx) {
+    uint64_t iterations = 1;
+    uint64_t elapsed = 0;
+
+    for (;;) {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < iterations; i++)
+            fn(ctx);
+        elapsed = now_ns() - start;
+
+        if (elapsed >= BENCH_TARGET_NS / 4 || iterations >= (1ULL << 32))
+            break;
+        iterations *= 4;
+    }
+
+    double ns_per_op = (double)elapsed / iterations;
+    printf("{\"bench\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.1f,\"ops_per_sec\":%.0f}\n",
+           name, (unsigned long)iterations, ns_per_op, 1e9 / ns_per_op);
+    fflush(stdout);
+}
+
+static void bench_json_write_string_short(void *ctx) {
+    (void)ctx;
+    char body[256];
+    JSONWriter json;
+    json_writer_init(&json, body, sizeof(body));
+    json_begin_object(&json, NULL);
+    json_write_string(&json, "ipv4", "192.168.1.100");
+    json_write_string(&json, "gateway", "192.168.1.1");
+    json_end_object(&json);
+    json_writer_finish(&json);
+}
+
+static void bench_json_write_string_escaped(void *ctx) {
+    char body[4096];
+    JSONWriter json;
+    json_writer_init(&json, body, sizeof(body));
+    json_begin_object(&json, NULL);
+    json_write_string(&json, "payload", (const char *)ctx);
+    json_end_object(&json);
+    json_writer_finish(&json);
+}
+
+typedef struct {
+    JSONEscapeFn escape;
+    const char *input;
+    size_t length;
+    char *output;
+} EscapeBench;
+
+static void bench_json_escape(void *ctx) {
+    EscapeBench *bench = (EscapeBench *)ctx;
+    bench->escape(bench->output, bench->input, bench->length);
+}
+
+// Random strings biased towards characters that need escaping, at lengths
+// around the vector widths, checked byte for byte against the scalar path
+static int verify_escape_backends() {
+    static const char *backends[] = { "sse2", "avx2" };
+    static char input[1024];
+    static char expected[sizeof(input) * JSON_ESCAPE_MAX_EXPANSION];
+    static char actual[sizeof(input) * JSON_ESCAPE_MAX_EXPANSION];
+    const int cases = 200000;
+    int failures = 0;
+
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+        JSONEscapeFn escape = json_escape_backend(backends[b]);
+        if (!escape)
+            continue;
+
+        unsigned seed = 12345;
+        int mismatches = 0;
+        for (int c = 0; c < cases; c++) {
+            size_t length = rand_r(&seed) % (c % 10 == 0 ? sizeof(input) : 80);
+            for (size_t i = 0; i < length; i++) {
+                unsigned r = rand_r(&seed);
+                switch (r % 8) {
+                    case 0: input[i] = (char)(r >> 8) % 0x20; break;
+                    case 1: input[i] = "\"\\"[(r >> 8) & 1]; break;
+                    case 2: input[i] = (char)(0x80 | (r >> 8)); break;
+                    default: input[i] = (char)(0x20 + (r >> 8) % 0x5f); break;
+                }
+            }
+
+            size_t expected_length = json_escape_scalar(expected, input, length);
+            size_t actual_length = escape(actual, input, length);
+            if (expected_length != actual_length || memcmp(expected, actual, expected_length) != 0)
+                mismatches++;
+        }
+
+        printf("{\"check\":\"json_escape_equivalence\",\"backend\":\"%s\",\"cases\":%d,\"mismatches\":%d}\n",
+               backends[b], cases, mismatches);
+        failures += mismatches;
+    }
+    fflush(stdout);
+    return failures;
+}
+
+typedef struct {
+    atomic_int running;
+    long updates;
+} ShmWriter;
+
+static void *shm_writer_loop(void *arg) {
+    ShmWriter *writer = (ShmWriter *)arg;
+    SpeedTestResult result;
+    memset(&result, 0, sizeof(result));
+
+    while (atomic_load(&writer->running)) {
+        writer->updates++;
+        result.download_mbps = result.upload_mbps = result.ping_ms = (double)writer->updates;
+        result.test_time = writer->updates;
+        shm_export_speed_test(&result);
+    }
+    return NULL;
+}
+
+// Reads the segment through the header-only reader while another thread
+// keeps rewriting it; every snapshot must have all speed test fields equal
+static int verify_shm_seqlock(const char *name) {
+    NetdiagShmReader reader;
+    NetdiagStats stats;
+    ShmWriter writer = { 1, 0 };
+    pthread_t thread;
+    const int reads = 200000;
+    int torn = 0, failed = 0;
+
+    if (netdiag_shm_open(&reader, name) < 0) {
+        printf("{\"check\":\"shm_seqlock_consistency\",\"error\":\"open\"}\n");
+        return 1;
+    }
+
+    pthread_create(&thread, NULL, shm_writer_loop, &writer);
+    for (int i = 0; i < reads; i++) {
+        if (netdiag_shm_read(&reader, &stats) < 0) {
+            failed++;
+            continue;
+        }
+        double value = (double)stats.speed_test_time;
+        if (stats.download_mbps != value || stats.upload_mbps != value || stats.ping_ms != value)
+            torn++;
+    }
+    atomic_store(&writer.running, 0);
+    pthread_join(thread, NULL);
+    netdiag_shm_close(&reader);
+
+    printf("{\"check\":\"shm_seqlock_consistency\",\"reads\":%d,\"writes\":%ld,"
+           "\"torn\":%d,\"failed\":%d}\n", reads, writer.updates, torn, failed);
+    fflush(stdout);
+    return torn;
+}
+
+static void bench_shm_read(void *ctx) {
+    NetdiagStats stats;
+    netdiag_shm_read((const NetdiagShmReader *)ctx, &stats);
+}
+
+static void bench_json_write_numbers(void *ctx) {
+    (void)ctx;
+    char body[1024];
+    JSONWriter json;
+    json_writer_init(&json, body, sizeof(body));
+    json_begin_array(&json, NULL);
+    for (int i = 0; i < 16; i++) {
+        json_write_uint(&json, NULL, 1024987654321ULL + i);
+        json_write_number(&json, NULL, 85.456 * i);
+    }
+    json_end_array(&json);
+    json_writer_finish(&json);
+}
+
+// A traceroute-shaped document: strings, integers, doubles and booleans
+static void emit_sample_document(Emitter *out) {
+    emit_begin_object(out, NULL);
+    emit_string(out, "target", "8.8.8.8");
+    emit_int(out, "rounds", 12);
+    emit_begin_array(out, "hops");
+    for (int i = 0; i < 12; i++) {
+        emit_begin_object(out, NULL);
+        emit_int(out, "ttl", i + 1);
+        emit_string(out, "address", "192.168.100.254");
+        emit_int(out, "sent", 12);
+        emit_int(out, "received", 11);
+        emit_number(out, "loss_percent", 8.33);
+        emit_number(out, "avg_ms", 12.5 + i * 3.1);
+        emit_number(out, "stddev_ms", 0.75 * i);
+        emit_bool(out, "destination", i == 11);
+        emit_end_object(out);
+    }
+    emit_end_array(out);
+    emit_end_object(out);
+}
+
+static void bench_emit_sample(void *ctx) {
+    char body[4096];
+    Emitter out;
+    emitter_init(&out, *(Encoding *)ctx, body, sizeof(body));
+    emit_sample_document(&out);
+    emitter_finish(&out);
+}
+
+// Encodes RFC 8949 appendix A examples (single precision replaces the half
+// precision ones, which this encoder never produces) and checks that a
+// JSON+CBOR emitter writes exactly what two separate emitters would
+static int verify_cbor_encoding() {
+    static const struct {
+        const char *hex;
+        int kind;  // 0 uint, 1 int, 2 double, 3 bool, 4 null, 5 string
+        int64_t integer;
+        double number;
+        const char *text;
+    } vectors[] = {
+        { "00", 0, 0, 0, NULL },
+        { "17", 0, 23, 0, NULL },
+        { "1818", 0, 24, 0, NULL },
+        { "1903e8", 0, 1000, 0, NULL },
+        { "1a000f4240", 0, 1000000, 0, NULL },
+        { "1b000000e8d4a51000", 0, 1000000000000LL, 0, NULL },
+        { "20", 1, -1, 0, NULL },
+        { "3903e7", 1, -1000, 0, NULL },
+        { "fa3fc00000", 2, 0, 1.5, NULL },
+        { "fa47c35000", 2, 0, 100000.0, NULL },
+        { "fb3ff199999999999a", 2, 0, 1.1, NULL },
+        { "fbc010666666666666", 2, 0, -4.1, NULL },
+        { "f4", 3, 0, 0, NULL },
+        { "f5", 3, 1, 0, NULL },
+        { "f6", 4, 0, 0, NULL },
+        { "60", 5, 0, 0, "" },
+        { "6449455446", 5, 0, 0, "IETF" },
+    };
+    const int count = sizeof(vectors) / sizeof(vectors[0]);
+    int mismatches = 0;
+
+    for (int i = 0; i < count; i++) {
+        unsigned char buffer[32];
+        char hex[65];
+        CBORWriter cbor;
+        cbor_writer_init(&cbor, buffer, sizeof(buffer));
+        switch (vectors[i].kind) {
+            case 0: cbor_write_uint(&cbor, NULL, (uint64_t)vectors[i].integer); break;
+            case 1: cbor_write_int(&cbor, NULL, vectors[i].integer); break;
+            case 2: cbor_write_double(&cbor, NULL, vectors[i].number); break;
+            case 3: cbor_write_bool(&cbor, NULL, (int)vectors[i].integer); break;
+            case 4: cbor_write_null(&cbor, NULL); break;
+            default: cbor_write_string(&cbor, NULL, vectors[i].text); break;
+        }
+        for (size_t b = 0; b < cbor.size; b++)
+            sprintf(hex + 2 * b, "%02x", buffer[b]);
+        hex[2 * cbor.size] = '\0';
+        if (cbor_writer_finish(&cbor) < 0 || strcmp(hex, vectors[i].hex) != 0)
+            mismatches++;
+    }
+
+    // {_ "a": 1, "b": [_ 2, 3]}
+    static const unsigned char nested[] = {
+        0xbf, 0x61, 0x61, 0x01, 0x61, 0x62, 0x9f, 0x02, 0x03, 0xff, 0xff
+    };
+    unsigned char buffer[32];
+    CBORWriter cbor;
+    cbor_writer_init(&cbor, buffer, sizeof(buffer));
+    cbor_begin_map(&cbor, NULL);
+    cbor_write_uint(&cbor, "a", 1);
+    cbor_begin_array(&cbor, "b");
+    cbor_write_uint(&cbor, NULL, 2);
+    cbor_write_uint(&cbor, NULL, 3);
+    cbor_end_array(&cbor);
+    cbor_end_map(&cbor);
+    if (cbor_writer_finish(&cbor) < 0 || cbor.size != sizeof(nested) ||
+        memcmp(buffer, nested, sizeof(nested)) != 0)
+        mismatches++;
+
+    static char single[ENCODING_COUNT][4096], both[ENCODING_COUNT][4096];
+    size_t single_length[ENCODING_COUNT];
+    Emitter out;
+    for (int e = 0; e < ENCODING_COUNT; e++) {
+        emitter_init(&out, (Encoding)e, single[e], sizeof(single[e]));
+        emit_sample_document(&out);
+        if (emitter_finish(&out) < 0)
+            mismatches++;
+        emitter_data(&out, (Encoding)e, &single_length[e]);
+    }
+    emitter_init(&out, ENCODING_JSON, both[ENCODING_JSON], sizeof(both[ENCODING_JSON]));
+    emitter_add(&out, ENCODING_CBOR, both[ENCODING_CBOR], sizeof(both[ENCODING_CBOR]));
+    emit_sample_document(&out);
+    if (emitter_finish(&out) < 0)
+        mismatches++;
+    for (int e = 0; e < ENCODING_COUNT; e++) {
+        size_t length;
+        emitter_data(&out, (Encoding)e, &length);
+        if (length != single_length[e] || memcmp(both[e], single[e], length) != 0)
+            mismatches++;
+    }
+
+    printf("{\"check\":\"cbor_encoding\",\"cases\":%d,\"mismatches\":%d,"
+           "\"sample_json_bytes\":%zu,\"sample_cbor_bytes\":%zu}\n",
+           count + 1 + ENCODING_COUNT, mismatches,
+           single_length[ENCODING_JSON], single_length[ENCODING_CBOR]);
+    fflush(stdout);
+    return mismatches;
+}
+
+static int verify_encoding_negotiation() {
+    static const struct {
+        const char *accept;
+        Encoding expected;
+    } cases[] = {
+        { "", ENCODING_JSON },
+        { "*/*", ENCODING_JSON },
+        { "application/json", ENCODING_JSON },
+        { "application/cbor", ENCODING_CBOR },
+        { "Application/CBOR", ENCODING_CBOR },
+        { "application/cbor, application/json;q=0.9", ENCODING_CBOR },
+        { "application/json, application/cbor;q=0.5", ENCODING_JSON },
+        { "application/cbor;q=0, */*", ENCODING_JSON },
+        { "application/json;q=0.1, */*", ENCODING_CBOR },
+        { "text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8", ENCODING_JSON },
+        { "application/json, application/cbor", ENCODING_CBOR },
+        { "text/plain", ENCODING_JSON },
+    };
+    const int count = sizeof(cases) / sizeof(cases[0]);
+    int mismatches = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (encoding_negotiate(cases[i].accept) != cases[i].expected)
+            mismatches++;
+    }
+
+    printf("{\"check\":\"encoding_negotiation\",\"cases\":%d,\"mismatches\":%d}\n",
+           count, mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+static void bench_parse_net_dev(void *ctx) {
+    (void)ctx;
+    InterfaceStats stats;
+    FILE *fp = fmemopen((void *)net_dev_fixture, sizeof(net_dev_fixture) - 1, "r");
+    parse_net_dev(fp, &stats);
+    fclose(fp);
+}
+
+static void bench_parse_net_route(void *ctx) {
+    (void)ctx;
+    char gateway[64];
+    FILE *fp = fmemopen((void *)net_route_fixture, sizeof(net_route_fixture) - 1, "r");
+    parse_net_route(fp, gateway);
+    fclose(fp);
+}
+
+static int load_tz_fixtures(TzIndex *index) {
+    const char *texts[] = { zone1970_fixture, iso3166_fixture, tzdata_fixture };
+    int (*loaders[])(TzIndex *, FILE *) = {
+        tz_index_load_zones, tz_index_load_countries, tz_index_load_links,
+    };
+    tz_index_init(index);
+    for (int i = 0; i < 3; i++) {
+        FILE *fp = fmemopen((void *)texts[i], strlen(texts[i]), "r");
+        int added = loaders[i](index, fp);
+        fclose(fp);
+        if (added < 0)
+            return -1;
+    }
+    return tz_index_finish(index);
+}
+
+// Zones, links (chained too), coordinates with and without seconds, and
+// names that must not resolve
+static int verify_tzdb() {
+    int mismatches = 0;
+    TzIndex index;
+    TzLocation location;
+    if (load_tz_fixtures(&index) < 0 || index.entry_count != 8)
+        mismatches++;
+
+    if (tz_lookup(&index, "America/Argentina/Buenos_Aires", &location) != 0 ||
+        strcmp(location.country, "Argentina") != 0 ||
+        fabs(location.latitude - (-34.6)) > 1e-9 || fabs(location.longitude - (-58.45)) > 1e-9)
+        mismatches++;
+    if (tz_lookup(&index, "Europe/Berlin", &location) != 0 ||
+        strcmp(location.country_code, "DE") != 0 || strcmp(location.country, "Germany") != 0)
+        mismatches++;
+    if (tz_lookup(&index, "Asia/Calcutta", &location) != 0 ||
+        strcmp(location.zone, "Asia/Kolkata") != 0 || strcmp(location.country, "India") != 0)
+        mismatches++;
+    if (tz_lookup(&index, "Legacy/Eastern", &location) != 0 ||
+        strcmp(location.zone, "America/New_York") != 0 ||
+        fabs(location.latitude - (40 + 42 / 60.0 + 51 / 3600.0)) > 1e-9 ||
+        fabs(location.longitude - -(74 + 0 / 60.0 + 23 / 3600.0)) > 1e-9)
+        mismatches++;
+
+    const char *unknown[] = { "UTC", "Etc/UTC", "Broken/Coordinates", "Europe", "" };
+    for (size_t i = 0; i < sizeof(unknown) / sizeof(unknown[0]); i++) {
+        if (tz_lookup(&index, unknown[i], &location) == 0)
+            mismatches++;
+    }
+    tz_index_free(&index);
+
+    printf("{\"check\":\"tzdb\",\"cases\":9,\"mismatches\":%d}\n", mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+static void bench_tz_lookup(void *ctx) {
+    TzLocation location;
+    tz_lookup(ctx, "Asia/Calcutta", &location);
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int released;
+    int ran;
+    int discarded;
+} LaneProbe;
+
+static LaneProbe lane_probe = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0 };
+
+// Blocks until released, so the queue behind it fills up
+static void lane_probe_run(void *item) {
+    (void)item;
+    pthread_mutex_lock(&lane_probe.lock);
+    lane_probe.ran++;
+    pthread_cond_broadcast(&lane_probe.changed);
+    while (!lane_probe.released)
+        pthread_cond_wait(&lane_probe.changed, &lane_probe.lock);
+    pthread_mutex_unlock(&lane_probe.lock);
+}
+
+static void lane_probe_discard(void *item) {
+    (void)item;
+    pthread_mutex_lock(&lane_probe.lock);
+    lane_probe.discarded++;
+    pthread_mutex_unlock(&lane_probe.lock);
+}
+
+// Token buckets on a synthetic clock, then a lane whose workers are all
+// busy: the queue must take exactly its capacity, and stopping must discard
+// what is still queued
+static int verify_executor() {
+    int mismatches = 0;
+    RateLimiter limiter;
+
+    // 6 per minute: one token every 10 s, burst of 2
+    rate_limiter_init(&limiter, 6, 2);
+    uint64_t now = 1000;
+    if (rate_limiter_take(&limiter, 1, now) != 0 || rate_limiter_take(&limiter, 1, now) != 0)
+        mismatches++;
+    if (rate_limiter_take(&limiter, 1, now) != 10000)
+        mismatches++;
+    if (rate_limiter_take(&limiter, 2, now) != 0)
+        mismatches++;
+    if (rate_limiter_take(&limiter, 1, now + 4000) != 6000 ||
+        rate_limiter_take(&limiter, 1, now + 10000) != 0)
+        mismatches++;
+    // A long idle period refills only up to the burst
+    if (rate_limiter_take(&limiter, 1, now + 3600000) != 0 ||
+        rate_limiter_take(&limiter, 1, now + 3600000) != 0 ||
+        rate_limiter_take(&limiter, 1, now + 3600000) == 0)
+        mismatches++;
+    // More clients than slots: the least recently seen are forgotten
+    for (uint32_t client = 100; client < 100 + RATE_LIMIT_CLIENTS; client++)
+        rate_limiter_take(&limiter, client, now + 3600001);
+    if (rate_limiter_take(&limiter, 1, now + 3600002) != 0)
+        mismatches++;
+    rate_limiter_init(&limiter, 0, 1);
+    for (int i = 0; i < 10; i++)
+        mismatches += rate_limiter_take(&limiter, 1, now) != 0;
+
+    Lane lane;
+    int items[8];
+    if (lane_start(&lane, "probe", 2, 4, lane_probe_run, lane_probe_discard) < 0) {
+        mismatches++;
+    } else {
+        int accepted = 0;
+        for (int i = 0; i < 2; i++)
+            accepted += lane_submit(&lane, &items[i]) == 0;
+        pthread_mutex_lock(&lane_probe.lock);
+        while (lane_probe.ran < 2)
+            pthread_cond_wait(&lane_probe.changed, &lane_probe.lock);
+        pthread_mutex_unlock(&lane_probe.lock);
+
+        for (int i = 2; i < 8; i++)
+            accepted += lane_submit(&lane, &items[i]) == 0;
+        LaneStats stats;
+        lane_get_stats(&lane, &stats);
+        if (accepted != 6 || stats.queued != 4 || stats.active != 2 || stats.rejected != 2)
+            mismatches++;
+
+        // Released workers may run some queued items before the stop; every
+        // accepted item has to be either run or discarded
+        pthread_mutex_lock(&lane_probe.lock);
+        lane_probe.released = 1;
+        pthread_cond_broadcast(&lane_probe.changed);
+        pthread_mutex_unlock(&lane_probe.lock);
+        lane_stop(&lane);
+        if (lane_probe.ran + lane_probe.discarded != 6)
+            mismatches++;
+    }
+
+    printf("{\"check\":\"executor\",\"cases\":19,\"mismatches\":%d}\n", mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+static int verify_wireless_fixtures() {
+    int mismatches = 0;
+    WirelessInterface interface;
+    WirelessStation station;
+
+    if (wireless_parse_interface(nl80211_interface_fixture, sizeof(nl80211_interface_fixture),
+                                 &interface) < 0 ||
+        interface.ifindex != 3 || strcmp(interface.name, "wlp2s0") != 0 ||
+        interface.iftype != 2 || strcmp(interface.ssid, "home-5g") != 0)
+        mismatches++;
+
+    const unsigned all = WIRELESS_HAS_SIGNAL | WIRELESS_HAS_SIGNAL_AVG | WIRELESS_HAS_TX_BITRATE |
+                         WIRELESS_HAS_RX_BITRATE | WIRELESS_HAS_TX_RETRIES | WIRELESS_HAS_TX_FAILED;
+    if (wireless_parse_station(nl80211_station_fixture, sizeof(nl80211_station_fixture),
+                               &station) < 0 ||
+        station.ifindex != 3 || strcmp(station.mac, "a4:2b:b0:d1:13:07") != 0 ||
+        station.present != all || station.signal_dbm != -52 || station.signal_avg_dbm != -54 ||
+        station.tx_bitrate_kbps != 866700 || station.rx_bitrate_kbps != 780000 ||
+        station.tx_packets != 1234 || station.rx_packets != 4321 ||
+        station.tx_retries != 87 || station.tx_failed != 3 ||
+        station.inactive_ms != 12 || station.connected_s != 3600)
+        mismatches++;
+
+    // Truncated input and the wrong command must be rejected, not misread
+    if (wireless_parse_station(nl80211_station_fixture, sizeof(nl80211_station_fixture) - 8,
+                               &station) == 0 ||
+        wireless_parse_station(nl80211_interface_fixture, sizeof(nl80211_interface_fixture),
+                               &station) == 0)
+        mismatches++;
+
+    printf("{\"check\":\"nl80211_fixtures\",\"cases\":4,\"mismatches\":%d}\n", mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+static void bench_parse_nl80211_station(void *ctx) {
+    (void)ctx;
+    WirelessStation station;
+    wireless_parse_station(nl80211_station_fixture, sizeof(nl80211_station_fixture), &station);
+}
+
+// A SOCK_DIAG_BY_FAMILY reply for an established IPv4 TCP socket
+static size_t build_diag_message(unsigned char *buffer, size_t size, int index,
+                                 uint32_t retransmits, uint32_t rtt_us) {
+    struct tcp_info info;
+    struct inet_diag_msg diag;
+    struct rtattr rta;
+    size_t length = NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(diag)) + RTA_SPACE(sizeof(info));
+    if (length > size)
+        return 0;
+
+    memset(buffer, 0, length);
+    memset(&diag, 0, sizeof(diag));
+    diag.idiag_family = AF_INET;
+    diag.idiag_state = TCP_ESTABLISHED;
+    diag.id.idiag_src[0] = htonl(0x0a000001);
+    diag.id.idiag_dst[0] = htonl(0x0a000002);
+    diag.id.idiag_sport = htons(40000 + index);
+    diag.id.idiag_dport = htons(443);
+    memset(&info, 0, sizeof(info));
+    info.tcpi_total_retrans = retransmits;
+    info.tcpi_rtt = rtt_us;
+    rta.rta_len = RTA_LENGTH(sizeof(info));
+    rta.rta_type = INET_DIAG_INFO;
+
+    struct nlmsghdr header = { (uint32_t)length, SOCK_DIAG_BY_FAMILY, NLM_F_MULTI, 1, 0 };
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + NLMSG_HDRLEN, &diag, sizeof(diag));
+    memcpy(buffer + NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(diag)), &rta, sizeof(rta));
+    memcpy(buffer + NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(diag)) + RTA_LENGTH(0), &info, sizeof(info));
+    return length;
+}
+
+// Ranking on synthetic replies, then a live dump that has to see a
+// listener and a connection this process opened
+static int verify_sockstat() {
+    int mismatches = 0;
+    SockStats stats;
+    unsigned char message[512];
+
+    sockstat_reset(&stats);
+    for (int i = 0; i < 30; i++) {
+        size_t length = build_diag_message(message, sizeof(message), i,
+                                           (uint32_t)(i * 7 % 30), (uint32_t)(i * 11 % 30) * 100);
+        if (sockstat_account(&stats, IPPROTO_TCP, message, length) < 0)
+            mismatches++;
+    }
+    if (stats.tcp.total != 30 || stats.tcp.states[TCP_ESTABLISHED] != 30 ||
+        stats.tcp_retransmits != 29 * 30 / 2 ||
+        stats.top_retransmits_count != SOCKSTAT_TOP_N || stats.top_rtt_count != SOCKSTAT_TOP_N)
+        mismatches++;
+    for (int i = 0; i < stats.top_retransmits_count; i++) {
+        if (stats.top_retransmits[i].retransmits != (uint32_t)(29 - i) ||
+            stats.top_rtt[i].rtt_us != (uint32_t)(29 - i) * 100)
+            mismatches++;
+    }
+    if (strcmp(stats.top_retransmits[0].local, "10.0.0.1:40017") != 0 ||
+        strcmp(stats.top_retransmits[0].remote, "10.0.0.2:443") != 0)
+        mismatches++;
+    if (sockstat_account(&stats, IPPROTO_TCP, message, 20) == 0)
+        mismatches++;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t address_length = sizeof(address);
+    int live = bind(listener, (struct sockaddr *)&address, sizeof(address)) == 0 &&
+               listen(listener, 1) == 0 &&
+               getsockname(listener, (struct sockaddr *)&address, &address_length) == 0 &&
+               connect(client, (struct sockaddr *)&address, sizeof(address)) == 0;
+    if (!live || sockstat_collect(&stats) < 0 || stats.tcp.states[TCP_LISTEN] < 1 ||
+        stats.tcp.states[TCP_ESTABLISHED] < 2)
+        mismatches++;
+    close(client);
+    close(listener);
+
+    printf("{\"check\":\"sockstat\",\"cases\":30,\"mismatches\":%d}\n", mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+// Peer bodies are spliced into /api/fleet verbatim, so anything but one
+// balanced JSON object has to be refused
+static int verify_fleet_snapshot() {
+    const struct {
+        const char *body;
+        int valid;
+    } cases[] = {
+        { "{\"a\":1}", 1 },
+        { " \r\n{\"a\":[1,{\"b\":\"}]{\\\"\"}]}\n", 1 },
+        { "{}", 1 },
+        { "{\"a\":1},\"injected\":{}", 0 },
+        { "{\"a\":1}{}", 0 },
+        { "{\"a\":[1}", 0 },
+        { "{\"a\":\"}", 0 },
+        { "{\"a\":\"x\ny\"}", 0 },
+        { "[{}]", 0 },
+        { "", 0 },
+        { "{\"a\":1", 0 },
+    };
+    const size_t count = sizeof(cases) / sizeof(cases[0]);
+    int mismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (fleet_snapshot_valid(cases[i].body, strlen(cases[i].body)) != cases[i].valid)
+            mismatches++;
+    }
+
+    // One level deeper than accepted
+    char deep[2 * FLEET_MAX_DEPTH + 2];
+    deep[0] = '{';
+    memset(deep + 1, '[', FLEET_MAX_DEPTH);
+    memset(deep + FLEET_MAX_DEPTH + 1, ']', FLEET_MAX_DEPTH);
+    deep[2 * FLEET_MAX_DEPTH + 1] = '}';
+    if (fleet_snapshot_valid(deep, sizeof(deep)))
+        mismatches++;
+
+    printf("{\"check\":\"fleet_snapshot\",\"cases\":%zu,\"mismatches\":%d}\n", count + 1, mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+static void bench_sockstat_collect(void *ctx) {
+    (void)ctx;
+    SockStats stats;
+    sockstat_collect(&stats);
+}
+
+static void bench_history_append(void *ctx) {
+    static time_t when = 1700000000;
+    double values[HISTORY_MAX_VALUES] = { 1234.0, 5678.0, 0 };
+    (void)ctx;
+    history_append(HISTORY_INTERFACE, when, values);
+    when += HISTORY_SAMPLE_INTERVAL_S;
+}
+
+typedef struct {
+    time_t from;
+    time_t to;
+} HistoryRange;
+
+static void bench_history_query(void *ctx) {
+    HistoryRange *range = (HistoryRange *)ctx;
+    static char body[HISTORY_MAX_POINTS * 160];
+    Emitter out;
+    emitter_init(&out, ENCODING_JSON, body, sizeof(body));
+    history_query(HISTORY_INTERFACE, range->from, range->to, HISTORY_DEFAULT_POINTS, &out);
+    emitter_finish(&out);
+}
+
+typedef struct {
+    int fds[2];
+    const char *path;
+} SendFileBench;
+
+static void *drain_socket(void *arg) {
+    char buffer[65536];
+    int fd = *(int *)arg;
+    while (read(fd, buffer, sizeof(buffer)) > 0)
+        ;
+    return NULL;
+}
+
+static void bench_send_file(void *ctx) {
+    SendFileBench *bench = (SendFileBench *)ctx;
+    send_file(bench->fds[0], bench->path);
+}
+
+typedef struct {
+    const SendFileBench *socket;
+    HttpRequest request;
+    const Asset *asset;
+} SendAssetBench;
+
+static void bench_send_asset(void *ctx) {
+    SendAssetBench *bench = (SendAssetBench *)ctx;
+    send_asset(bench->socket->fds[0], &bench->request, bench->asset);
+}
+
+// Cumulative count on the exported histogram line for route and le, or -1
+static long histogram_line(const char *text, const char *route, const char *le) {
+    char prefix[160];
+    snprintf(prefix, sizeof(prefix),
+             "netdiag_http_request_duration_seconds_bucket{route=\"%s\",le=\"%s\"} ", route, le);
+    const char *line = strstr(text, prefix);
+    return line ? strtol(line + strlen(prefix), NULL, 10) : -1;
+}
+
+// Latencies at the top of the histogram: the last finite buckets get their
+// own boundaries and anything past them shows up only in +Inf. Recorded on
+// the speed test route, which no other check requests.
+static int verify_latency_histogram() {
+    const char *route = route_name(ROUTE_SPEED_TEST);
+    const uint64_t latencies[] = { (1ULL << 27) - 1, 1ULL << 27, 1ULL << 40 };
+    int mismatches = 0;
+
+    for (size_t i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+        metrics_request_begin(ROUTE_SPEED_TEST);
+        metrics_request_end(ROUTE_SPEED_TEST, 200, latencies[i]);
+    }
+
+    Arena arena;
+    size_t length;
+    if (arena_init(&arena, 64 * 1024) < 0)
+        return 1;
+    char *text = metrics_render(&arena, &length);
+    if (text == NULL) {
+        arena_destroy(&arena);
+        return 1;
+    }
+    // 2^27 - 1 us is below 2^27 (134.218 s), 2^27 us in the next bucket up to
+    // 2^27 + 2^25 (167.772 s), 2^40 us past the last finite bucket (268.435 s)
+    if (histogram_line(text, route, "134.218") != 1)
+        mismatches++;
+    if (histogram_line(text, route, "167.772") != 2)
+        mismatches++;
+    if (histogram_line(text, route, "268.435") != -1)
+        mismatches++;
+    if (histogram_line(text, route, "+Inf") != 3)
+        mismatches++;
+    arena_destroy(&arena);
+
+    printf("{\"check\":\"latency_histogram\",\"cases\":4,\"mismatches\":%d}\n", mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+// The server binary-searches the generated table, so it has to be sorted
+// and every header block has to agree with its body
+static int verify_embedded_assets() {
+    int mismatches = 0;
+    for (size_t i = 0; i < embedded_asset_count; i++) {
+        const Asset *asset = &embedded_assets[i];
+        char length[48];
+        snprintf(length, sizeof(length), "Content-Length: %zu\r\n", asset->body_length);
+
+        if ((i > 0 && strcmp(embedded_assets[i - 1].path, asset->path) >= 0) ||
+            find_asset(asset->path) != asset || !strstr(asset->header, length) ||
+            strlen(asset->header) != asset->header_length ||
+            (asset->gzip_body && asset->gzip_length >= asset->body_length))
+            mismatches++;
+    }
+    if (find_asset("/index.html") == NULL || find_asset("/missing.html") != NULL)
+        mismatches++;
+
+    printf("{\"check\":\"embedded_assets\",\"assets\":%zu,\"mismatches\":%d}\n",
+           embedded_asset_count, mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+// Serves one request on this thread, the way a fast-lane worker does, and
+// returns the heap calls it made
+static uint64_t serve_counted(const char *request, int *status) {
+    int fds[2];
+    char response[512];
+    *status = 0;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        return UINT64_MAX;
+    send(fds[1], request, strlen(request), 0);
+
+    heap_calls = 0;
+    counting_heap_calls = 1;
+    ClientConnection *connection = client_connection_acquire(fds[0], htonl(INADDR_LOOPBACK));
+    if (connection)
+        serve_client_connection(connection);
+    counting_heap_calls = 0;
+
+    // Drain the whole response so no write ever blocks on a full buffer
+    ssize_t received = recv(fds[1], response, sizeof(response) - 1, 0);
+    if (received > 0) {
+        response[received] = '\0';
+        sscanf(response, "HTTP/1.1 %d", status);
+    }
+    while (recv(fds[1], response, sizeof(response), 0) > 0)
+        ;
+    close(fds[1]);
+    if (connection == NULL)
+        close(fds[0]);
+    return connection ? heap_calls : UINT64_MAX;
+}
+
+// The arena on its own, then whole requests through the server's request
+// path: once warmed up, none of them may call the allocator. The speed test
+// is exempt: libcurl allocates its own handle and connection state.
+static int verify_request_allocations() {
+    int mismatches = 0;
+    Arena arena;
+
+    if (arena_init(&arena, 1024) < 0)
+        return 1;
+    char *first = arena_alloc(&arena, 10);
+    char *second = arena_alloc(&arena, 100);
+    if (((uintptr_t)first | (uintptr_t)second) % ARENA_ALIGNMENT != 0 || second != first + 16)
+        mismatches++;
+    memset(second, 'x', 100);
+    char *grown = arena_grow(&arena, second, 100, 800);
+    if (grown != second || arena.used != 16 + 800 || arena.overflows != 0)
+        mismatches++;
+    // Too big for the block: served from the heap, contents carried over
+    grown = arena_grow(&arena, grown, 800, 4096);
+    if (grown == NULL || grown == second || grown[99] != 'x' || arena.overflows != 1)
+        mismatches++;
+    arena_reset(&arena);
+    if (arena.used != 0 || arena.oversized != NULL || arena_alloc(&arena, 10) != first ||
+        arena.peak != 16 + 800)
+        mismatches++;
+    arena_destroy(&arena);
+
+    static const struct {
+        const char *request;
+        int status;
+    } requests[] = {
+        { "GET /api/isp-info HTTP/1.1\r\n\r\n", 200 },
+        { "GET /api/isp-info HTTP/1.1\r\nAccept: application/cbor\r\n\r\n", 200 },
+        { "GET /static/js/main.js HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n", 200 },
+        { "GET /metrics HTTP/1.1\r\n\r\n", 200 },
+        { "GET /api/history?series=speed_test&points=1000 HTTP/1.1\r\n\r\n", 503 },
+        { "GET /api/fleet HTTP/1.1\r\n\r\n", 503 },
+        { "GET /missing HTTP/1.1\r\n\r\n", 404 },
+    };
+    const int rounds = 50;
+    uint64_t steady_calls = 0;
+
+    if (server_start_workers() < 0)
+        return mismatches + 1;
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+        int status;
+        // The first request builds caches and per-thread state
+        serve_counted(requests[i].request, &status);
+        if (status != requests[i].status)
+            mismatches++;
+
+        uint64_t calls = 0;
+        for (int round = 0; round < rounds; round++)
+            calls += serve_counted(requests[i].request, &status);
+        if (calls != 0)
+            mismatches++;
+        steady_calls += calls;
+    }
+    server_stop_workers();
+
+    printf("{\"check\":\"request_allocations\",\"cases\":%zu,\"steady_state_heap_calls\":%" PRIu64
+           ",\"mismatches\":%d}\n",
+           4 + 2 * sizeof(requests) / sizeof(requests[0]), steady_calls, mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+typedef struct {
+    int listen_fd;
+    volatile int running;
+    atomic_int result;   // 1 while serving
+} UringCheck;
+
+static void *uring_check_thread(void *arg) {
+    UringCheck *check = arg;
+    atomic_store(&check->result, uring_serve(check->listen_fd, &check->running));
+    return NULL;
+}
+
+// One request over a fresh loopback connection; returns the response length
+static ssize_t fetch(int port, const char *request, char *response, size_t size) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port),
+                                   .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    struct timeval timeout = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    send(fd, request, strlen(request), MSG_NOSIGNAL);
+
+    size_t length = 0;
+    ssize_t received;
+    while (length < size - 1 && (received = recv(fd, response + length, size - 1 - length, 0)) > 0)
+        length += (size_t)received;
+    response[length] = '\0';
+    close(fd);
+    return (ssize_t)length;
+}
+
+// Whole response received, and as long as its Content-Length says
+static int response_complete(const char *response, size_t length) {
+    const char *body = strstr(response, "\r\n\r\n");
+    const char *header = strstr(response, "Content-Length: ");
+    return body && header && strtoull(header + 16, NULL, 10) == length - (size_t)(body + 4 - response);
+}
+
+// The io_uring backend on a loopback socket: responses sent from the
+// capture buffer, the overflow arena and the embedded assets, a request
+// handed to the slow lane, and a clean stop. Skipped where the kernel
+// lacks io_uring.
+static int verify_uring() {
+    const Asset *asset = find_asset("/static/js/main.js");
+    char not_modified[256];
+    snprintf(not_modified, sizeof(not_modified),
+             "GET /static/js/main.js HTTP/1.1\r\nIf-None-Match: %s\r\n\r\n", asset->etag);
+    const struct {
+        const char *request;
+        int status;
+        const char *contains;
+        size_t length;  // Whole response, 0 when it varies
+    } requests[] = {
+        { "GET /api/isp-info HTTP/1.1\r\n\r\n", 200, "\"timezone\"", 0 },
+        { "GET /static/js/main.js HTTP/1.1\r\n\r\n", 200, asset->etag,
+          asset->header_length + asset->body_length },
+        { not_modified, 304, asset->etag, asset->not_modified_length },
+        { "OPTIONS /api/all HTTP/1.1\r\n\r\n", 200, "Access-Control-Allow-Methods", 0 },
+        { "GET /missing HTTP/1.1\r\n\r\n", 404, "Not Found", 0 },
+    };
+    const size_t count = sizeof(requests) / sizeof(requests[0]);
+    int mismatches = 0;
+
+    // Enough samples that a full-resolution query outgrows the send buffer
+    char history_path[] = "/tmp/microbench-uring-history-XXXXXX";
+    int history_fd = mkstemp(history_path);
+    if (history_fd < 0 || history_open(history_path) < 0)
+        return 1;
+    close(history_fd);
+    const int samples = 2 * HISTORY_MAX_POINTS;
+    for (int i = 0; i < samples; i++) {
+        double values[HISTORY_MAX_VALUES] = { 1e6 + i * 0.37, 2e6 + i * 1.13, 0 };
+        history_append(HISTORY_INTERFACE, 1700000000 + i * HISTORY_SAMPLE_INTERVAL_S, values);
+    }
+    char history_request[160];
+    snprintf(history_request, sizeof(history_request),
+             "GET /api/history?series=interface&from=1700000000&to=%d&points=%d HTTP/1.1\r\n\r\n",
+             1700000000 + samples * HISTORY_SAMPLE_INTERVAL_S, HISTORY_MAX_POINTS);
+
+    if (server_start_workers() < 0)
+        return 1;
+    UringCheck check = { socket(AF_INET, SOCK_STREAM, 0), 1, 1 };
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t address_length = sizeof(address);
+    pthread_t thread;
+    if (check.listen_fd < 0 || bind(check.listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(check.listen_fd, 64) < 0 ||
+        getsockname(check.listen_fd, (struct sockaddr *)&address, &address_length) < 0 ||
+        pthread_create(&thread, NULL, uring_check_thread, &check) != 0) {
+        server_stop_workers();
+        return 1;
+    }
+    int port = ntohs(address.sin_port);
+
+    // Handed to the slow lane, which is rate limited, so only once
+    static char response[65536];
+    int status = 0;
+    if (fetch(port, "GET /api/traceroute?target=%3B HTTP/1.1\r\n\r\n", response, sizeof(response)) <= 0 ||
+        sscanf(response, "HTTP/1.1 %d", &status) != 1 || status != 400)
+        mismatches++;
+
+    for (size_t round = 0; round < 20 && atomic_load(&check.result) == 1; round++) {
+        for (size_t i = 0; i < count; i++) {
+            status = 0;
+            ssize_t length = fetch(port, requests[i].request, response, sizeof(response));
+            if (length <= 0 && atomic_load(&check.result) != 1)
+                break;
+            sscanf(response, "HTTP/1.1 %d", &status);
+            if (status != requests[i].status || !strstr(response, requests[i].contains) ||
+                (requests[i].length && (size_t)length != requests[i].length))
+                mismatches++;
+        }
+
+        status = 0;
+        ssize_t length = fetch(port, history_request, response, sizeof(response));
+        if (length <= 0 && atomic_load(&check.result) != 1)
+            break;
+        sscanf(response, "HTTP/1.1 %d", &status);
+        if (status != 200 || length <= URING_SEND_BUFFER || !response_complete(response, (size_t)length))
+            mismatches++;
+    }
+
+    check.running = 0;
+    pthread_join(thread, NULL);
+    close(check.listen_fd);
+    server_stop_workers();
+    history_close();
+    unlink(history_path);
+
+    int supported = atomic_load(&check.result) == 0;
+    if (!supported)
+        mismatches = 0;
+    printf("{\"check\":\"uring\",\"supported\":%s,\"cases\":%zu,\"mismatches\":%d}\n",
+           supported ? "true" : "false", supported ? 1 + 20 * (count + 1) : 0, mismatches);
+    fflush(stdout);
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = NULL;
+    int verify_only = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verify") == 0)
+            verify_only = 1;
+        else
+            filter = argv[i];
+    }
+
+    // Only warnings from the code under test, as JSON lines like the results
+    log_init(LOG_WARN, LOG_FORMAT_JSON);
+
+    // Shared-memory export under a name private to this run
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/netdiag-microbench-%d", (int)getpid());
+    if (shm_export_start(shm_name) < 0)
+        return 1;
+
+    // Correctness checks run first; a failing check fails the whole run
+    int failures = verify_escape_backends() + verify_cbor_encoding() +
+                   verify_encoding_negotiation() + verify_latency_histogram() +
+                   verify_embedded_assets() +
+                   verify_wireless_fixtures() + verify_sockstat() + verify_fleet_snapshot() +
+                   verify_tzdb() +
+                   verify_executor() + verify_request_allocations() + verify_uring() +
+                   verify_shm_seqlock(shm_name);
+    if (failures != 0 || verify_only) {
+        shm_export_stop();
+        log_shutdown();
+        return failures != 0;
+    }
+
+    // Escape-heavy payload similar to long interface lists and probe histories
+    static char escaped_payload[900];
+    for (size_t i = 0; i < sizeof(escaped_payload) - 1; i++)
+        escaped_payload[i] = "eth0 \"up\"\t\\n"[i % 12];
+    escaped_payload[sizeof(escaped_payload) - 1] = '\0';
+
+    // Escaper throughput on a clean 4 KB payload and the escape-heavy one
+    static char clean_payload[4096];
+    static char escape_output[sizeof(clean_payload) * JSON_ESCAPE_MAX_EXPANSION];
+    for (size_t i = 0; i < sizeof(clean_payload); i++)
+        clean_payload[i] = "abcdefghijklmnopqrstuvwxyz0123456789 .:/-"[i % 41];
+
+    EscapeBench escape_benches[6];
+    const char *escape_names[6] = {
+        "json_escape_scalar_clean", "json_escape_sse2_clean", "json_escape_avx2_clean",
+        "json_escape_scalar_escaped", "json_escape_sse2_escaped", "json_escape_avx2_escaped",
+    };
+    for (int i = 0; i < 6; i++) {
+        static const char *backends[] = { "scalar", "sse2", "avx2" };
+        escape_benches[i].escape = json_escape_backend(backends[i % 3]);
+        escape_benches[i].input = i < 3 ? clean_payload : escaped_payload;
+        escape_benches[i].length = i < 3 ? sizeof(clean_payload) : strlen(escaped_payload);
+        escape_benches[i].output = escape_output;
+    }
+
+    SendFileBench send_file_bench = { { -1, -1 }, "./web/index.html" };
+    pthread_t drain_thread;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, send_file_bench.fds) < 0) {
+        perror("socketpair");
+        return 1;
+    }
+    pthread_create(&drain_thread, NULL, drain_socket, &send_file_bench.fds[1]);
+
+    // Same file from the embedded table, as a browser asks for it
+    SendAssetBench send_asset_bench = { &send_file_bench, { .headers = "Accept-Encoding: gzip\r\n\r\n" },
+                                        find_asset("/index.html") };
+
+    // History store in a scratch file, pre-filled with 90 days of samples
+    char history_path[] = "/tmp/microbench-history-XXXXXX";
+    int history_fd = mkstemp(history_path);
+    HistoryRange history_range = { 1700000000 - 90 * 86400, 1700000000 };
+    if (history_fd < 0 || history_open(history_path) < 0) {
+        perror("history");
+        return 1;
+    }
+    close(history_fd);
+    for (time_t t = history_range.from; t < history_range.to; t += HISTORY_SAMPLE_INTERVAL_S) {
+        double values[HISTORY_MAX_VALUES] = { (double)(t % 977), (double)(t % 1511), 0 };
+        history_append(HISTORY_INTERFACE, t, values);
+    }
+
+    Encoding emit_json = ENCODING_JSON, emit_cbor = ENCODING_CBOR;
+
+    NetdiagShmReader shm_reader;
+    if (netdiag_shm_open(&shm_reader, shm_name) < 0) {
+        perror("shm");
+        return 1;
+    }
+
+    // The installed tzdata when there is one, so the table has its real size
+    TzIndex tz_index;
+    if (tz_index_open(&tz_index, TZDB_DEFAULT_DIR) < 0 && load_tz_fixtures(&tz_index) < 0) {
+        perror("tzdb");
+        return 1;
+    }
+
+    const struct {
+        const char *name;
+        BenchFn fn;
+        void *ctx;
+    } benches[] = {
+        { "json_write_string_short", bench_json_write_string_short, NULL },
+        { "json_write_string_escaped", bench_json_write_string_escaped, escaped_payload },
+        { "json_write_numbers", bench_json_write_numbers, NULL },
+        { "emit_traceroute_json", bench_emit_sample, &emit_json },
+        { "emit_traceroute_cbor", bench_emit_sample, &emit_cbor },
+        { "parse_net_dev", bench_parse_net_dev, NULL },
+        { "parse_net_route", bench_parse_net_route, NULL },
+        { "parse_nl80211_station", bench_parse_nl80211_station, NULL },
+        { "sockstat_collect", bench_sockstat_collect, NULL },
+        { "tz_lookup", bench_tz_lookup, &tz_index },
+        { "send_file_index_html", bench_send_file, &send_file_bench },
+        { "send_asset_index_html", bench_send_asset, &send_asset_bench },
+        { "history_query_90d", bench_history_query, &history_range },
+        { "history_append", bench_history_append, NULL },
+        { "shm_read", bench_shm_read, &shm_reader },
+    };
+
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (filter && !strstr(benches[i].name, filter))
+            continue;
+        run_bench(benches[i].name, benches[i].fn, benches[i].ctx);
+    }
+
+    for (int i = 0; i < 6; i++) {
+        if (!escape_benches[i].escape || (filter && !strstr(escape_names[i], filter)))
+            continue;
+        run_bench(escape_names[i], bench_json_escape, &escape_benches[i]);
+    }
+
+    history_close();
+    unlink(history_path);
+    netdiag_shm_close(&shm_reader);
+    tz_index_free(&tz_index);
+    shm_export_stop();
+    log_shutdown();
+
+    shutdown(send_file_bench.fds[0], SHUT_WR);
+    pthread_join(drain_thread, NULL);
+    close(send_file_bench.fds[0]);
+    close(send_file_bench.fds[1]);
+    return 0;
+}
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# Runs the microbenchmarks and the HTTP load generator against a local
+# server instance. Results are JSON lines on stdout.
+#
+# Usage: bench/run.sh BUILD_DIR [loadgen options]
+
+set -e
+
+BUILD_DIR="${1:-build}"
+shift || true
+PORT="${BENCH_PORT:-18080}"
+
+cd "$(dirname "$0")/.."
+
+"$BUILD_DIR/microbench"
+
+"$BUILD_DIR/network-diagnostic" -p "$PORT" --log-level warn --no-history --no-shm > /dev/null 2>&1 &
+SERVER_PID=$!
+trap 'kill -9 $SERVER_PID 2>/dev/null || true' EXIT
+
+# Wait for the listener to come up
+for _ in $(seq 1 50); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+
+# The server closes every connection after its response, so keep-alive runs
+# would only measure reconnects; pass -m keepalive to check that anyway
+"$BUILD_DIR/loadgen" -p "$PORT" -d "${BENCH_DURATION:-3}" -m close "$@"
@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator for memory that lives exactly as long as one request.
+// Allocations are pointer increments into one block that is reused after
+// every arena_reset(), so a warmed-up arena makes no heap calls. Requests
+// that do not fit get their own heap block, released by the next reset.
+typedef struct {
+    char *base;
+    size_t capacity;
+    size_t used;
+    size_t last;          // Offset of the most recent allocation, for arena_grow()
+    ArenaBlock *oversized;
+    size_t peak;          // Highest use seen, oversized blocks excluded
+    uint64_t overflows;   // Allocations that had to go to the heap
+} Arena;
+
+int arena_init(Arena *arena, size_t capacity);
+void arena_destroy(Arena *arena);
+
+// ARENA_ALIGNMENT-aligned; NULL only if the heap is exhausted too
+void* arena_alloc(Arena *arena, size_t size);
+// Resizes an allocation, in place when it is the most recent one
+void* arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+// Frees everything allocated since the last reset
+void arena_reset(Arena *arena);
+
+#endif // ARENA_H
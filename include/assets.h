@@ -0,0 +1,29 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stddef.h>
+
+// Web UI files compiled into the binary. tools/embed_assets.c generates the
+// table from web/ at build time; everything a response needs is precomputed,
+// so serving an asset is one writev() of constant data.
+typedef struct {
+    const char *path;          // URL path, e.g. "/static/css/style.css"
+    const char *content_type;
+    const char *etag;          // Quoted content hash
+    const unsigned char *body;
+    size_t body_length;
+    const unsigned char *gzip_body;  // NULL when gzip does not make it smaller
+    size_t gzip_length;
+    const char *header;        // Complete "200 OK" header block for body
+    size_t header_length;
+    const char *gzip_header;   // Same for gzip_body, with Content-Encoding
+    size_t gzip_header_length;
+    const char *not_modified_header;  // "304 Not Modified" header block
+    size_t not_modified_length;
+} Asset;
+
+// Sorted by path
+extern const Asset embedded_assets[];
+extern const size_t embedded_asset_count;
+
+#endif // ASSETS_H
@@ -0,0 +1,39 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CBOR_MAX_DEPTH 16
+
+// Single-pass CBOR (RFC 8949) writer over a caller-supplied buffer, the binary
+// counterpart of JSONWriter. Maps and arrays use indefinite-length encoding so
+// nothing has to be counted up front; integers and string lengths take the
+// shortest head, and doubles shrink to single precision when that is exact.
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    int depth;
+    int error;
+} CBORWriter;
+
+void cbor_writer_init(CBORWriter *cbor, void *buffer, size_t capacity);
+int cbor_writer_finish(CBORWriter *cbor);
+
+// Pass key == NULL for the root value and for array elements
+void cbor_begin_map(CBORWriter *cbor, const char *key);
+void cbor_end_map(CBORWriter *cbor);
+void cbor_begin_array(CBORWriter *cbor, const char *key);
+void cbor_end_array(CBORWriter *cbor);
+
+void cbor_write_string(CBORWriter *cbor, const char *key, const char *value);
+void cbor_write_int(CBORWriter *cbor, const char *key, int64_t value);
+void cbor_write_uint(CBORWriter *cbor, const char *key, uint64_t value);
+void cbor_write_double(CBORWriter *cbor, const char *key, double value);
+void cbor_write_bool(CBORWriter *cbor, const char *key, int value);
+void cbor_write_null(CBORWriter *cbor, const char *key);
+// value must be one complete, already encoded CBOR data item
+void cbor_write_raw(CBORWriter *cbor, const char *key, const void *value, size_t length);
+
+#endif // CBOR_H
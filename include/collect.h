@@ -0,0 +1,21 @@
+#ifndef COLLECT_H
+#define COLLECT_H
+
+#define COLLECT_DEFAULT_INTERVAL_MS 60000
+#define COLLECT_RECORD_MAX 16384
+
+typedef struct {
+    unsigned interval_ms;
+    long count;          // Records to write; 0 runs until SIGINT/SIGTERM
+    int speed_test;      // Run a speed test for every record
+    const char *output;  // Appended to; NULL writes to stdout
+} CollectOptions;
+
+// Headless mode for cron jobs and sidecars: runs the collectors directly and
+// writes one JSON object per line (NDJSON) every interval_ms, without the
+// HTTP server, event hub, history store or shared-memory export. Records are
+// scheduled on a fixed grid from the first one; ticks missed while a slow
+// collector (the speed test) was running are skipped. Returns 0 on success.
+int collect_run(const CollectOptions *options);
+
+#endif // COLLECT_H
@@ -0,0 +1,21 @@
+#ifndef DOCUMENTS_H
+#define DOCUMENTS_H
+
+#include "emit.h"
+#include "network.h"
+
+// Network configuration and interface counters, described once for the API
+// resources, the event stream and the collector
+
+// Fields the system does not report are "N/A"
+void network_info_collect(NetworkInfo *info);
+void network_info_write(Emitter *out, const char *key, const NetworkInfo *info);
+
+// Zero counters unless /proc/net/dev can be read; returns -1 then
+int interface_stats_collect(InterfaceStats *stats);
+// With rates != NULL, adds tx_bytes_per_sec and rx_bytes_per_sec from
+// rates[0] and rates[1]
+void interface_stats_write(Emitter *out, const char *key, const InterfaceStats *stats,
+                           const double rates[2]);
+
+#endif // DOCUMENTS_H
@@ -0,0 +1,55 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "json.h"
+#include "cbor.h"
+
+typedef enum {
+    ENCODING_JSON,
+    ENCODING_CBOR,
+    ENCODING_COUNT
+} Encoding;
+
+#define ENCODING_MASK(encoding) (1u << (encoding))
+
+// Describes a document once and encodes it as JSON, CBOR or both. Handlers
+// write through the emit_* calls below; each value goes to every encoding the
+// emitter was set up with, so a cache can build all representations from a
+// single collection pass.
+typedef struct {
+    unsigned encodings;  // ENCODING_MASK bits of the active writers
+    JSONWriter json;
+    CBORWriter cbor;
+} Emitter;
+
+void emitter_init(Emitter *out, Encoding encoding, char *buffer, size_t capacity);
+// Additionally writes every value in another encoding into its own buffer
+void emitter_add(Emitter *out, Encoding encoding, char *buffer, size_t capacity);
+// Returns -1 if any encoding overflowed its buffer or the document is unbalanced
+int emitter_finish(Emitter *out);
+const char* emitter_data(const Emitter *out, Encoding encoding, size_t *length);
+
+// Pass key == NULL for the root value and for array elements
+void emit_begin_object(Emitter *out, const char *key);
+void emit_end_object(Emitter *out);
+void emit_begin_array(Emitter *out, const char *key);
+void emit_end_array(Emitter *out);
+
+void emit_string(Emitter *out, const char *key, const char *value);
+void emit_int(Emitter *out, const char *key, int64_t value);
+void emit_uint(Emitter *out, const char *key, uint64_t value);
+// JSON rounds to two decimals; CBOR keeps the full value
+void emit_number(Emitter *out, const char *key, double value);
+void emit_bool(Emitter *out, const char *key, int value);
+void emit_null(Emitter *out, const char *key);
+// Embeds a value already encoded in the emitter's only encoding
+void emit_raw(Emitter *out, const char *key, const char *value, size_t length);
+
+const char* encoding_name(Encoding encoding);
+const char* encoding_content_type(Encoding encoding);
+// Picks the encoding an HTTP Accept header prefers; JSON unless CBOR ranks higher
+Encoding encoding_negotiate(const char *accept);
+
+#endif // EMIT_H
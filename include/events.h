@@ -0,0 +1,29 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stddef.h>
+#include "json.h"
+#include "network.h"
+
+#define EVENTS_MAX_SUBSCRIBERS 1024
+#define EVENTS_INTERVAL_MS 1000  // Interface sampling period while anyone listens
+#define EVENTS_FRAME_MAX 4096
+
+// Server-Sent Events hub. A single producer thread samples interface counters
+// and network configuration and publishes "interface" and "network" events;
+// speed tests publish "speed_test" progress. Every event is framed once and
+// written to all subscribers with non-blocking sends; a subscriber whose
+// socket cannot take the whole frame is dropped.
+int events_start();
+void events_stop();
+
+// Sends the SSE response headers and the latest state, then takes ownership
+// of client_fd. Returns -1 (fd untouched) when the subscriber table is full.
+int events_subscribe(int client_fd);
+int events_subscriber_count();
+
+// Frames the finished document as one event and fans it out
+void events_publish(const char *event, JSONWriter *json);
+void events_publish_speed_test(const SpeedTestResult *result);
+
+#endif // EVENTS_H
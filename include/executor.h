@@ -0,0 +1,70 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define RATE_LIMIT_CLIENTS 256
+
+typedef void (*LaneTask)(void *item);
+
+// A fixed pool of workers draining a bounded FIFO. Submitting never blocks:
+// a full queue is reported to the caller, who can answer with 503 instead
+// of letting the backlog grow without limit.
+typedef struct {
+    const char *name;
+    LaneTask run;
+    LaneTask discard;       // Items still queued when the lane stops
+    void **queue;           // Ring buffer of capacity items
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int active;             // Items workers are running right now
+    int worker_count;
+    pthread_t *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    int running;
+    _Atomic uint64_t rejected;
+} Lane;
+
+typedef struct {
+    size_t queued;
+    int active;
+    int workers;
+    uint64_t rejected;  // Submissions refused because the queue was full
+} LaneStats;
+
+int lane_start(Lane *lane, const char *name, int workers, size_t capacity,
+               LaneTask run, LaneTask discard);
+// Returns -1 if the queue is full or the lane is stopping
+int lane_submit(Lane *lane, void *item);
+// Lets running items finish, discards queued ones and joins the workers
+void lane_stop(Lane *lane);
+void lane_get_stats(Lane *lane, LaneStats *stats);
+
+typedef struct {
+    uint32_t client;
+    double tokens;
+    uint64_t updated_ms;  // 0 marks a free slot
+} TokenBucket;
+
+// Per-client token buckets for a fixed number of recently seen clients;
+// when the table is full the least recently seen client is forgotten,
+// which only ever gives that client a fresh burst.
+typedef struct {
+    pthread_mutex_t lock;
+    double per_ms;
+    double burst;
+    TokenBucket buckets[RATE_LIMIT_CLIENTS];
+} RateLimiter;
+
+// per_minute == 0 disables limiting
+void rate_limiter_init(RateLimiter *limiter, double per_minute, double burst);
+// Takes a token for client and returns 0, or returns the milliseconds until
+// the client's next token without taking one
+uint64_t rate_limiter_take(RateLimiter *limiter, uint32_t client, uint64_t now_ms);
+
+#endif // EXECUTOR_H
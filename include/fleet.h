@@ -0,0 +1,41 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <stddef.h>
+#include "arena.h"
+
+#define FLEET_MAX_PEERS 1024
+#define FLEET_URL_MAX 256
+#define FLEET_BODY_MAX 65536            // Largest /api/all document accepted from a peer
+#define FLEET_DEFAULT_INTERVAL_MS 15000
+#define FLEET_DEFAULT_TIMEOUT_MS 5000
+#define FLEET_MAX_BACKOFF_MS 300000     // Failing peers are retried at least this often
+#define FLEET_MAX_PARALLEL 64           // Concurrent connections across all peers
+#define FLEET_MAX_DEPTH 64              // Deepest nesting accepted in a peer's body
+
+// Aggregator mode. One thread scrapes /api/all from every peer through a
+// single curl_multi loop: each peer on its own schedule, with a per-request
+// timeout, exponential backoff while it fails, and If-None-Match so an
+// unchanged peer answers 304. Only the latest good snapshot per peer is kept.
+
+// Peers are base URLs such as "http://10.0.0.5:8080" or "10.0.0.5:8080".
+// Add them before fleet_start(). Returns -1 if the URL is too long or the
+// table is full.
+int fleet_add_peer(const char *url);
+// One peer per line; blank lines and lines starting with '#' are ignored
+int fleet_load_peers(const char *path);
+
+int fleet_start(unsigned interval_ms, unsigned timeout_ms);
+void fleet_stop();
+int fleet_enabled();
+
+// 1 if body is exactly one JSON object, with balanced brackets outside
+// strings and only whitespace around it; peer bodies are spliced into the
+// fleet document verbatim, so anything else is a failed scrape
+int fleet_snapshot_valid(const char *body, size_t length);
+
+// The fleet table as a JSON document allocated from arena; NULL if the
+// fleet is disabled or memory ran out
+char* fleet_render(Arena *arena, size_t *length);
+
+#endif // FLEET_H
@@ -0,0 +1,52 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <time.h>
+#include "emit.h"
+#include "network.h"
+
+#define HISTORY_DEFAULT_PATH "./netdiag-history.bin"
+#define HISTORY_MAX_VALUES 3
+#define HISTORY_MAX_TIERS 3
+#define HISTORY_SAMPLE_INTERVAL_S 10  // Interface counter sampling period
+#define HISTORY_DEFAULT_POINTS 300
+#define HISTORY_MAX_POINTS 1000
+
+typedef enum {
+    HISTORY_SPEED_TEST,
+    HISTORY_INTERFACE,
+    HISTORY_SERIES_COUNT
+} HistorySeries;
+
+// One downsampling bucket; the file is a fixed array of these per tier
+typedef struct {
+    int64_t start;  // Unix time of the first sample in the bucket
+    uint32_t count;
+    uint32_t reserved;
+    double min[HISTORY_MAX_VALUES];
+    double max[HISTORY_MAX_VALUES];
+    double sum[HISTORY_MAX_VALUES];
+} HistoryBucket;
+
+// Memory-mapped ring store. Every series keeps several tiers of min/max/avg
+// buckets (e.g. per sample, per hour, per day), each a fixed-size ring, so
+// the file never grows and opening it is a single mmap. A file whose layout
+// does not match this build is reinitialized.
+int history_open(const char *path);
+void history_close();
+
+// Samples interface rates every HISTORY_SAMPLE_INTERVAL_S in the background
+int history_start_sampler();
+
+void history_append(HistorySeries series, time_t when, const double values[]);
+void history_record_speed_test(const SpeedTestResult *result);
+
+int history_parse_series(const char *name, HistorySeries *series);
+
+// Writes buckets in [from, to] from the finest tier that covers the range,
+// merging adjacent buckets if there would be more than max_points.
+// Returns -1 if the store is not open.
+int history_query(HistorySeries series, time_t from, time_t to, int max_points, Emitter *out);
+
+#endif // HISTORY_H
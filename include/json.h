@@ -1,20 +1,56 @@
 #ifndef JSON_H
 #define JSON_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_MAX_DEPTH 16
+
+// Single-pass JSON writer over a caller-supplied buffer. Nothing is allocated;
+// if the document does not fit, the writer stops and json_writer_finish()
+// reports the overflow instead of emitting a truncated document.
 typedef struct {
     char *data;
-    int size;
-    int capacity;
-} JSONBuffer;
-
-JSONBuffer* json_create_object();
-JSONBuffer* json_create_array();
-void json_add_string(JSONBuffer *json, const char *key, const char *value);
-void json_add_number(JSONBuffer *json, const char *key, double value);
-void json_add_integer(JSONBuffer *json, const char *key, int value);
-void json_add_boolean(JSONBuffer *json, const char *key, int value);
-void json_add_object(JSONBuffer *parent, const char *key, JSONBuffer *child);
-const char* json_get_string(JSONBuffer *json);
-void json_free(JSONBuffer *json);
+    size_t size;
+    size_t capacity;
+    int depth;
+    int error;
+    unsigned char has_items[JSON_MAX_DEPTH];
+} JSONWriter;
+
+void json_writer_init(JSONWriter *json, char *buffer, size_t capacity);
+int json_writer_finish(JSONWriter *json);
+
+// Pass key == NULL for the root value and for array elements
+void json_begin_object(JSONWriter *json, const char *key);
+void json_end_object(JSONWriter *json);
+void json_begin_array(JSONWriter *json, const char *key);
+void json_end_array(JSONWriter *json);
+
+void json_write_string(JSONWriter *json, const char *key, const char *value);
+void json_write_int(JSONWriter *json, const char *key, int64_t value);
+void json_write_uint(JSONWriter *json, const char *key, uint64_t value);
+void json_write_number(JSONWriter *json, const char *key, double value);
+void json_write_bool(JSONWriter *json, const char *key, int value);
+void json_write_null(JSONWriter *json, const char *key);
+void json_write_raw(JSONWriter *json, const char *key, const char *value, size_t length);
+
+// String escaping. The output buffer must hold JSON_ESCAPE_MAX_EXPANSION
+// bytes per input byte. json_escape() uses the widest implementation the CPU
+// supports (AVX2, SSE2 or scalar); json_escape_backend() returns a specific
+// one by name, or NULL if it is not available on this machine.
+#define JSON_ESCAPE_MAX_EXPANSION 6
+
+typedef size_t (*JSONEscapeFn)(char *out, const char *in, size_t length);
+
+size_t json_escape(char *out, const char *in, size_t length);
+size_t json_escape_scalar(char *out, const char *in, size_t length);
+JSONEscapeFn json_escape_backend(const char *name);
+const char* json_escape_backend_name();
+
+// Formatting helpers; return the number of characters written (no NUL)
+size_t json_format_uint(char *out, uint64_t value);
+size_t json_format_int(char *out, int64_t value);
+size_t json_format_fixed2(char *out, double value);
 
 #endif // JSON_H
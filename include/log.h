@@ -0,0 +1,56 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdio.h>
+#include <stdatomic.h>
+
+#define LOG_MESSAGE_MAX 200
+#define LOG_RING_SLOTS 64   // Per-thread ring capacity (power of two)
+#define LOG_MAX_RINGS 128   // Threads that can hold a ring at the same time
+
+typedef enum {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR
+} LogLevel;
+
+typedef enum {
+    LOG_FORMAT_LOGFMT,
+    LOG_FORMAT_JSON
+} LogFormat;
+
+// Starts the background writer. Until then records are written synchronously.
+int log_init(LogLevel level, LogFormat format);
+void log_shutdown();
+
+// Writes records to stream instead of stdout; call before log_init()
+void log_set_stream(FILE *stream);
+
+int log_parse_level(const char *name, LogLevel *level);
+int log_parse_format(const char *name, LogFormat *format);
+int log_enabled(LogLevel level);
+
+// Sampling rate for high-volume call sites such as the per-request line
+void log_set_sample_rate(unsigned every);
+unsigned log_sample_rate();
+
+// Enqueues a record on the calling thread's ring; never blocks. The event is
+// a short static identifier, the message is formatted printf-style.
+void log_write(LogLevel level, const char *event, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define log_debug(event, ...) log_write(LOG_DEBUG, event, __VA_ARGS__)
+#define log_info(event, ...) log_write(LOG_INFO, event, __VA_ARGS__)
+#define log_warn(event, ...) log_write(LOG_WARN, event, __VA_ARGS__)
+#define log_error(event, ...) log_write(LOG_ERROR, event, __VA_ARGS__)
+
+// Emits only every n-th record from this call site
+#define log_sampled(level, n, event, ...) do { \
+        static atomic_uint log_sample_counter_; \
+        if (log_enabled(level) && \
+            atomic_fetch_add_explicit(&log_sample_counter_, 1, memory_order_relaxed) % (n) == 0) \
+            log_write(level, event, __VA_ARGS__); \
+    } while (0)
+
+#endif // LOG_H
@@ -0,0 +1,32 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include "server.h"
+#include "network.h"
+#include "arena.h"
+
+// Log-linear histogram: 4 linear sub-buckets per power of two, in microseconds.
+// Finite buckets end at 2^(METRICS_MAX_EXPONENT + 1) us (~268 s); anything
+// slower is only counted in +Inf.
+#define METRICS_SUB_BUCKET_BITS 2
+#define METRICS_MAX_EXPONENT 27  // Last power of two with finite buckets
+#define METRICS_HISTOGRAM_BUCKETS \
+    ((METRICS_MAX_EXPONENT - METRICS_SUB_BUCKET_BITS + 2) << METRICS_SUB_BUCKET_BITS)
+
+// Number of counter shards; threads are spread across them round-robin
+#define METRICS_SHARDS 16
+
+// Request accounting (lock-free, per-thread shard)
+uint64_t metrics_now_us();
+void metrics_request_begin(RouteId route);
+void metrics_request_end(RouteId route, int status_code, uint64_t elapsed_us);
+
+// Latest measurement gauges
+void metrics_record_speed_test(const SpeedTestResult *result);
+void metrics_record_interface(const char *name, uint64_t bytes_sent, uint64_t bytes_recv);
+
+// Prometheus text exposition, allocated from arena; NULL if out of memory
+char* metrics_render(Arena *arena, size_t *length);
+
+#endif // METRICS_H
@@ -0,0 +1,120 @@
+#ifndef NETDIAG_SHM_H
+#define NETDIAG_SHM_H
+
+// Layout of the shared-memory stats segment and a header-only reader for
+// local agents. Readers need no sockets, no JSON and no library: include this
+// file (with _POSIX_C_SOURCE >= 200112L under strict C modes), link -lrt on
+// older glibc, then
+//
+//     NetdiagShmReader reader;
+//     NetdiagStats stats;
+//     if (netdiag_shm_open(&reader, NETDIAG_SHM_DEFAULT_NAME) == 0 &&
+//         netdiag_shm_read(&reader, &stats) == 0)
+//         printf("%s %.1f B/s\n", stats.interfaces[0].name,
+//                stats.interfaces[0].rx_bytes_per_sec);
+//     netdiag_shm_close(&reader);
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define NETDIAG_SHM_DEFAULT_NAME "/netdiag-stats"
+#define NETDIAG_SHM_MAGIC 0x5344544eu  // "NTDS"
+#define NETDIAG_SHM_LAYOUT_VERSION 1
+#define NETDIAG_SHM_MAX_INTERFACES 16
+#define NETDIAG_SHM_READ_RETRIES 1000
+
+typedef struct {
+    char name[32];
+    uint64_t bytes_sent;
+    uint64_t bytes_recv;
+    double tx_bytes_per_sec;
+    double rx_bytes_per_sec;
+} NetdiagShmInterface;
+
+typedef struct {
+    int64_t updated_at;  // Unix time of the last update
+    char ipv4[64];
+    char ipv6[64];
+    char gateway[64];
+    char dns1[64];
+    char dns2[64];
+    int64_t speed_test_time;  // 0 until a speed test has completed
+    double download_mbps;
+    double upload_mbps;
+    double ping_ms;
+    uint32_t interface_count;
+    uint32_t reserved;
+    NetdiagShmInterface interfaces[NETDIAG_SHM_MAX_INTERFACES];
+} NetdiagStats;
+
+// The writer makes sequence odd, updates stats, then makes it even again.
+// A copy taken between two equal, even reads of sequence is consistent.
+typedef struct {
+    uint32_t magic;
+    uint32_t layout_version;
+    uint32_t size;  // sizeof(NetdiagShmSegment) in the writer
+    uint32_t writer_pid;
+    _Atomic uint64_t sequence;
+    NetdiagStats stats;
+} NetdiagShmSegment;
+
+typedef struct {
+    NetdiagShmSegment *segment;
+} NetdiagShmReader;
+
+// Maps the segment read-only. Returns -1 if it does not exist or was written
+// by an incompatible version.
+static inline int netdiag_shm_open(NetdiagShmReader *reader, const char *name) {
+    reader->segment = NULL;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return -1;
+
+    void *map = mmap(NULL, sizeof(NetdiagShmSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    NetdiagShmSegment *segment = (NetdiagShmSegment *)map;
+    if (segment->magic != NETDIAG_SHM_MAGIC ||
+        segment->layout_version != NETDIAG_SHM_LAYOUT_VERSION ||
+        segment->size != sizeof(NetdiagShmSegment)) {
+        munmap(map, sizeof(NetdiagShmSegment));
+        return -1;
+    }
+
+    reader->segment = segment;
+    return 0;
+}
+
+// Copies a consistent snapshot. Returns -1 if the writer kept the segment
+// busy for NETDIAG_SHM_READ_RETRIES attempts.
+static inline int netdiag_shm_read(const NetdiagShmReader *reader, NetdiagStats *out) {
+    NetdiagShmSegment *segment = reader->segment;
+
+    for (int attempt = 0; attempt < NETDIAG_SHM_READ_RETRIES; attempt++) {
+        uint64_t before = atomic_load_explicit(&segment->sequence, memory_order_acquire);
+        if (before & 1)
+            continue;
+
+        memcpy(out, &segment->stats, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&segment->sequence, memory_order_relaxed) == before)
+            return 0;
+    }
+    return -1;
+}
+
+static inline void netdiag_shm_close(NetdiagShmReader *reader) {
+    if (reader->segment)
+        munmap(reader->segment, sizeof(NetdiagShmSegment));
+    reader->segment = NULL;
+}
+
+#endif // NETDIAG_SHM_H
@@ -1,6 +1,8 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
+#include <stdio.h>
+#include <stdint.h>
 #include <time.h>
 
 typedef struct {
@@ -35,10 +37,45 @@ typedef struct {
     char bytes_recv[64];
 } InterfaceStats;
 
+#define MAX_INTERFACES 32
+
+// Raw /proc/net/dev counters of one interface
+typedef struct {
+    char name[32];
+    uint64_t bytes_sent;
+    uint64_t bytes_recv;
+} InterfaceCounters;
+
+#define TRACEROUTE_MAX_HOPS 30
+#define TRACEROUTE_IDLE_SEC 60  // Probing stops this long after the last read
+#define TRACEROUTE_BUSY -2
+
+typedef struct {
+    int ttl;
+    char address[64];
+    int sent;
+    int received;
+    int is_destination;
+    double last_ms;
+    double best_ms;
+    double worst_ms;
+    double avg_ms;
+    double m2;  // Running sum of squared deviations (Welford)
+} TracerouteHop;
+
+typedef struct {
+    char target[64];
+    int hop_count;
+    int rounds;
+    time_t last_round;
+    TracerouteHop hops[TRACEROUTE_MAX_HOPS];
+} TracerouteReport;
+
 // Network functions
 int get_ipv4_address(char *ipv4);
 int get_ipv6_address(char *ipv6);
 int get_gateway_address(char *gateway);
+int parse_net_route(FILE *fp, char *gateway);
 int get_dns_servers(char *dns1, char *dns2);
 int get_network_info(NetworkInfo *info);
 
@@ -48,15 +85,36 @@ int perform_speed_test(SpeedTestResult *result);
 double measure_download_speed();
 double measure_upload_speed();
 
+// Optional observer for a running speed test. phase is "ping", "download" or
+// "upload"; percent is the overall progress and mbps the current estimate.
+typedef void (*SpeedTestProgressFn)(const char *phase, double percent, double mbps);
+void set_speed_test_progress_callback(SpeedTestProgressFn fn);
+
+// Traceroute functions
+int traceroute_round(const char *target, double rtt_ms[], char addresses[][64], int max_ttl);
+// One target is traced at a time: returns TRACEROUTE_BUSY while another
+// target still has readers, -1 if the probe thread cannot be started
+int start_traceroute(const char *target);
+// Also counts as a read that keeps the trace running
+int get_traceroute_report(TracerouteReport *report, int wait_ms);
+double traceroute_hop_stddev(const TracerouteHop *hop);
+
 // ISP Info functions
+// Resolves the system time zone against tzdata once; later calls copy the
+// cached result
+void load_isp_info();
 int get_isp_info(ISPInfo *info);
 
 // Interface stats
 int get_interface_stats(InterfaceStats *stats);
+int parse_net_dev(FILE *fp, InterfaceStats *stats);
+int get_interface_counters(InterfaceCounters counters[], int max);
+int parse_net_dev_counters(FILE *fp, InterfaceCounters counters[], int max);
 int get_wifi_interface_name(char *interface);
 int get_wifi_signal_strength(const char *interface, int *strength);
 
 // Utility
 void cleanup_network();
+void stop_traceroute();
 
 #endif // NETWORK_H
@@ -0,0 +1,59 @@
+#ifndef RESOURCE_H
+#define RESOURCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "emit.h"
+
+#define RESOURCE_BODY_MAX 8192
+#define RESOURCE_ETAG_MAX 96
+#define RESOURCE_MAX_WAIT_MS 60000
+
+typedef enum {
+    RESOURCE_NETWORK_INFO,
+    RESOURCE_ISP_INFO,
+    RESOURCE_INTERFACE_STATS,
+    RESOURCE_SOCKET_STATS,
+    RESOURCE_COUNT
+} ResourceId;
+
+#define RESOURCE_MASK(id) (1u << (id))
+
+// Writes the resource's document (root value)
+typedef void (*ResourceBuildFn)(Emitter *out);
+
+typedef struct {
+    char body[RESOURCE_BODY_MAX];
+    size_t length;
+    uint64_t version;
+} ResourceSnapshot;
+
+// Versioned cache of API documents. A resource is rebuilt at most once per
+// ttl_ms no matter how many clients ask, and concurrent requests for a stale
+// resource share one rebuild. Every rebuild encodes the document in all
+// encodings at once. The version only increases when the rebuilt body differs
+// from the previous one.
+void resource_register(ResourceId id, unsigned ttl_ms, ResourceBuildFn build);
+
+// Fills out[] with the given encoding of every resource in mask, rebuilding
+// stale ones in parallel. With known != NULL, blocks for up to timeout_ms
+// until at least one of them has a version other than known[id]. Returns 1 if
+// a version differs from known (always 1 without known), 0 on timeout.
+int resource_wait(unsigned mask, Encoding encoding, const uint64_t known[RESOURCE_COUNT],
+                  unsigned timeout_ms, ResourceSnapshot out[RESOURCE_COUNT]);
+// 1 if every resource in mask is cached, not being rebuilt, and stays fresh
+// for at least margin_ms more, so resource_wait() without known returns it
+// straight from the cache if called within that margin
+int resource_fresh(unsigned mask, unsigned margin_ms);
+
+// ETags look like "<boot id>-<version>[.<version>...]", one version per
+// resource in mask in id order, with "+<encoding>" appended for encodings
+// other than JSON. Parsing returns -1 for tags from another process, another
+// selection or another encoding.
+void resource_format_etag(unsigned mask, Encoding encoding,
+                          const ResourceSnapshot snapshots[RESOURCE_COUNT],
+                          char *out, size_t size);
+int resource_parse_etag(const char *etag, unsigned mask, Encoding encoding,
+                        uint64_t known[RESOURCE_COUNT]);
+
+#endif // RESOURCE_H
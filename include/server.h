@@ -1,32 +1,190 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "emit.h"
+#include "assets.h"
+#include "executor.h"
+#include "arena.h"
+
 #define SERVER_PORT 8080
 #define MAX_BUFFER_SIZE 4096
 #define MAX_CONNECTIONS 100
+#define JSON_RESPONSE_MAX 16384
+#define INLINE_FRESH_MARGIN_MS 100      // Cached resources served inline must stay fresh this long
+#define CLIENT_READ_TIMEOUT_MS 5000
+#define ACCEPT_POLL_MS 250  // Longest the accept thread sleeps between timeout checks
+#define ACCEPT_WAITING_MAX 256  // Connections waiting for their request, also the io_uring slots
+#define REQUEST_ARENA_SIZE (256 * 1024)  // Fits the largest /api/history response
+
+// Lane defaults: workers and queue capacity per lane, and the per-client
+// request rate on the slow lane (a speed test takes about ten seconds)
+#define LANE_FAST_WORKERS 8
+#define LANE_FAST_QUEUE 256
+#define LANE_WAIT_WORKERS 64
+#define LANE_WAIT_QUEUE 64
+#define LANE_SLOW_WORKERS 2
+#define LANE_SLOW_QUEUE 16
+#define SLOW_RATE_PER_MINUTE 12
+#define SLOW_RATE_BURST 4
+#define RESPONSE_CAPTURE_PARTS 2
+
+typedef enum {
+    ROUTE_INDEX,
+    ROUTE_NETWORK_INFO,
+    ROUTE_SPEED_TEST,
+    ROUTE_ISP_INFO,
+    ROUTE_INTERFACE_STATS,
+    ROUTE_SOCKET_STATS,
+    ROUTE_TRACEROUTE,
+    ROUTE_ALL,
+    ROUTE_EVENTS,
+    ROUTE_HISTORY,
+    ROUTE_FLEET,
+    ROUTE_WIRELESS,
+    ROUTE_METRICS,
+    ROUTE_STATIC,
+    ROUTE_PREFLIGHT,
+    ROUTE_NOT_FOUND,
+    ROUTE_COUNT
+} RouteId;
 
 typedef struct {
+    char method[16];
+    char path[256];
+    char protocol[16];
+    const char *query;    // After '?', or NULL
+    const char *headers;  // Raw header lines following the request line
+} HttpRequest;
+
+// Requests are read on the fast lane and, once routed, either handled there
+// or handed to the lane their route belongs to, each with its own workers
+// and bounded queue, so slow measurements cannot starve cheap reads
+typedef enum {
+    LANE_FAST,  // Cached resources, static assets, metrics
+    LANE_WAIT,  // Long polls (?wait=), which hold a worker until data changes
+    LANE_SLOW,  // Network-bound measurements, rate limited per client
+    LANE_COUNT
+} LaneId;
+
+typedef struct ClientConnection {
+    // Free-list link while the slot is unused; links of the accept thread's
+    // list while the connection waits for its request
+    struct ClientConnection *next;
+    struct ClientConnection *prev;
+    uint64_t read_deadline;   // metrics_now_us() by which the request must arrive
     int socket_fd;
+    uint32_t client_address;  // IPv4, network byte order
     char buffer[MAX_BUFFER_SIZE];
-    int request_complete;
+    HttpRequest request;      // Points into buffer
+    RouteId route;
+    uint64_t started_at;      // metrics_now_us() when the request was read
 } ClientConnection;
 
+// How sockets are driven: blocking calls on lane workers, or one io_uring
+// submission/completion loop that hands only non-fast routes to workers
+typedef enum {
+    IO_BACKEND_PORTABLE,
+    IO_BACKEND_URING
+} IoBackend;
+
+// A response described instead of written: iov points into buffer, into
+// overflow for responses larger than buffer, or at persistent data such as
+// embedded assets. iov_count == 0 means the handler did not respond.
+typedef struct {
+    char *buffer;
+    size_t capacity;
+    Arena *overflow;
+    struct iovec iov[RESPONSE_CAPTURE_PARTS];
+    int iov_count;
+} ResponseCapture;
+
 // Server functions
 int start_server(int port);
 int stop_server();
-void handle_client_connection(int client_fd);
 void send_response(int client_fd, int status_code, const char *content_type, const char *body);
+void send_response_body(int client_fd, int status_code, const char *content_type,
+                        const char *body, size_t body_len);
+void send_response_extra(int client_fd, int status_code, const char *content_type,
+                         const char *extra_headers, const char *body, size_t body_len);
+void send_emitter_response(int client_fd, Emitter *out, Encoding encoding);
 void send_file(int client_fd, const char *filepath);
 
+// Web UI: embedded assets by default, or files under dir (e.g. "./web")
+// when a directory is set for development
+void server_set_web_root(const char *dir);
+const Asset* find_asset(const char *path);
+void send_asset(int client_fd, const HttpRequest *request, const Asset *asset);
+
+// Routing
+RouteId resolve_route(const char *method, const char *path);
+const char* route_name(RouteId route);
+LaneId route_lane(RouteId route, const char *query);
+const char* lane_name(LaneId lane);
+int http_request_header(const HttpRequest *request, const char *name, char *out, size_t out_size);
+
 // Request handlers
-void handle_network_info_request(int client_fd);
-void handle_speed_test_request(int client_fd);
-void handle_isp_info_request(int client_fd);
+void handle_network_info_request(int client_fd, const HttpRequest *request);
+void handle_speed_test_request(int client_fd, const HttpRequest *request);
+void handle_isp_info_request(int client_fd, const HttpRequest *request);
 void handle_static_file_request(int client_fd, const char *filepath);
-void handle_interface_stats_request(int client_fd);
+void handle_interface_stats_request(int client_fd, const HttpRequest *request);
+void handle_socket_stats_request(int client_fd, const HttpRequest *request);
+void handle_traceroute_request(int client_fd, const HttpRequest *request);
+void handle_all_request(int client_fd, const HttpRequest *request);
+int handle_events_request(int client_fd);
+void handle_history_request(int client_fd, const HttpRequest *request);
+void handle_fleet_request(int client_fd);
+void handle_wireless_request(int client_fd, const HttpRequest *request);
+void handle_metrics_request(int client_fd);
+
+// Lanes; configure before the accept loop starts. slow_per_minute is the
+// per-client request rate on the slow lane, 0 for no limit.
+int server_configure_lane(LaneId lane, int workers, size_t queue);
+void server_set_slow_rate(double slow_per_minute, double burst);
+int server_lane_stats(LaneId lane, LaneStats *stats);
+
+// Backend for the accept loop; io_uring falls back to portable when the
+// kernel does not support it. Names are "portable" and "io_uring".
+void server_set_io_backend(IoBackend backend);
+int io_backend_parse(const char *name, IoBackend *backend);
+
+// Registers the cached resources, allocates the connection pool and starts
+// the lanes; the accept loop does this itself
+int server_start_workers();
+void server_stop_workers();
+// A pooled connection for an accepted socket; NULL when all are in use
+ClientConnection* client_connection_acquire(int socket_fd, uint32_t client_address);
+void client_connection_release(ClientConnection *connection);
+// Parses the length bytes read into connection->buffer and resolves the route
+void client_connection_parse(ClientConnection *connection, size_t length);
+// Returns 1 if the route belongs to the fast lane and the caller should
+// handle it; otherwise queues the connection on its lane (or answers 429 or
+// 503) and returns 0
+int client_connection_route(ClientConnection *connection);
+// Runs the route's handler; returns 1 if the handler kept the socket
+int handle_client_request(ClientConnection *connection);
+// Makes this thread's responses go to capture until called with NULL. While
+// capturing, 429/503 rejections are captured too and leave the socket open
+// for the caller to send and close.
+void server_capture_responses(ResponseCapture *capture);
+// 1 if handling a fast-lane connection could block or write to the socket
+// itself: event streams, files under --web-root, and cached resources that
+// are stale or being rebuilt
+int client_connection_blocks(const ClientConnection *connection);
+// Queues a connection that was already read and routed on the fast lane,
+// answering 503 if its queue is full
+void client_connection_defer(ClientConnection *connection);
+
+// Per-worker arena for response memory whose size depends on the request;
+// reset once the response has been sent
+Arena* server_request_arena();
 
-// Thread function
-void* handle_client_connection_thread(void* arg);
+// Lane tasks: reading and routing a new connection, and handling a routed one
+void serve_client_connection(void *connection);
+void dispatch_client_connection(void *connection);
 
 // Server thread
 void* server_accept_loop(void *arg);
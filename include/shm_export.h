@@ -0,0 +1,17 @@
+#ifndef SHM_EXPORT_H
+#define SHM_EXPORT_H
+
+#include "netdiag_shm.h"
+#include "network.h"
+
+#define SHM_EXPORT_INTERVAL_MS 1000
+
+// Publishes network info, per-interface counters and rates, and the latest
+// speed test into a POSIX shared-memory segment (layout in netdiag_shm.h).
+// A background thread refreshes it every SHM_EXPORT_INTERVAL_MS.
+int shm_export_start(const char *name);
+void shm_export_stop();
+
+void shm_export_speed_test(const SpeedTestResult *result);
+
+#endif // SHM_EXPORT_H
@@ -0,0 +1,57 @@
+#ifndef SOCKSTAT_H
+#define SOCKSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "emit.h"
+
+#define SOCKSTAT_TOP_N 10
+#define SOCKSTAT_STATE_COUNT 13  // Indexed by kernel TCP state (TCP_ESTABLISHED = 1 ...)
+
+typedef struct {
+    char local[56];    // "addr:port", IPv6 addresses in brackets
+    char remote[56];
+    uint8_t state;
+    uint32_t retransmits;  // Segments retransmitted over the connection's life
+    uint32_t rtt_us;       // Smoothed RTT
+    uint32_t rttvar_us;
+    uint32_t unacked;
+} SockStatConnection;
+
+typedef struct {
+    uint32_t total;
+    uint32_t states[SOCKSTAT_STATE_COUNT];
+} SockStatCounts;
+
+// Everything is fixed-size, so a collection pass allocates nothing no
+// matter how many sockets the host has
+typedef struct {
+    SockStatCounts tcp;
+    SockStatCounts udp;
+    uint64_t tcp_retransmits;  // Sum over all TCP sockets
+    int top_retransmits_count;
+    SockStatConnection top_retransmits[SOCKSTAT_TOP_N];  // Descending
+    int top_rtt_count;
+    SockStatConnection top_rtt[SOCKSTAT_TOP_N];          // Descending
+} SockStats;
+
+// Socket statistics from the kernel's inet_diag interface (NETLINK_SOCK_DIAG):
+// one dump per protocol and address family, each socket counted and ranked
+// as its message arrives, with TCP metrics taken from struct tcp_info.
+
+void sockstat_reset(SockStats *stats);
+// Accounts one SOCK_DIAG_BY_FAMILY reply (netlink header included) for
+// protocol IPPROTO_TCP or IPPROTO_UDP. Returns -1 if it is malformed.
+int sockstat_account(SockStats *stats, int protocol, const void *message, size_t length);
+
+// Runs the TCP and UDP dumps for IPv4 and IPv6. Returns -1 if sock_diag is
+// unavailable.
+int sockstat_collect(SockStats *stats);
+
+// "established", "time_wait", ...; NULL for numbers no TCP state uses
+const char* sockstat_state_name(int state);
+
+// Writes the statistics as a document (root value)
+void sockstat_write(Emitter *out, const SockStats *stats);
+
+#endif // SOCKSTAT_H
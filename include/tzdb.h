@@ -0,0 +1,62 @@
+#ifndef TZDB_H
+#define TZDB_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TZDB_DEFAULT_DIR "/usr/share/zoneinfo"
+
+typedef struct {
+    uint32_t name;     // Offsets into the string pool
+    uint32_t target;   // Links: the zone this name points to; 0 for zones
+    char country[3];   // ISO 3166 code of the zone's principal location
+    double latitude;
+    double longitude;
+} TzEntry;
+
+// Zones from zone1970.tab, links from tzdata.zi and country names from
+// iso3166.tab, loaded once into one string pool, an entry array and an
+// open-addressing hash table, so a lookup is a hash probe with no I/O.
+typedef struct {
+    char *pool;
+    size_t pool_used;
+    size_t pool_capacity;
+    TzEntry *entries;
+    int entry_count;
+    int entry_capacity;
+    uint32_t *slots;        // Entry index + 1; 0 marks an empty slot
+    size_t slot_mask;
+    uint32_t countries[26 * 26];  // Pool offset of the name, by two-letter code
+} TzIndex;
+
+typedef struct {
+    const char *zone;     // Canonical zone name, after following links
+    char country_code[3];
+    const char *country;  // NULL if iso3166.tab does not list the code
+    double latitude;
+    double longitude;
+} TzLocation;
+
+void tz_index_init(TzIndex *index);
+void tz_index_free(TzIndex *index);
+
+// Parsers for the tzdata files; each returns the number of records added,
+// or -1 if memory ran out. Malformed lines are skipped.
+int tz_index_load_zones(TzIndex *index, FILE *fp);      // zone1970.tab
+int tz_index_load_countries(TzIndex *index, FILE *fp);  // iso3166.tab
+int tz_index_load_links(TzIndex *index, FILE *fp);      // "L" lines of tzdata.zi
+// Builds the hash table; call after loading and before lookups
+int tz_index_finish(TzIndex *index);
+
+// All of the above from a zoneinfo directory. Only zone1970.tab is required.
+int tz_index_open(TzIndex *index, const char *dir);
+
+// Returns -1 if the name is neither a zone nor a link to one
+int tz_lookup(const TzIndex *index, const char *zone, TzLocation *out);
+
+// The system time zone name, from $TZ, the /etc/localtime symlink or
+// /etc/timezone, in that order; "UTC" if none of them names one
+void tz_system_zone(char *out, size_t size);
+
+#endif // TZDB_H
@@ -0,0 +1,28 @@
+#ifndef URING_H
+#define URING_H
+
+#include "server.h"
+
+#define URING_ENTRIES 512           // Submission queue depth
+#define URING_BUFFERS 256           // Provided receive buffers (power of two)
+#define URING_CONNECTIONS ACCEPT_WAITING_MAX  // Connections being read or written at once
+#define URING_SEND_BUFFER (JSON_RESPONSE_MAX + 1024)
+#define URING_OVERFLOW_ARENA (64 * 1024)  // Per connection, for larger responses
+#define URING_TICK_MS 250           // How often the loop checks for shutdown
+
+// Serves the listening socket from one io_uring: a multishot accept on the
+// socket registered as a fixed file, receives into a kernel-selected
+// provided buffer with a linked timeout, and each fast-lane response sent
+// with a send linked to the socket's close. The loop never writes to a
+// socket itself: responses too large for the send buffer are copied into
+// the connection's overflow arena, and fast routes that write directly
+// (event streams, --web-root files) go to the fast-lane workers. Routes for
+// the wait and slow lanes are queued to their workers exactly as on the
+// portable path.
+//
+// Needs server_start_workers() to have run. Returns when *running drops to
+// 0, or -1 if this kernel cannot run the loop, so the caller can fall back
+// to blocking accept().
+int uring_serve(int listen_fd, volatile int *running);
+
+#endif // URING_H
@@ -0,0 +1,81 @@
+#ifndef WIRELESS_H
+#define WIRELESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "emit.h"
+
+#define WIRELESS_MAX_INTERFACES 8
+#define WIRELESS_MAX_STATIONS 32
+#define WIRELESS_SAMPLE_INTERVAL_MS 2000
+
+// Station fields a driver may leave out; WirelessStation.present has a bit
+// for each one it reported
+enum {
+    WIRELESS_HAS_SIGNAL = 1 << 0,
+    WIRELESS_HAS_SIGNAL_AVG = 1 << 1,
+    WIRELESS_HAS_TX_BITRATE = 1 << 2,
+    WIRELESS_HAS_RX_BITRATE = 1 << 3,
+    WIRELESS_HAS_TX_RETRIES = 1 << 4,
+    WIRELESS_HAS_TX_FAILED = 1 << 5,
+};
+
+typedef struct {
+    int ifindex;
+    char name[32];
+    char ssid[33];
+    int iftype;       // enum nl80211_iftype
+} WirelessInterface;
+
+// One peer of an interface; for a client interface that is the access point
+typedef struct {
+    int ifindex;
+    char mac[18];
+    unsigned present;
+    int signal_dbm;
+    int signal_avg_dbm;
+    uint32_t tx_bitrate_kbps;
+    uint32_t rx_bitrate_kbps;
+    uint32_t tx_packets;
+    uint32_t rx_packets;
+    uint32_t tx_retries;
+    uint32_t tx_failed;
+    uint32_t inactive_ms;
+    uint32_t connected_s;
+} WirelessStation;
+
+typedef struct {
+    time_t sampled_at;
+    int interface_count;
+    WirelessInterface interfaces[WIRELESS_MAX_INTERFACES];
+    int station_count;
+    WirelessStation stations[WIRELESS_MAX_STATIONS];
+} WirelessSnapshot;
+
+// Generic-netlink nl80211 client. Interfaces and per-station link metrics
+// are read in-process with two netlink dumps; no wireless tools are run.
+
+// Parse one complete NL80211_CMD_NEW_INTERFACE / NL80211_CMD_NEW_STATION
+// message (netlink header included). Return -1 if it is malformed or of
+// another command.
+int wireless_parse_interface(const void *message, size_t length, WirelessInterface *out);
+int wireless_parse_station(const void *message, size_t length, WirelessStation *out);
+
+// Takes a fresh sample. Returns -1 if nl80211 is unavailable (no wireless
+// driver loaded), which is not the same as having no wireless interfaces.
+int wireless_sample(WirelessSnapshot *out);
+
+// Samples every interval_ms in the background over one long-lived socket,
+// so readers never wait on the kernel. Fails if nl80211 is unavailable.
+int wireless_start_sampler(unsigned interval_ms);
+void wireless_stop_sampler();
+
+// The latest background sample, or a fresh one if the sampler is not running
+int wireless_get_snapshot(WirelessSnapshot *out);
+
+// Writes the snapshot as a document (root value), stations nested in their
+// interfaces; fields the driver did not report are null
+void wireless_write_snapshot(Emitter *out, const WirelessSnapshot *snapshot);
+
+#endif // WIRELESS_H
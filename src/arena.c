@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/arena.h"
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    _Alignas(ARENA_ALIGNMENT) char data[];
+};
+
+int arena_init(Arena *arena, size_t capacity) {
+    memset(arena, 0, sizeof(*arena));
+    arena->base = malloc(capacity);
+    if (arena->base == NULL)
+        return -1;
+    arena->capacity = capacity;
+    return 0;
+}
+
+void arena_destroy(Arena *arena) {
+    arena_reset(arena);
+    free(arena->base);
+    memset(arena, 0, sizeof(*arena));
+}
+
+static void* alloc_oversized(Arena *arena, size_t size) {
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (block == NULL)
+        return NULL;
+    block->next = arena->oversized;
+    arena->oversized = block;
+    arena->overflows++;
+    return block->data;
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    size_t offset = (arena->used + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (offset > arena->capacity || size > arena->capacity - offset)
+        return alloc_oversized(arena, size);
+
+    arena->last = offset;
+    arena->used = offset + size;
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    return arena->base + offset;
+}
+
+void* arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (ptr == NULL)
+        return arena_alloc(arena, new_size);
+
+    // The top allocation grows in place while the block has room
+    if ((char *)ptr == arena->base + arena->last && arena->last + old_size == arena->used &&
+        new_size <= arena->capacity - arena->last) {
+        arena->used = arena->last + new_size;
+        if (arena->used > arena->peak)
+            arena->peak = arena->used;
+        return ptr;
+    }
+
+    void *grown = arena_alloc(arena, new_size);
+    if (grown != NULL)
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    return grown;
+}
+
+void arena_reset(Arena *arena) {
+    while (arena->oversized) {
+        ArenaBlock *next = arena->oversized->next;
+        free(arena->oversized);
+        arena->oversized = next;
+    }
+    arena->used = 0;
+    arena->last = 0;
+}
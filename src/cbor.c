@@ -0,0 +1,179 @@
+#include <string.h>
+#include "../include/cbor.h"
+
+// Major types (RFC 8949 section 3.1) and simple values
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+#define CBOR_FALSE 0xf4
+#define CBOR_TRUE 0xf5
+#define CBOR_NULL 0xf6
+#define CBOR_FLOAT32 0xfa
+#define CBOR_FLOAT64 0xfb
+#define CBOR_INDEFINITE 31
+#define CBOR_BREAK 0xff
+
+void cbor_writer_init(CBORWriter *cbor, void *buffer, size_t capacity) {
+    cbor->data = buffer;
+    cbor->size = 0;
+    cbor->capacity = capacity;
+    cbor->depth = 0;
+    cbor->error = 0;
+}
+
+static int cbor_reserve(CBORWriter *cbor, size_t n) {
+    if (cbor->error)
+        return 0;
+    if (cbor->size + n > cbor->capacity) {
+        cbor->error = 1;
+        return 0;
+    }
+    return 1;
+}
+
+static void cbor_put(CBORWriter *cbor, const void *bytes, size_t length) {
+    if (cbor_reserve(cbor, length)) {
+        memcpy(cbor->data + cbor->size, bytes, length);
+        cbor->size += length;
+    }
+}
+
+static void cbor_put_byte(CBORWriter *cbor, unsigned char byte) {
+    if (cbor_reserve(cbor, 1))
+        cbor->data[cbor->size++] = byte;
+}
+
+// Big-endian argument of `bytes` bytes after the initial byte
+static void cbor_put_be(CBORWriter *cbor, unsigned char initial, uint64_t value, int bytes) {
+    if (!cbor_reserve(cbor, 1 + bytes))
+        return;
+    unsigned char *out = cbor->data + cbor->size;
+    out[0] = initial;
+    for (int i = bytes; i > 0; i--) {
+        out[i] = (unsigned char)value;
+        value >>= 8;
+    }
+    cbor->size += 1 + bytes;
+}
+
+// Initial byte plus the shortest argument encoding for value
+static void cbor_put_head(CBORWriter *cbor, int major, uint64_t value) {
+    unsigned char type = (unsigned char)(major << 5);
+
+    if (value < 24)
+        cbor_put_byte(cbor, type | (unsigned char)value);
+    else if (value <= 0xff)
+        cbor_put_be(cbor, type | 24, value, 1);
+    else if (value <= 0xffff)
+        cbor_put_be(cbor, type | 25, value, 2);
+    else if (value <= 0xffffffffULL)
+        cbor_put_be(cbor, type | 26, value, 4);
+    else
+        cbor_put_be(cbor, type | 27, value, 8);
+}
+
+static void cbor_put_text(CBORWriter *cbor, const char *text) {
+    size_t length = strlen(text);
+    cbor_put_head(cbor, CBOR_TEXT, length);
+    cbor_put(cbor, text, length);
+}
+
+// Inside a map every value is preceded by its key
+static void cbor_prefix(CBORWriter *cbor, const char *key) {
+    if (key)
+        cbor_put_text(cbor, key);
+}
+
+static void cbor_open(CBORWriter *cbor, const char *key, int major) {
+    cbor_prefix(cbor, key);
+    if (cbor->depth >= CBOR_MAX_DEPTH) {
+        cbor->error = 1;
+        return;
+    }
+    cbor_put_byte(cbor, (unsigned char)(major << 5 | CBOR_INDEFINITE));
+    cbor->depth++;
+}
+
+static void cbor_close(CBORWriter *cbor) {
+    if (cbor->depth == 0) {
+        cbor->error = 1;
+        return;
+    }
+    cbor->depth--;
+    cbor_put_byte(cbor, CBOR_BREAK);
+}
+
+void cbor_begin_map(CBORWriter *cbor, const char *key) {
+    cbor_open(cbor, key, CBOR_MAP);
+}
+
+void cbor_end_map(CBORWriter *cbor) {
+    cbor_close(cbor);
+}
+
+void cbor_begin_array(CBORWriter *cbor, const char *key) {
+    cbor_open(cbor, key, CBOR_ARRAY);
+}
+
+void cbor_end_array(CBORWriter *cbor) {
+    cbor_close(cbor);
+}
+
+void cbor_write_string(CBORWriter *cbor, const char *key, const char *value) {
+    cbor_prefix(cbor, key);
+    cbor_put_text(cbor, value ? value : "");
+}
+
+void cbor_write_int(CBORWriter *cbor, const char *key, int64_t value) {
+    cbor_prefix(cbor, key);
+    if (value < 0)
+        cbor_put_head(cbor, CBOR_NEGATIVE, (uint64_t)(-1 - value));
+    else
+        cbor_put_head(cbor, CBOR_UNSIGNED, (uint64_t)value);
+}
+
+void cbor_write_uint(CBORWriter *cbor, const char *key, uint64_t value) {
+    cbor_prefix(cbor, key);
+    cbor_put_head(cbor, CBOR_UNSIGNED, value);
+}
+
+void cbor_write_double(CBORWriter *cbor, const char *key, double value) {
+    cbor_prefix(cbor, key);
+
+    // Single precision when it round-trips (NaN never compares equal and
+    // stays double, which is still valid)
+    float narrow = (float)value;
+    if ((double)narrow == value) {
+        uint32_t bits;
+        memcpy(&bits, &narrow, sizeof(bits));
+        cbor_put_be(cbor, CBOR_FLOAT32, bits, 4);
+    } else {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        cbor_put_be(cbor, CBOR_FLOAT64, bits, 8);
+    }
+}
+
+void cbor_write_bool(CBORWriter *cbor, const char *key, int value) {
+    cbor_prefix(cbor, key);
+    cbor_put_byte(cbor, value ? CBOR_TRUE : CBOR_FALSE);
+}
+
+void cbor_write_null(CBORWriter *cbor, const char *key) {
+    cbor_prefix(cbor, key);
+    cbor_put_byte(cbor, CBOR_NULL);
+}
+
+void cbor_write_raw(CBORWriter *cbor, const char *key, const void *value, size_t length) {
+    cbor_prefix(cbor, key);
+    cbor_put(cbor, value, length);
+}
+
+int cbor_writer_finish(CBORWriter *cbor) {
+    if (cbor->depth != 0)
+        cbor->error = 1;
+    return cbor->error ? -1 : 0;
+}
@@ -0,0 +1,174 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include "../include/collect.h"
+#include "../include/emit.h"
+#include "../include/network.h"
+#include "../include/documents.h"
+#include "../include/log.h"
+
+static volatile sig_atomic_t collect_stopping = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    collect_stopping = 1;
+}
+
+typedef struct {
+    InterfaceCounters counters[MAX_INTERFACES];
+    int count;
+    struct timespec sampled_at;
+} CounterSample;
+
+static const InterfaceCounters *find_counters(const CounterSample *sample, const char *name) {
+    for (int i = 0; i < sample->count; i++) {
+        if (strcmp(sample->counters[i].name, name) == 0)
+            return &sample->counters[i];
+    }
+    return NULL;
+}
+
+// Rates are null in the first record, for new interfaces and after a
+// counter reset
+static void write_interfaces(Emitter *out, const CounterSample *current,
+                             const CounterSample *previous) {
+    double seconds = previous
+        ? (current->sampled_at.tv_sec - previous->sampled_at.tv_sec) +
+          (current->sampled_at.tv_nsec - previous->sampled_at.tv_nsec) / 1e9
+        : 0;
+
+    emit_begin_array(out, "interfaces");
+    for (int i = 0; i < current->count; i++) {
+        const InterfaceCounters *counters = &current->counters[i];
+        const InterfaceCounters *before = previous ? find_counters(previous, counters->name) : NULL;
+
+        emit_begin_object(out, NULL);
+        emit_string(out, "interface", counters->name);
+        emit_uint(out, "bytes_sent", counters->bytes_sent);
+        emit_uint(out, "bytes_received", counters->bytes_recv);
+        if (before && seconds > 0 && counters->bytes_sent >= before->bytes_sent &&
+            counters->bytes_recv >= before->bytes_recv) {
+            emit_number(out, "tx_bytes_per_sec", (counters->bytes_sent - before->bytes_sent) / seconds);
+            emit_number(out, "rx_bytes_per_sec", (counters->bytes_recv - before->bytes_recv) / seconds);
+        } else {
+            emit_null(out, "tx_bytes_per_sec");
+            emit_null(out, "rx_bytes_per_sec");
+        }
+        emit_end_object(out);
+    }
+    emit_end_array(out);
+}
+
+static void write_record(Emitter *out, const CollectOptions *options,
+                         const CounterSample *current, const CounterSample *previous) {
+    emit_begin_object(out, NULL);
+    emit_int(out, "time", time(NULL));
+    NetworkInfo network;
+    network_info_collect(&network);
+    network_info_write(out, "network", &network);
+    write_interfaces(out, current, previous);
+
+    double ping_ms;
+    if (get_current_ping(&ping_ms) == 0)
+        emit_number(out, "ping_ms", ping_ms);
+    else
+        emit_null(out, "ping_ms");
+
+    if (options->speed_test) {
+        SpeedTestResult result;
+        memset(&result, 0, sizeof(result));
+        perform_speed_test(&result);
+
+        emit_begin_object(out, "speed_test");
+        emit_number(out, "download_mbps", result.download_mbps);
+        emit_number(out, "upload_mbps", result.upload_mbps);
+        emit_number(out, "ping_ms", result.ping_ms);
+        emit_int(out, "test_time", result.test_time);
+        emit_end_object(out);
+    }
+    emit_end_object(out);
+}
+
+// Moves next forward by whole intervals until it lies in the future
+static void advance_schedule(struct timespec *next, unsigned interval_ms) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    do {
+        next->tv_nsec += (long)(interval_ms % 1000) * 1000000L;
+        next->tv_sec += interval_ms / 1000 + next->tv_nsec / 1000000000L;
+        next->tv_nsec %= 1000000000L;
+    } while (next->tv_sec < now.tv_sec ||
+             (next->tv_sec == now.tv_sec && next->tv_nsec <= now.tv_nsec));
+}
+
+int collect_run(const CollectOptions *options) {
+    FILE *stream = stdout;
+    if (options->output) {
+        stream = fopen(options->output, "a");
+        if (stream == NULL) {
+            fprintf(stderr, "Cannot open %s: %s\n", options->output, strerror(errno));
+            return -1;
+        }
+    }
+
+    // No SA_RESTART: a signal has to cut the sleep between records short
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    CounterSample samples[2];
+    int current = 0, have_previous = 0, result = 0;
+    long written = 0;
+    static char record[COLLECT_RECORD_MAX];
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!collect_stopping) {
+        CounterSample *sample = &samples[current];
+        clock_gettime(CLOCK_MONOTONIC, &sample->sampled_at);
+        sample->count = get_interface_counters(sample->counters, MAX_INTERFACES);
+        if (sample->count < 0)
+            sample->count = 0;
+
+        Emitter out;
+        emitter_init(&out, ENCODING_JSON, record, sizeof(record));
+        write_record(&out, options, sample, have_previous ? &samples[current ^ 1] : NULL);
+        current ^= 1;
+        have_previous = 1;
+
+        if (emitter_finish(&out) < 0) {
+            log_warn("collect_record_dropped", "reason=too_large");
+        } else {
+            // The writer always leaves room for its terminating NUL
+            size_t length;
+            emitter_data(&out, ENCODING_JSON, &length);
+            record[length++] = '\n';
+            if (fwrite(record, 1, length, stream) != length || fflush(stream) != 0) {
+                fprintf(stderr, "Write failed: %s\n", strerror(errno));
+                result = -1;
+                break;
+            }
+        }
+
+        if (options->count > 0 && ++written >= options->count)
+            break;
+
+        advance_schedule(&next, options->interval_ms);
+        while (!collect_stopping &&
+               clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+            ;
+    }
+
+    if (stream != stdout)
+        fclose(stream);
+    return result;
+}
@@ -0,0 +1,45 @@
+#include <string.h>
+#include "../include/documents.h"
+
+void network_info_collect(NetworkInfo *info) {
+    memset(info, 0, sizeof(*info));
+    strncpy(info->ipv4, "N/A", sizeof(info->ipv4) - 1);
+    strncpy(info->ipv6, "N/A", sizeof(info->ipv6) - 1);
+    strncpy(info->gateway, "N/A", sizeof(info->gateway) - 1);
+    strncpy(info->dns1, "N/A", sizeof(info->dns1) - 1);
+    strncpy(info->dns2, "N/A", sizeof(info->dns2) - 1);
+
+    get_network_info(info);
+}
+
+void network_info_write(Emitter *out, const char *key, const NetworkInfo *info) {
+    emit_begin_object(out, key);
+    emit_string(out, "ipv4", info->ipv4);
+    emit_string(out, "ipv6", info->ipv6);
+    emit_string(out, "gateway", info->gateway);
+    emit_string(out, "dns1", info->dns1);
+    emit_string(out, "dns2", info->dns2);
+    emit_end_object(out);
+}
+
+int interface_stats_collect(InterfaceStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    strncpy(stats->interface_name, "eth0", sizeof(stats->interface_name) - 1);
+    strncpy(stats->bytes_sent, "0", sizeof(stats->bytes_sent) - 1);
+    strncpy(stats->bytes_recv, "0", sizeof(stats->bytes_recv) - 1);
+
+    return get_interface_stats(stats);
+}
+
+void interface_stats_write(Emitter *out, const char *key, const InterfaceStats *stats,
+                           const double rates[2]) {
+    emit_begin_object(out, key);
+    emit_string(out, "interface", stats->interface_name);
+    emit_string(out, "bytes_sent", stats->bytes_sent);
+    emit_string(out, "bytes_received", stats->bytes_recv);
+    if (rates) {
+        emit_number(out, "tx_bytes_per_sec", rates[0]);
+        emit_number(out, "rx_bytes_per_sec", rates[1]);
+    }
+    emit_end_object(out);
+}
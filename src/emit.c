@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "../include/emit.h"
+
+#define HAS(out, encoding) ((out)->encodings & ENCODING_MASK(encoding))
+
+void emitter_init(Emitter *out, Encoding encoding, char *buffer, size_t capacity) {
+    out->encodings = 0;
+    emitter_add(out, encoding, buffer, capacity);
+}
+
+void emitter_add(Emitter *out, Encoding encoding, char *buffer, size_t capacity) {
+    out->encodings |= ENCODING_MASK(encoding);
+    if (encoding == ENCODING_JSON)
+        json_writer_init(&out->json, buffer, capacity);
+    else
+        cbor_writer_init(&out->cbor, buffer, capacity);
+}
+
+int emitter_finish(Emitter *out) {
+    int result = 0;
+    if (HAS(out, ENCODING_JSON) && json_writer_finish(&out->json) < 0)
+        result = -1;
+    if (HAS(out, ENCODING_CBOR) && cbor_writer_finish(&out->cbor) < 0)
+        result = -1;
+    return result;
+}
+
+const char* emitter_data(const Emitter *out, Encoding encoding, size_t *length) {
+    if (encoding == ENCODING_JSON) {
+        *length = out->json.size;
+        return out->json.data;
+    }
+    *length = out->cbor.size;
+    return (const char *)out->cbor.data;
+}
+
+void emit_begin_object(Emitter *out, const char *key) {
+    if (HAS(out, ENCODING_JSON))
+        json_begin_object(&out->json, key);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_begin_map(&out->cbor, key);
+}
+
+void emit_end_object(Emitter *out) {
+    if (HAS(out, ENCODING_JSON))
+        json_end_object(&out->json);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_end_map(&out->cbor);
+}
+
+void emit_begin_array(Emitter *out, const char *key) {
+    if (HAS(out, ENCODING_JSON))
+        json_begin_array(&out->json, key);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_begin_array(&out->cbor, key);
+}
+
+void emit_end_array(Emitter *out) {
+    if (HAS(out, ENCODING_JSON))
+        json_end_array(&out->json);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_end_array(&out->cbor);
+}
+
+void emit_string(Emitter *out, const char *key, const char *value) {
+    if (HAS(out, ENCODING_JSON))
+        json_write_string(&out->json, key, value);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_write_string(&out->cbor, key, value);
+}
+
+void emit_int(Emitter *out, const char *key, int64_t value) {
+    if (HAS(out, ENCODING_JSON))
+        json_write_int(&out->json, key, value);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_write_int(&out->cbor, key, value);
+}
+
+void emit_uint(Emitter *out, const char *key, uint64_t value) {
+    if (HAS(out, ENCODING_JSON))
+        json_write_uint(&out->json, key, value);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_write_uint(&out->cbor, key, value);
+}
+
+void emit_number(Emitter *out, const char *key, double value) {
+    if (HAS(out, ENCODING_JSON))
+        json_write_number(&out->json, key, value);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_write_double(&out->cbor, key, value);
+}
+
+void emit_bool(Emitter *out, const char *key, int value) {
+    if (HAS(out, ENCODING_JSON))
+        json_write_bool(&out->json, key, value);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_write_bool(&out->cbor, key, value);
+}
+
+void emit_null(Emitter *out, const char *key) {
+    if (HAS(out, ENCODING_JSON))
+        json_write_null(&out->json, key);
+    if (HAS(out, ENCODING_CBOR))
+        cbor_write_null(&out->cbor, key);
+}
+
+void emit_raw(Emitter *out, const char *key, const char *value, size_t length) {
+    if (out->encodings == ENCODING_MASK(ENCODING_JSON))
+        json_write_raw(&out->json, key, value, length);
+    else if (out->encodings == ENCODING_MASK(ENCODING_CBOR))
+        cbor_write_raw(&out->cbor, key, value, length);
+    else
+        out->json.error = out->cbor.error = 1;
+}
+
+static const struct {
+    const char *name;
+    const char *content_type;
+} encodings[ENCODING_COUNT] = {
+    [ENCODING_JSON] = { "json", "application/json" },
+    [ENCODING_CBOR] = { "cbor", "application/cbor" },
+};
+
+const char* encoding_name(Encoding encoding) {
+    return encodings[encoding].name;
+}
+
+const char* encoding_content_type(Encoding encoding) {
+    return encodings[encoding].content_type;
+}
+
+// Matches one media range such as "application/cbor;q=0.8" against an
+// encoding. Returns how specific the match is (2 for the exact type, 1 for
+// application/*, 0 for */*) and its q value, or -1 if it does not match.
+static int match_range(const char *range, size_t length, Encoding encoding, double *quality) {
+    while (length > 0 && (*range == ' ' || *range == '\t')) {
+        range++;
+        length--;
+    }
+
+    const char *end = range + length;
+    const char *params = memchr(range, ';', length);
+    size_t type_length = params ? (size_t)(params - range) : length;
+    while (type_length > 0 && (range[type_length - 1] == ' ' || range[type_length - 1] == '\t'))
+        type_length--;
+
+    const char *type = encodings[encoding].content_type;
+    int specificity;
+    if (type_length == strlen(type) && strncasecmp(range, type, type_length) == 0)
+        specificity = 2;
+    else if (type_length == 13 && strncasecmp(range, "application/*", 13) == 0)
+        specificity = 1;
+    else if (type_length == 3 && strncmp(range, "*/*", 3) == 0)
+        specificity = 0;
+    else
+        return -1;
+
+    *quality = 1.0;
+    while (params && params < end) {
+        const char *value = params + 1;
+        while (value < end && (*value == ' ' || *value == '\t'))
+            value++;
+        if (end - value > 2 && (value[0] == 'q' || value[0] == 'Q') && value[1] == '=')
+            *quality = strtod(value + 2, NULL);
+        params = memchr(value, ';', end - value);
+    }
+    return specificity;
+}
+
+// The most specific matching range decides an encoding's quality (RFC 9110
+// section 12.5.1). CBOR wins ties only when the client named it explicitly,
+// so browsers sending */* keep getting JSON.
+Encoding encoding_negotiate(const char *accept) {
+    int specificity[ENCODING_COUNT] = { -1, -1 };
+    double quality[ENCODING_COUNT] = { 0, 0 };
+
+    while (accept && *accept) {
+        const char *end = strchr(accept, ',');
+        size_t length = end ? (size_t)(end - accept) : strlen(accept);
+
+        for (int e = 0; e < ENCODING_COUNT; e++) {
+            double q = 0;
+            int match = match_range(accept, length, (Encoding)e, &q);
+            if (match > specificity[e]) {
+                specificity[e] = match;
+                quality[e] = q;
+            }
+        }
+        accept = end ? end + 1 : NULL;
+    }
+
+    double cbor = quality[ENCODING_CBOR], json = quality[ENCODING_JSON];
+    if (cbor > 0 && (cbor > json || (cbor == json && specificity[ENCODING_CBOR] == 2)))
+        return ENCODING_CBOR;
+    return ENCODING_JSON;
+}
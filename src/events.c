@@ -0,0 +1,275 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "../include/events.h"
+#include "../include/documents.h"
+#include "../include/metrics.h"
+#include "../include/log.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const char stream_headers[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "retry: 3000\n\n";
+
+// Events whose latest frame is replayed to new subscribers so a dashboard
+// has the full state right after connecting
+static const char *sticky_events[] = { "network", "interface" };
+#define STICKY_COUNT (sizeof(sticky_events) / sizeof(sticky_events[0]))
+
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t events_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_t events_thread;
+static int events_running = 0;
+
+static int subscribers[EVENTS_MAX_SUBSCRIBERS];
+static int subscriber_count = 0;
+
+static struct {
+    char frame[EVENTS_FRAME_MAX];
+    size_t length;
+} sticky[STICKY_COUNT];
+
+// Writes one frame to every subscriber. Sends never block: a client that
+// cannot take the whole frame right now is too slow and gets disconnected.
+// Caller holds events_lock.
+static void broadcast_locked(const char *frame, size_t length) {
+    for (int i = 0; i < subscriber_count; ) {
+        ssize_t sent = send(subscribers[i], frame, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent == (ssize_t)length) {
+            i++;
+            continue;
+        }
+        close(subscribers[i]);
+        subscribers[i] = subscribers[--subscriber_count];
+    }
+
+    // Nobody is listening any more: forget the replay state so the next
+    // subscriber never sees stale data
+    if (subscriber_count == 0) {
+        for (size_t i = 0; i < STICKY_COUNT; i++)
+            sticky[i].length = 0;
+    }
+}
+
+void events_publish(const char *event, JSONWriter *json) {
+    if (json_writer_finish(json) < 0) {
+        log_warn("event_dropped", "event=%s reason=serialization", event);
+        return;
+    }
+
+    char frame[EVENTS_FRAME_MAX];
+    int length = snprintf(frame, sizeof(frame), "event: %s\ndata: %.*s\n\n",
+                          event, (int)json->size, json->data);
+    if (length < 0 || (size_t)length >= sizeof(frame)) {
+        log_warn("event_dropped", "event=%s reason=too_large", event);
+        return;
+    }
+
+    pthread_mutex_lock(&events_lock);
+    if (subscriber_count > 0) {
+        for (size_t i = 0; i < STICKY_COUNT; i++) {
+            if (strcmp(event, sticky_events[i]) == 0) {
+                memcpy(sticky[i].frame, frame, length);
+                sticky[i].length = length;
+            }
+        }
+        broadcast_locked(frame, length);
+    }
+    pthread_mutex_unlock(&events_lock);
+}
+
+int events_subscribe(int client_fd) {
+    pthread_mutex_lock(&events_lock);
+    if (!events_running || subscriber_count >= EVENTS_MAX_SUBSCRIBERS) {
+        pthread_mutex_unlock(&events_lock);
+        return -1;
+    }
+
+    int ok = send(client_fd, stream_headers, sizeof(stream_headers) - 1,
+                  MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t)(sizeof(stream_headers) - 1);
+    for (size_t i = 0; ok && i < STICKY_COUNT; i++) {
+        if (sticky[i].length > 0)
+            ok = send(client_fd, sticky[i].frame, sticky[i].length,
+                      MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t)sticky[i].length;
+    }
+
+    if (!ok) {
+        close(client_fd);
+    } else {
+        subscribers[subscriber_count++] = client_fd;
+        // First subscriber: get the producer out of its idle wait
+        if (subscriber_count == 1)
+            pthread_cond_signal(&events_wakeup);
+    }
+    pthread_mutex_unlock(&events_lock);
+    return 0;
+}
+
+int events_subscriber_count() {
+    pthread_mutex_lock(&events_lock);
+    int count = subscriber_count;
+    pthread_mutex_unlock(&events_lock);
+    return count;
+}
+
+// The same documents as /api/interface-stats and /api/network-info, the
+// interface one with rates added
+static void publish_interface(const InterfaceStats *stats, double tx_rate, double rx_rate) {
+    char body[EVENTS_FRAME_MAX];
+    const double rates[2] = { tx_rate, rx_rate };
+    Emitter out;
+    emitter_init(&out, ENCODING_JSON, body, sizeof(body));
+    interface_stats_write(&out, NULL, stats, rates);
+    events_publish("interface", &out.json);
+}
+
+static void publish_network(const NetworkInfo *info) {
+    char body[EVENTS_FRAME_MAX];
+    Emitter out;
+    emitter_init(&out, ENCODING_JSON, body, sizeof(body));
+    network_info_write(&out, NULL, info);
+    events_publish("network", &out.json);
+}
+
+static void speed_test_progress(const char *phase, double percent, double mbps) {
+    char body[256];
+    JSONWriter json;
+    json_writer_init(&json, body, sizeof(body));
+    json_begin_object(&json, NULL);
+    json_write_string(&json, "phase", phase);
+    json_write_number(&json, "percent", percent);
+    json_write_number(&json, "mbps", mbps);
+    json_end_object(&json);
+    events_publish("speed_test", &json);
+}
+
+void events_publish_speed_test(const SpeedTestResult *result) {
+    char body[512];
+    JSONWriter json;
+    json_writer_init(&json, body, sizeof(body));
+    json_begin_object(&json, NULL);
+    json_write_string(&json, "phase", "complete");
+    json_write_number(&json, "percent", 100.0);
+    json_write_number(&json, "download_mbps", result->download_mbps);
+    json_write_number(&json, "upload_mbps", result->upload_mbps);
+    json_write_number(&json, "ping_ms", result->ping_ms);
+    json_write_int(&json, "test_time", result->test_time);
+    json_end_object(&json);
+    events_publish("speed_test", &json);
+}
+
+// Samples once per EVENTS_INTERVAL_MS while there are subscribers and sleeps
+// on the condition variable otherwise. Network configuration is only
+// published when it changes.
+static void *events_loop(void *arg) {
+    (void)arg;
+    InterfaceStats previous;
+    uint64_t previous_at = 0;
+    NetworkInfo last_network;
+    int have_previous = 0, have_network = 0;
+
+    pthread_mutex_lock(&events_lock);
+    while (events_running) {
+        if (subscriber_count == 0) {
+            have_previous = have_network = 0;
+            while (events_running && subscriber_count == 0)
+                pthread_cond_wait(&events_wakeup, &events_lock);
+            continue;
+        }
+        pthread_mutex_unlock(&events_lock);
+
+        NetworkInfo network;
+        network_info_collect(&network);
+        if (!have_network || memcmp(&network, &last_network, sizeof(network)) != 0) {
+            publish_network(&network);
+            last_network = network;
+            have_network = 1;
+        }
+
+        InterfaceStats stats;
+        uint64_t sampled_at = metrics_now_us();
+        if (interface_stats_collect(&stats) == 0) {
+            double tx_rate = 0, rx_rate = 0;
+            if (have_previous && strcmp(stats.interface_name, previous.interface_name) == 0 &&
+                sampled_at > previous_at) {
+                double seconds = (sampled_at - previous_at) / 1e6;
+                tx_rate = ((double)strtoull(stats.bytes_sent, NULL, 10) -
+                           (double)strtoull(previous.bytes_sent, NULL, 10)) / seconds;
+                rx_rate = ((double)strtoull(stats.bytes_recv, NULL, 10) -
+                           (double)strtoull(previous.bytes_recv, NULL, 10)) / seconds;
+                // Counters went backwards (interface reset)
+                if (tx_rate < 0)
+                    tx_rate = 0;
+                if (rx_rate < 0)
+                    rx_rate = 0;
+            }
+            publish_interface(&stats, tx_rate, rx_rate);
+            previous = stats;
+            previous_at = sampled_at;
+            have_previous = 1;
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += EVENTS_INTERVAL_MS % 1000 * 1000000L;
+        deadline.tv_sec += EVENTS_INTERVAL_MS / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        pthread_mutex_lock(&events_lock);
+        while (events_running && subscriber_count > 0 &&
+               pthread_cond_timedwait(&events_wakeup, &events_lock, &deadline) == 0)
+            ;
+    }
+    pthread_mutex_unlock(&events_lock);
+    return NULL;
+}
+
+int events_start() {
+    pthread_mutex_lock(&events_lock);
+    if (events_running) {
+        pthread_mutex_unlock(&events_lock);
+        return 0;
+    }
+    events_running = 1;
+    pthread_mutex_unlock(&events_lock);
+
+    if (pthread_create(&events_thread, NULL, events_loop, NULL) != 0) {
+        events_running = 0;
+        return -1;
+    }
+    set_speed_test_progress_callback(speed_test_progress);
+    return 0;
+}
+
+void events_stop() {
+    pthread_mutex_lock(&events_lock);
+    if (!events_running) {
+        pthread_mutex_unlock(&events_lock);
+        return;
+    }
+    events_running = 0;
+    pthread_cond_broadcast(&events_wakeup);
+    pthread_mutex_unlock(&events_lock);
+
+    set_speed_test_progress_callback(NULL);
+    pthread_join(events_thread, NULL);
+
+    pthread_mutex_lock(&events_lock);
+    while (subscriber_count > 0)
+        close(subscribers[--subscriber_count]);
+    pthread_mutex_unlock(&events_lock);
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../include/executor.h"
+
+static void *lane_worker(void *arg) {
+    Lane *lane = arg;
+
+    pthread_mutex_lock(&lane->lock);
+    for (;;) {
+        while (lane->running && lane->count == 0)
+            pthread_cond_wait(&lane->ready, &lane->lock);
+        if (!lane->running)
+            break;
+
+        void *item = lane->queue[lane->head];
+        lane->head = (lane->head + 1) % lane->capacity;
+        lane->count--;
+        lane->active++;
+        pthread_mutex_unlock(&lane->lock);
+
+        lane->run(item);
+
+        pthread_mutex_lock(&lane->lock);
+        lane->active--;
+    }
+    pthread_mutex_unlock(&lane->lock);
+    return NULL;
+}
+
+int lane_start(Lane *lane, const char *name, int workers, size_t capacity,
+               LaneTask run, LaneTask discard) {
+    memset(lane, 0, sizeof(*lane));
+    lane->name = name;
+    lane->run = run;
+    lane->discard = discard;
+    lane->capacity = capacity;
+    lane->queue = calloc(capacity, sizeof(void *));
+    lane->workers = calloc((size_t)workers, sizeof(pthread_t));
+    if (lane->queue == NULL || lane->workers == NULL) {
+        free(lane->queue);
+        free(lane->workers);
+        return -1;
+    }
+    pthread_mutex_init(&lane->lock, NULL);
+    pthread_cond_init(&lane->ready, NULL);
+    lane->running = 1;
+
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&lane->workers[i], NULL, lane_worker, lane) != 0)
+            break;
+        lane->worker_count++;
+    }
+    if (lane->worker_count == 0) {
+        lane_stop(lane);
+        return -1;
+    }
+    return 0;
+}
+
+int lane_submit(Lane *lane, void *item) {
+    pthread_mutex_lock(&lane->lock);
+    if (!lane->running || lane->count == lane->capacity) {
+        pthread_mutex_unlock(&lane->lock);
+        atomic_fetch_add_explicit(&lane->rejected, 1, memory_order_relaxed);
+        return -1;
+    }
+    lane->queue[(lane->head + lane->count) % lane->capacity] = item;
+    lane->count++;
+    pthread_cond_signal(&lane->ready);
+    pthread_mutex_unlock(&lane->lock);
+    return 0;
+}
+
+void lane_stop(Lane *lane) {
+    pthread_mutex_lock(&lane->lock);
+    lane->running = 0;
+    pthread_cond_broadcast(&lane->ready);
+    pthread_mutex_unlock(&lane->lock);
+
+    for (int i = 0; i < lane->worker_count; i++)
+        pthread_join(lane->workers[i], NULL);
+
+    for (; lane->count > 0; lane->count--) {
+        if (lane->discard)
+            lane->discard(lane->queue[lane->head]);
+        lane->head = (lane->head + 1) % lane->capacity;
+    }
+    pthread_cond_destroy(&lane->ready);
+    pthread_mutex_destroy(&lane->lock);
+    free(lane->queue);
+    free(lane->workers);
+    lane->queue = NULL;
+    lane->workers = NULL;
+    lane->worker_count = 0;
+}
+
+void lane_get_stats(Lane *lane, LaneStats *stats) {
+    pthread_mutex_lock(&lane->lock);
+    stats->queued = lane->count;
+    stats->active = lane->active;
+    stats->workers = lane->worker_count;
+    pthread_mutex_unlock(&lane->lock);
+    stats->rejected = atomic_load_explicit(&lane->rejected, memory_order_relaxed);
+}
+
+void rate_limiter_init(RateLimiter *limiter, double per_minute, double burst) {
+    memset(limiter, 0, sizeof(*limiter));
+    pthread_mutex_init(&limiter->lock, NULL);
+    limiter->per_ms = per_minute / 60000.0;
+    limiter->burst = burst < 1 ? 1 : burst;
+}
+
+uint64_t rate_limiter_take(RateLimiter *limiter, uint32_t client, uint64_t now_ms) {
+    if (limiter->per_ms <= 0)
+        return 0;
+
+    pthread_mutex_lock(&limiter->lock);
+
+    // A linear scan is fine at this size: only rate-limited routes get here
+    TokenBucket *bucket = NULL;
+    TokenBucket *oldest = &limiter->buckets[0];
+    for (int i = 0; i < RATE_LIMIT_CLIENTS; i++) {
+        TokenBucket *candidate = &limiter->buckets[i];
+        if (candidate->updated_ms != 0 && candidate->client == client) {
+            bucket = candidate;
+            break;
+        }
+        if (candidate->updated_ms < oldest->updated_ms)
+            oldest = candidate;
+    }
+    if (bucket == NULL) {
+        bucket = oldest;
+        bucket->client = client;
+        bucket->tokens = limiter->burst;
+    } else if (now_ms > bucket->updated_ms) {
+        bucket->tokens += (now_ms - bucket->updated_ms) * limiter->per_ms;
+        if (bucket->tokens > limiter->burst)
+            bucket->tokens = limiter->burst;
+    }
+    // Never 0, which marks a free slot
+    bucket->updated_ms = now_ms ? now_ms : 1;
+
+    uint64_t wait_ms = 0;
+    if (bucket->tokens >= 1)
+        bucket->tokens -= 1;
+    else
+        wait_ms = (uint64_t)ceil((1 - bucket->tokens) / limiter->per_ms);
+    pthread_mutex_unlock(&limiter->lock);
+    return wait_ms;
+}
@@ -0,0 +1,463 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <curl/curl.h>
+#include "../include/fleet.h"
+#include "../include/emit.h"
+#include "../include/log.h"
+
+typedef enum {
+    PEER_PENDING,  // No scrape has finished yet
+    PEER_UP,
+    PEER_DOWN      // The last scrape failed; the previous snapshot is kept
+} PeerState;
+
+static const char *peer_state_names[] = { "pending", "up", "down" };
+
+typedef struct {
+    char url[FLEET_URL_MAX];
+    char scrape_url[FLEET_URL_MAX + 16];
+
+    // Scraper thread only
+    CURL *easy;
+    struct curl_slist *request_headers;
+    int in_flight;
+    uint64_t due_us;
+    uint64_t started_us;
+    char *buffer;  // Body being received
+    size_t length;
+    size_t capacity;
+    char etag[128];           // Validator of the current snapshot
+    char received_etag[128];  // ETag header of the response in flight
+    char error[CURL_ERROR_SIZE];
+
+    // Published under fleet_lock
+    PeerState state;
+    unsigned failures;
+    time_t last_attempt;
+    time_t last_success;
+    double latency_ms;
+    char last_error[CURL_ERROR_SIZE];
+    char *snapshot;
+    size_t snapshot_length;
+    size_t snapshot_capacity;
+} FleetPeer;
+
+static FleetPeer *peers = NULL;
+static int peer_count = 0;
+static unsigned scrape_interval_ms = FLEET_DEFAULT_INTERVAL_MS;
+static unsigned scrape_timeout_ms = FLEET_DEFAULT_TIMEOUT_MS;
+
+static pthread_mutex_t fleet_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t scrape_thread;
+static atomic_int scrape_running = 0;
+static CURLM *multi = NULL;
+
+static uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+int fleet_add_peer(const char *url) {
+    if (peer_count >= FLEET_MAX_PEERS)
+        return -1;
+
+    const char *scheme = strstr(url, "://") ? "" : "http://";
+    size_t length = strlen(url);
+    while (length > 0 && url[length - 1] == '/')
+        length--;
+    if (length == 0 || strlen(scheme) + length >= FLEET_URL_MAX)
+        return -1;
+
+    if (peer_count % 16 == 0) {
+        FleetPeer *grown = realloc(peers, (peer_count + 16) * sizeof(FleetPeer));
+        if (!grown)
+            return -1;
+        peers = grown;
+    }
+
+    FleetPeer *peer = &peers[peer_count];
+    memset(peer, 0, sizeof(*peer));
+    snprintf(peer->url, sizeof(peer->url), "%s%.*s", scheme, (int)length, url);
+    snprintf(peer->scrape_url, sizeof(peer->scrape_url), "%s/api/all", peer->url);
+    peer_count++;
+    return 0;
+}
+
+int fleet_load_peers(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+
+    char line[FLEET_URL_MAX + 2];
+    int result = 0;
+    while (result == 0 && fgets(line, sizeof(line), fp)) {
+        char *start = line;
+        while (*start == ' ' || *start == '\t')
+            start++;
+        start[strcspn(start, " \t\r\n")] = '\0';
+        if (*start == '\0' || *start == '#')
+            continue;
+        result = fleet_add_peer(start);
+    }
+    fclose(fp);
+    return result;
+}
+
+static size_t receive_body(char *data, size_t size, size_t nmemb, void *arg) {
+    FleetPeer *peer = (FleetPeer *)arg;
+    size_t bytes = size * nmemb;
+
+    if (peer->length + bytes > FLEET_BODY_MAX)
+        return 0;  // Aborts the transfer with CURLE_WRITE_ERROR
+    if (peer->length + bytes > peer->capacity) {
+        size_t capacity = peer->capacity ? peer->capacity : 4096;
+        while (capacity < peer->length + bytes)
+            capacity *= 2;
+        char *grown = realloc(peer->buffer, capacity);
+        if (!grown)
+            return 0;
+        peer->buffer = grown;
+        peer->capacity = capacity;
+    }
+    memcpy(peer->buffer + peer->length, data, bytes);
+    peer->length += bytes;
+    return bytes;
+}
+
+static size_t receive_header(char *data, size_t size, size_t nmemb, void *arg) {
+    FleetPeer *peer = (FleetPeer *)arg;
+    size_t bytes = size * nmemb;
+
+    if (bytes > 5 && strncasecmp(data, "ETag:", 5) == 0) {
+        const char *value = data + 5;
+        size_t length = bytes - 5;
+        while (length > 0 && (*value == ' ' || *value == '\t')) {
+            value++;
+            length--;
+        }
+        while (length > 0 && (value[length - 1] == '\r' || value[length - 1] == '\n'))
+            length--;
+        if (length < sizeof(peer->received_etag)) {
+            memcpy(peer->received_etag, value, length);
+            peer->received_etag[length] = '\0';
+        }
+    }
+    return bytes;
+}
+
+static void start_scrape(FleetPeer *peer) {
+    if (!peer->easy) {
+        peer->easy = curl_easy_init();
+        if (!peer->easy)
+            return;
+        curl_easy_setopt(peer->easy, CURLOPT_URL, peer->scrape_url);
+        curl_easy_setopt(peer->easy, CURLOPT_PRIVATE, peer);
+        curl_easy_setopt(peer->easy, CURLOPT_WRITEFUNCTION, receive_body);
+        curl_easy_setopt(peer->easy, CURLOPT_WRITEDATA, peer);
+        curl_easy_setopt(peer->easy, CURLOPT_HEADERFUNCTION, receive_header);
+        curl_easy_setopt(peer->easy, CURLOPT_HEADERDATA, peer);
+        curl_easy_setopt(peer->easy, CURLOPT_ERRORBUFFER, peer->error);
+        curl_easy_setopt(peer->easy, CURLOPT_TIMEOUT_MS, (long)scrape_timeout_ms);
+        curl_easy_setopt(peer->easy, CURLOPT_CONNECTTIMEOUT_MS, (long)scrape_timeout_ms);
+        curl_easy_setopt(peer->easy, CURLOPT_NOSIGNAL, 1L);
+    }
+
+    // Conditional request: an unchanged peer answers 304 without a body
+    curl_slist_free_all(peer->request_headers);
+    peer->request_headers = NULL;
+    if (peer->etag[0]) {
+        char header[sizeof(peer->etag) + 16];
+        snprintf(header, sizeof(header), "If-None-Match: %s", peer->etag);
+        peer->request_headers = curl_slist_append(NULL, header);
+    }
+    curl_easy_setopt(peer->easy, CURLOPT_HTTPHEADER, peer->request_headers);
+
+    peer->length = 0;
+    peer->received_etag[0] = '\0';
+    peer->error[0] = '\0';
+    peer->started_us = monotonic_us();
+    if (curl_multi_add_handle(multi, peer->easy) == CURLM_OK)
+        peer->in_flight = 1;
+}
+
+// Next attempt after interval_ms, doubled per consecutive failure up to
+// FLEET_MAX_BACKOFF_MS, with up to 10% jitter so peers drift apart
+static void schedule_next(FleetPeer *peer, unsigned failures) {
+    uint64_t delay_ms = scrape_interval_ms;
+    for (unsigned i = 0; i < failures && delay_ms < FLEET_MAX_BACKOFF_MS; i++)
+        delay_ms *= 2;
+    if (delay_ms > FLEET_MAX_BACKOFF_MS)
+        delay_ms = FLEET_MAX_BACKOFF_MS;
+    delay_ms += (uint64_t)rand() % (delay_ms / 10 + 1);
+    peer->due_us = monotonic_us() + delay_ms * 1000;
+}
+
+static int is_json_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+int fleet_snapshot_valid(const char *body, size_t length) {
+    char open[FLEET_MAX_DEPTH];
+    int depth = 0;
+    size_t i = 0;
+    while (i < length && is_json_space(body[i]))
+        i++;
+    if (i == length || body[i] != '{')
+        return 0;
+
+    for (; i < length; i++) {
+        char c = body[i];
+        if (c == '"') {
+            // Skip the string, escapes included; raw control characters are invalid
+            for (i++; i < length && body[i] != '"'; i++) {
+                if ((unsigned char)body[i] < 0x20)
+                    return 0;
+                if (body[i] == '\\')
+                    i++;
+            }
+            if (i >= length)
+                return 0;
+        } else if (c == '{' || c == '[') {
+            if (depth == FLEET_MAX_DEPTH)
+                return 0;
+            open[depth++] = c;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0 || open[--depth] != (c == '}' ? '{' : '['))
+                return 0;
+            if (depth == 0)
+                break;
+        }
+    }
+    if (depth != 0 || i == length)
+        return 0;
+
+    // Nothing but whitespace after the object closes
+    for (i++; i < length; i++) {
+        if (!is_json_space(body[i]))
+            return 0;
+    }
+    return 1;
+}
+
+static void finish_scrape(FleetPeer *peer, CURLcode code) {
+    long status = 0;
+    curl_easy_getinfo(peer->easy, CURLINFO_RESPONSE_CODE, &status);
+    curl_multi_remove_handle(multi, peer->easy);
+    peer->in_flight = 0;
+
+    // A usable snapshot is a 200 with exactly one JSON object as its body
+    int valid = status == 200 && fleet_snapshot_valid(peer->buffer, peer->length);
+    int ok = code == CURLE_OK && (status == 304 || valid);
+    char error[CURL_ERROR_SIZE];
+    if (code != CURLE_OK)
+        snprintf(error, sizeof(error), "%s", peer->error[0] ? peer->error : curl_easy_strerror(code));
+    else if (status == 200 && !ok)
+        snprintf(error, sizeof(error), "Body is not a single JSON object");
+    else if (!ok)
+        snprintf(error, sizeof(error), "HTTP %ld", status);
+
+    pthread_mutex_lock(&fleet_lock);
+    peer->last_attempt = time(NULL);
+    if (ok) {
+        peer->state = PEER_UP;
+        peer->failures = 0;
+        peer->last_success = peer->last_attempt;
+        peer->latency_ms = (monotonic_us() - peer->started_us) / 1000.0;
+        peer->last_error[0] = '\0';
+        if (status == 200) {
+            // Swap buffers: the received body becomes the snapshot
+            char *previous = peer->snapshot;
+            size_t previous_capacity = peer->snapshot_capacity;
+            peer->snapshot = peer->buffer;
+            peer->snapshot_capacity = peer->capacity;
+            peer->snapshot_length = peer->length;
+            peer->buffer = previous;
+            peer->capacity = previous_capacity;
+        }
+    } else {
+        peer->state = PEER_DOWN;
+        peer->failures++;
+        snprintf(peer->last_error, sizeof(peer->last_error), "%s", error);
+    }
+    unsigned failures = peer->failures;
+    pthread_mutex_unlock(&fleet_lock);
+
+    if (ok && status == 200)
+        snprintf(peer->etag, sizeof(peer->etag), "%s", peer->received_etag);
+    if (!ok && failures == 1)
+        log_warn("fleet_peer_down", "peer=%s error=\"%s\"", peer->url, error);
+    schedule_next(peer, failures);
+}
+
+static void *scrape_loop(void *arg) {
+    (void)arg;
+
+    while (atomic_load(&scrape_running)) {
+        uint64_t now = monotonic_us();
+        for (int i = 0; i < peer_count; i++) {
+            if (!peers[i].in_flight && peers[i].due_us <= now)
+                start_scrape(&peers[i]);
+        }
+
+        int active;
+        curl_multi_perform(multi, &active);
+
+        CURLMsg *message;
+        int queued;
+        while ((message = curl_multi_info_read(multi, &queued))) {
+            if (message->msg != CURLMSG_DONE)
+                continue;
+            FleetPeer *peer;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char **)&peer);
+            finish_scrape(peer, message->data.result);
+        }
+
+        // Sleep until a transfer needs attention or the next peer is due
+        now = monotonic_us();
+        uint64_t wake = now + 1000000;
+        for (int i = 0; i < peer_count; i++) {
+            if (!peers[i].in_flight && peers[i].due_us < wake)
+                wake = peers[i].due_us;
+        }
+        long wait_ms = wake > now ? (long)((wake - now + 999) / 1000) : 0;
+        long curl_wait_ms;
+        if (curl_multi_timeout(multi, &curl_wait_ms) == CURLM_OK && curl_wait_ms >= 0 &&
+            curl_wait_ms < wait_ms)
+            wait_ms = curl_wait_ms;
+        curl_multi_poll(multi, NULL, 0, (int)wait_ms, NULL);
+    }
+    return NULL;
+}
+
+int fleet_start(unsigned interval_ms, unsigned timeout_ms) {
+    if (peer_count == 0)
+        return -1;
+
+    scrape_interval_ms = interval_ms;
+    scrape_timeout_ms = timeout_ms;
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    multi = curl_multi_init();
+    if (!multi)
+        return -1;
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)FLEET_MAX_PARALLEL);
+
+    // Spread the first round over one interval instead of a thundering herd
+    uint64_t now = monotonic_us();
+    for (int i = 0; i < peer_count; i++)
+        peers[i].due_us = now + (uint64_t)interval_ms * 1000 * i / peer_count;
+
+    atomic_store(&scrape_running, 1);
+    if (pthread_create(&scrape_thread, NULL, scrape_loop, NULL) != 0) {
+        atomic_store(&scrape_running, 0);
+        curl_multi_cleanup(multi);
+        multi = NULL;
+        return -1;
+    }
+    log_info("fleet_started", "peers=%d interval_ms=%u timeout_ms=%u",
+             peer_count, interval_ms, timeout_ms);
+    return 0;
+}
+
+void fleet_stop() {
+    if (!atomic_exchange(&scrape_running, 0))
+        return;
+    curl_multi_wakeup(multi);
+    pthread_join(scrape_thread, NULL);
+
+    for (int i = 0; i < peer_count; i++) {
+        FleetPeer *peer = &peers[i];
+        if (peer->easy) {
+            curl_multi_remove_handle(multi, peer->easy);
+            curl_easy_cleanup(peer->easy);
+        }
+        curl_slist_free_all(peer->request_headers);
+        free(peer->buffer);
+        free(peer->snapshot);
+    }
+    curl_multi_cleanup(multi);
+    multi = NULL;
+    free(peers);
+    peers = NULL;
+    peer_count = 0;
+}
+
+int fleet_enabled() {
+    return atomic_load(&scrape_running);
+}
+
+static void emit_time(Emitter *out, const char *key, time_t value) {
+    if (value)
+        emit_int(out, key, value);
+    else
+        emit_null(out, key);
+}
+
+char* fleet_render(Arena *arena, size_t *length) {
+    if (!fleet_enabled())
+        return NULL;
+
+    pthread_mutex_lock(&fleet_lock);
+    size_t capacity = 256;
+    for (int i = 0; i < peer_count; i++)
+        capacity += 512 + JSON_ESCAPE_MAX_EXPANSION *
+                    (sizeof(peers[i].url) + sizeof(peers[i].last_error)) +
+                    peers[i].snapshot_length;
+
+    char *body = arena_alloc(arena, capacity);
+    if (!body) {
+        pthread_mutex_unlock(&fleet_lock);
+        return NULL;
+    }
+
+    int up = 0;
+    for (int i = 0; i < peer_count; i++)
+        up += peers[i].state == PEER_UP;
+
+    Emitter out;
+    emitter_init(&out, ENCODING_JSON, body, capacity);
+    emit_begin_object(&out, NULL);
+    emit_int(&out, "time", time(NULL));
+    emit_uint(&out, "interval_ms", scrape_interval_ms);
+    emit_int(&out, "peers", peer_count);
+    emit_int(&out, "up", up);
+    emit_begin_array(&out, "hosts");
+    for (int i = 0; i < peer_count; i++) {
+        const FleetPeer *peer = &peers[i];
+        emit_begin_object(&out, NULL);
+        emit_string(&out, "peer", peer->url);
+        emit_string(&out, "state", peer_state_names[peer->state]);
+        emit_uint(&out, "failures", peer->failures);
+        emit_time(&out, "last_attempt", peer->last_attempt);
+        emit_time(&out, "last_success", peer->last_success);
+        if (peer->last_success)
+            emit_number(&out, "latency_ms", peer->latency_ms);
+        else
+            emit_null(&out, "latency_ms");
+        if (peer->last_error[0])
+            emit_string(&out, "error", peer->last_error);
+        else
+            emit_null(&out, "error");
+        if (peer->snapshot)
+            emit_raw(&out, "snapshot", peer->snapshot, peer->snapshot_length);
+        else
+            emit_null(&out, "snapshot");
+        emit_end_object(&out);
+    }
+    emit_end_array(&out);
+    emit_end_object(&out);
+    pthread_mutex_unlock(&fleet_lock);
+
+    if (emitter_finish(&out) < 0)
+        return NULL;
+    emitter_data(&out, ENCODING_JSON, length);
+    return body;
+}
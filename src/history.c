@@ -0,0 +1,392 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/history.h"
+#include "../include/log.h"
+
+#define HISTORY_MAGIC "NDHIST01"
+
+typedef struct {
+    uint32_t resolution;  // Seconds per bucket; 0 keeps every sample
+    uint32_t capacity;
+} TierSpec;
+
+typedef struct {
+    const char *name;
+    int value_count;
+    const char *values[HISTORY_MAX_VALUES];
+    int tier_count;
+    TierSpec tiers[HISTORY_MAX_TIERS];
+} SeriesSpec;
+
+static const SeriesSpec series_specs[HISTORY_SERIES_COUNT] = {
+    [HISTORY_SPEED_TEST] = {
+        "speed_test", 3, { "download_mbps", "upload_mbps", "ping_ms" },
+        3, { { 0, 4096 }, { 3600, 2160 }, { 86400, 1825 } }
+    },
+    [HISTORY_INTERFACE] = {
+        "interface", 2, { "tx_bytes_per_sec", "rx_bytes_per_sec" },
+        3, { { 60, 2880 }, { 3600, 2160 }, { 86400, 1825 } }
+    },
+};
+
+typedef struct {
+    uint64_t head;    // Buckets ever opened; the newest is (head - 1) % capacity
+    uint64_t offset;  // File offset of the bucket ring
+    uint32_t resolution;
+    uint32_t capacity;
+} TierHeader;
+
+typedef struct {
+    char magic[8];
+    uint32_t layout;
+    uint32_t reserved;
+    uint64_t file_size;
+    TierHeader tiers[HISTORY_SERIES_COUNT][HISTORY_MAX_TIERS];
+} HistoryHeader;
+
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+static HistoryHeader *header = NULL;
+static size_t mapped_size = 0;
+
+static pthread_cond_t sampler_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_t sampler_thread;
+static int sampler_running = 0;
+
+// FNV-1a over everything that determines the file layout
+static uint32_t layout_hash() {
+    uint32_t hash = 2166136261u;
+    uint32_t words[] = { sizeof(HistoryHeader), sizeof(HistoryBucket), HISTORY_MAX_VALUES };
+
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+        hash = (hash ^ words[i]) * 16777619u;
+    for (int s = 0; s < HISTORY_SERIES_COUNT; s++) {
+        for (int t = 0; t < series_specs[s].tier_count; t++) {
+            hash = (hash ^ series_specs[s].tiers[t].resolution) * 16777619u;
+            hash = (hash ^ series_specs[s].tiers[t].capacity) * 16777619u;
+        }
+        hash = (hash ^ (uint32_t)series_specs[s].value_count) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t layout_size(HistoryHeader *layout) {
+    size_t offset = (sizeof(HistoryHeader) + 63) & ~(size_t)63;
+
+    memset(layout, 0, sizeof(*layout));
+    memcpy(layout->magic, HISTORY_MAGIC, sizeof(layout->magic));
+    layout->layout = layout_hash();
+    for (int s = 0; s < HISTORY_SERIES_COUNT; s++) {
+        for (int t = 0; t < series_specs[s].tier_count; t++) {
+            TierHeader *tier = &layout->tiers[s][t];
+            tier->resolution = series_specs[s].tiers[t].resolution;
+            tier->capacity = series_specs[s].tiers[t].capacity;
+            tier->offset = offset;
+            offset += (size_t)tier->capacity * sizeof(HistoryBucket);
+        }
+    }
+    layout->file_size = offset;
+    return offset;
+}
+
+static HistoryBucket *tier_buckets(const TierHeader *tier) {
+    return (HistoryBucket *)((char *)header + tier->offset);
+}
+
+int history_open(const char *path) {
+    HistoryHeader layout;
+    size_t size = layout_size(&layout);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        log_warn("history_unavailable", "open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    int reuse = fstat(fd, &st) == 0 && (size_t)st.st_size == size;
+    if (!reuse && (ftruncate(fd, 0) < 0 || ftruncate(fd, size) < 0)) {
+        log_warn("history_unavailable", "ftruncate %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_warn("history_unavailable", "mmap %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    HistoryHeader *mapped = (HistoryHeader *)map;
+    if (reuse && (memcmp(mapped->magic, HISTORY_MAGIC, sizeof(mapped->magic)) != 0 ||
+                  mapped->layout != layout.layout || mapped->file_size != size)) {
+        log_warn("history_reset", "path=%s reason=layout_mismatch", path);
+        memset(map, 0, size);
+        reuse = 0;
+    }
+    if (!reuse)
+        memcpy(mapped, &layout, sizeof(layout));
+
+    pthread_mutex_lock(&history_lock);
+    header = mapped;
+    mapped_size = size;
+    pthread_mutex_unlock(&history_lock);
+
+    log_info("history_opened", "path=%s bytes=%zu reused=%d", path, size, reuse);
+    return 0;
+}
+
+static void bucket_merge(HistoryBucket *bucket, int value_count, const double values[]) {
+    for (int v = 0; v < value_count; v++) {
+        if (bucket->count == 0 || values[v] < bucket->min[v])
+            bucket->min[v] = values[v];
+        if (bucket->count == 0 || values[v] > bucket->max[v])
+            bucket->max[v] = values[v];
+        bucket->sum[v] += values[v];
+    }
+    bucket->count++;
+}
+
+// Samples older than the newest bucket are folded into it rather than
+// reordering the ring
+static void tier_append(TierHeader *tier, int value_count, int64_t when, const double values[]) {
+    HistoryBucket *buckets = tier_buckets(tier);
+    int64_t start = tier->resolution ? when - when % tier->resolution : when;
+    HistoryBucket *newest = tier->head ? &buckets[(tier->head - 1) % tier->capacity] : NULL;
+
+    if (newest && tier->resolution && start <= newest->start) {
+        bucket_merge(newest, value_count, values);
+        return;
+    }
+
+    // Fill the next slot completely before publishing it through head
+    HistoryBucket *bucket = &buckets[tier->head % tier->capacity];
+    memset(bucket, 0, sizeof(*bucket));
+    bucket->start = start;
+    bucket_merge(bucket, value_count, values);
+    tier->head++;
+}
+
+void history_append(HistorySeries series, time_t when, const double values[]) {
+    const SeriesSpec *spec = &series_specs[series];
+
+    pthread_mutex_lock(&history_lock);
+    if (header) {
+        for (int t = 0; t < spec->tier_count; t++)
+            tier_append(&header->tiers[series][t], spec->value_count, when, values);
+    }
+    pthread_mutex_unlock(&history_lock);
+}
+
+void history_record_speed_test(const SpeedTestResult *result) {
+    double values[HISTORY_MAX_VALUES] = {
+        result->download_mbps, result->upload_mbps, result->ping_ms
+    };
+    history_append(HISTORY_SPEED_TEST, result->test_time, values);
+}
+
+int history_parse_series(const char *name, HistorySeries *series) {
+    for (int s = 0; s < HISTORY_SERIES_COUNT; s++) {
+        if (strcmp(name, series_specs[s].name) == 0) {
+            *series = (HistorySeries)s;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// First logical index in [oldest, head) whose bucket starts at or after key
+static uint64_t tier_lower_bound(const TierHeader *tier, uint64_t oldest, int64_t key) {
+    const HistoryBucket *buckets = tier_buckets(tier);
+    uint64_t lo = oldest, hi = tier->head;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (buckets[mid % tier->capacity].start < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void write_values(Emitter *out, const char *key, const double *values,
+                         int value_count, double divisor) {
+    emit_begin_array(out, key);
+    for (int v = 0; v < value_count; v++)
+        emit_number(out, NULL, values[v] / divisor);
+    emit_end_array(out);
+}
+
+int history_query(HistorySeries series, time_t from, time_t to, int max_points, Emitter *out) {
+    const SeriesSpec *spec = &series_specs[series];
+
+    if (max_points < 1)
+        max_points = 1;
+
+    pthread_mutex_lock(&history_lock);
+    if (!header) {
+        pthread_mutex_unlock(&history_lock);
+        return -1;
+    }
+
+    // Finest tier that still holds data back to `from` and needs no more
+    // than max_points buckets; otherwise the coarsest one
+    const TierHeader *tier = NULL;
+    uint64_t first = 0, last = 0;
+    for (int t = 0; t < spec->tier_count; t++) {
+        const TierHeader *candidate = &header->tiers[series][t];
+        uint64_t oldest = candidate->head > candidate->capacity
+            ? candidate->head - candidate->capacity : 0;
+        int covers = oldest == 0 ||
+                     tier_buckets(candidate)[oldest % candidate->capacity].start <= from;
+        int64_t key = candidate->resolution ? from - candidate->resolution + 1 : from;
+
+        tier = candidate;
+        first = tier_lower_bound(candidate, oldest, key);
+        last = tier_lower_bound(candidate, oldest, (int64_t)to + 1);
+        if (covers && last - first <= (uint64_t)max_points)
+            break;
+    }
+
+    // Still too many buckets: merge runs of adjacent ones
+    uint64_t group = (last - first + max_points - 1) / max_points;
+    if (group == 0)
+        group = 1;
+
+    emit_begin_object(out, NULL);
+    emit_string(out, "series", spec->name);
+    emit_int(out, "from", from);
+    emit_int(out, "to", to);
+    emit_uint(out, "resolution", (uint64_t)tier->resolution * group);
+    emit_begin_array(out, "values");
+    for (int v = 0; v < spec->value_count; v++)
+        emit_string(out, NULL, spec->values[v]);
+    emit_end_array(out);
+
+    const HistoryBucket *buckets = tier_buckets(tier);
+    emit_begin_array(out, "buckets");
+    for (uint64_t i = first; i < last; i += group) {
+        HistoryBucket merged = buckets[i % tier->capacity];
+        for (uint64_t j = i + 1; j < i + group && j < last; j++) {
+            const HistoryBucket *next = &buckets[j % tier->capacity];
+            for (int v = 0; v < spec->value_count; v++) {
+                if (next->min[v] < merged.min[v])
+                    merged.min[v] = next->min[v];
+                if (next->max[v] > merged.max[v])
+                    merged.max[v] = next->max[v];
+                merged.sum[v] += next->sum[v];
+            }
+            merged.count += next->count;
+        }
+
+        emit_begin_object(out, NULL);
+        emit_int(out, "t", merged.start);
+        emit_uint(out, "n", merged.count);
+        write_values(out, "min", merged.min, spec->value_count, 1.0);
+        write_values(out, "max", merged.max, spec->value_count, 1.0);
+        write_values(out, "avg", merged.sum, spec->value_count, merged.count ? merged.count : 1);
+        emit_end_object(out);
+    }
+    emit_end_array(out);
+    emit_end_object(out);
+
+    pthread_mutex_unlock(&history_lock);
+    return 0;
+}
+
+static void *sampler_loop(void *arg) {
+    (void)arg;
+    InterfaceStats previous;
+    struct timespec previous_at = { 0, 0 };
+    int have_previous = 0;
+
+    memset(&previous, 0, sizeof(previous));
+
+    pthread_mutex_lock(&history_lock);
+    while (sampler_running) {
+        pthread_mutex_unlock(&history_lock);
+
+        InterfaceStats stats;
+        struct timespec now;
+        memset(&stats, 0, sizeof(stats));
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (get_interface_stats(&stats) == 0) {
+            double seconds = (now.tv_sec - previous_at.tv_sec) +
+                             (now.tv_nsec - previous_at.tv_nsec) / 1e9;
+            if (have_previous && seconds > 0 &&
+                strcmp(stats.interface_name, previous.interface_name) == 0) {
+                double values[HISTORY_MAX_VALUES] = {
+                    ((double)strtoull(stats.bytes_sent, NULL, 10) -
+                     (double)strtoull(previous.bytes_sent, NULL, 10)) / seconds,
+                    ((double)strtoull(stats.bytes_recv, NULL, 10) -
+                     (double)strtoull(previous.bytes_recv, NULL, 10)) / seconds,
+                    0
+                };
+                // Counters went backwards (interface reset): skip this interval
+                if (values[0] >= 0 && values[1] >= 0)
+                    history_append(HISTORY_INTERFACE, time(NULL), values);
+            }
+            previous = stats;
+            previous_at = now;
+            have_previous = 1;
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += HISTORY_SAMPLE_INTERVAL_S;
+
+        pthread_mutex_lock(&history_lock);
+        while (sampler_running &&
+               pthread_cond_timedwait(&sampler_wakeup, &history_lock, &deadline) == 0)
+            ;
+    }
+    pthread_mutex_unlock(&history_lock);
+    return NULL;
+}
+
+int history_start_sampler() {
+    pthread_mutex_lock(&history_lock);
+    if (!header || sampler_running) {
+        pthread_mutex_unlock(&history_lock);
+        return header ? 0 : -1;
+    }
+    sampler_running = 1;
+    pthread_mutex_unlock(&history_lock);
+
+    if (pthread_create(&sampler_thread, NULL, sampler_loop, NULL) != 0) {
+        sampler_running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void history_close() {
+    pthread_mutex_lock(&history_lock);
+    int was_running = sampler_running;
+    sampler_running = 0;
+    pthread_cond_broadcast(&sampler_wakeup);
+    pthread_mutex_unlock(&history_lock);
+
+    if (was_running)
+        pthread_join(sampler_thread, NULL);
+
+    pthread_mutex_lock(&history_lock);
+    if (header) {
+        msync(header, mapped_size, MS_SYNC);
+        munmap(header, mapped_size);
+        header = NULL;
+        mapped_size = 0;
+    }
+    pthread_mutex_unlock(&history_lock);
+}
@@ -1,158 +1,407 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <math.h>
 #include "../include/json.h"
 
-#define JSON_INITIAL_CAPACITY 1024
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define JSON_HAVE_X86_SIMD 1
+#endif
 
-JSONBuffer* json_create_object() {
-    JSONBuffer *json = (JSONBuffer *)malloc(sizeof(JSONBuffer));
-    json->capacity = JSON_INITIAL_CAPACITY;
-    json->data = (char *)malloc(json->capacity);
-    json->size = 0;
-    strcpy(json->data, "{");
-    json->size = 1;
-    return json;
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+size_t json_format_uint(char *out, uint64_t value) {
+    char buffer[20];
+    char *p = buffer + sizeof(buffer);
+
+    // Two digits per step from a lookup table
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (value >= 10) {
+        unsigned pair = (unsigned)value * 2;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    } else {
+        *--p = (char)('0' + value);
+    }
+
+    size_t length = buffer + sizeof(buffer) - p;
+    memcpy(out, p, length);
+    return length;
 }
 
-JSONBuffer* json_create_array() {
-    JSONBuffer *json = (JSONBuffer *)malloc(sizeof(JSONBuffer));
-    json->capacity = JSON_INITIAL_CAPACITY;
-    json->data = (char *)malloc(json->capacity);
+size_t json_format_int(char *out, int64_t value) {
+    if (value < 0) {
+        *out = '-';
+        return 1 + json_format_uint(out + 1, (uint64_t)0 - (uint64_t)value);
+    }
+    return json_format_uint(out, (uint64_t)value);
+}
+
+// Formats with exactly two decimals (like "%.2f") using integer arithmetic.
+// Non-finite values become null; magnitudes beyond 1e15 fall back to
+// exponent notation. The output never exceeds 32 characters.
+size_t json_format_fixed2(char *out, double value) {
+    if (!isfinite(value)) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+    if (fabs(value) >= 1e15) {
+        int length = snprintf(out, 32, "%.17g", value);
+        return length > 0 ? (size_t)length : 0;
+    }
+
+    size_t length = 0;
+    uint64_t scaled = (uint64_t)llround(fabs(value) * 100.0);
+    if (value < 0 && scaled != 0)
+        out[length++] = '-';
+
+    length += json_format_uint(out + length, scaled / 100);
+    unsigned cents = (unsigned)(scaled % 100) * 2;
+    out[length++] = '.';
+    out[length++] = digit_pairs[cents];
+    out[length++] = digit_pairs[cents + 1];
+    return length;
+}
+
+void json_writer_init(JSONWriter *json, char *buffer, size_t capacity) {
+    json->data = buffer;
     json->size = 0;
-    strcpy(json->data, "[");
-    json->size = 1;
-    return json;
-}
-
-static void json_ensure_capacity(JSONBuffer *json, int needed) {
-    while (json->size + needed >= json->capacity) {
-        json->capacity *= 2;
-        json->data = (char *)realloc(json->data, json->capacity);
-    }
-}
-
-static void json_append(JSONBuffer *json, const char *str) {
-    int len = strlen(str);
-    json_ensure_capacity(json, len + 1);
-    strcpy(json->data + json->size, str);
-    json->size += len;
-}
-
-void json_add_string(JSONBuffer *json, const char *key, const char *value) {
-    if (json->data[json->size - 1] != '{' && json->data[json->size - 1] != '[') {
-        json_append(json, ",");
-    }
-    
-    // Handle NULL values
-    if (value == NULL) {
-        value = "";
-    }
-    
-    char buffer[2048];
-    // Escape quotes and backslashes in value
-    char escaped[1024] = {0};
-    int j = 0;
-    for (int i = 0; value[i] && j < sizeof(escaped) - 2; i++) {
-        if (value[i] == '"') {
-            escaped[j++] = '\\';
-            escaped[j++] = '"';
-        } else if (value[i] == '\\') {
-            escaped[j++] = '\\';
-            escaped[j++] = '\\';
-        } else if (value[i] == '\n') {
-            escaped[j++] = '\\';
-            escaped[j++] = 'n';
-        } else if (value[i] == '\r') {
-            escaped[j++] = '\\';
-            escaped[j++] = 'r';
-        } else if (value[i] == '\t') {
-            escaped[j++] = '\\';
-            escaped[j++] = 't';
-        } else {
-            escaped[j++] = value[i];
-        }
+    json->capacity = capacity;
+    json->depth = 0;
+    json->error = capacity == 0;
+}
+
+// Makes room for n more bytes plus the terminating NUL
+static int json_reserve(JSONWriter *json, size_t n) {
+    if (json->error)
+        return 0;
+    if (json->size + n + 1 > json->capacity) {
+        json->error = 1;
+        return 0;
     }
-    escaped[j] = '\0';
-    
-    snprintf(buffer, sizeof(buffer), "\"%s\":\"%s\"", key, escaped);
-    json_append(json, buffer);
+    return 1;
 }
 
-void json_add_number(JSONBuffer *json, const char *key, double value) {
-    if (json->data[json->size - 1] != '{' && json->data[json->size - 1] != '[') {
-        json_append(json, ",");
+static void json_put(JSONWriter *json, const char *str, size_t length) {
+    if (json_reserve(json, length)) {
+        memcpy(json->data + json->size, str, length);
+        json->size += length;
     }
-    
-    char buffer[512];
-    snprintf(buffer, sizeof(buffer), "\"%s\":%.2f", key, value);
-    json_append(json, buffer);
 }
 
-void json_add_integer(JSONBuffer *json, const char *key, int value) {
-    if (json->data[json->size - 1] != '{' && json->data[json->size - 1] != '[') {
-        json_append(json, ",");
+static void json_put_char(JSONWriter *json, char c) {
+    if (json_reserve(json, 1))
+        json->data[json->size++] = c;
+}
+
+// Escape action per byte: 0 = copy, 'u' = \u00XX, anything else = \<char>
+static const char escape_table[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static inline char* escape_byte(char *out, unsigned char c) {
+    char action = escape_table[c];
+    *out++ = '\\';
+    if (action == 'u') {
+        memcpy(out, "u00", 3);
+        out[3] = hex_digits[c >> 4];
+        out[4] = hex_digits[c & 0xf];
+        return out + 5;
+    }
+    *out++ = action;
+    return out;
+}
+
+size_t json_escape_scalar(char *out, const char *in, size_t length) {
+    char *start = out;
+    size_t i = 0;
+
+    while (i < length) {
+        // Copy the clean run in one go
+        size_t run = i;
+        while (run < length && escape_table[(unsigned char)in[run]] == 0)
+            run++;
+        memcpy(out, in + i, run - i);
+        out += run - i;
+        if (run == length)
+            break;
+        out = escape_byte(out, (unsigned char)in[run]);
+        i = run + 1;
     }
-    
-    char buffer[512];
-    snprintf(buffer, sizeof(buffer), "\"%s\":%d", key, value);
-    json_append(json, buffer);
+    return out - start;
 }
 
-void json_add_boolean(JSONBuffer *json, const char *key, int value) {
-    if (json->data[json->size - 1] != '{' && json->data[json->size - 1] != '[') {
-        json_append(json, ",");
+#ifdef JSON_HAVE_X86_SIMD
+// Copies a block whose bytes needing escapes are flagged in mask
+static inline char* escape_block(char *out, const char *in, unsigned mask, unsigned width) {
+    unsigned pos = 0;
+    while (mask) {
+        unsigned special = (unsigned)__builtin_ctz(mask);
+        memcpy(out, in + pos, special - pos);
+        out = escape_byte(out + (special - pos), (unsigned char)in[special]);
+        pos = special + 1;
+        mask &= mask - 1;
     }
-    
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer), "\"%s\":%s", key, value ? "true" : "false");
-    json_append(json, buffer);
+    memcpy(out, in + pos, width - pos);
+    return out + (width - pos);
 }
 
-void json_add_object(JSONBuffer *parent, const char *key, JSONBuffer *child) {
-    if (parent->data[parent->size - 1] != '{' && parent->data[parent->size - 1] != '[') {
-        json_append(parent, ",");
+// Both vector versions test 16/32 bytes at once for '"', '\\' and bytes
+// below 0x20, store clean blocks unchanged and only walk the flagged bytes
+// of blocks that contain something to escape.
+size_t json_escape_sse2(char *out, const char *in, size_t length) {
+    char *start = out;
+    size_t i = 0;
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+
+    while (i + 16 <= length) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+        unsigned mask = (unsigned)_mm_movemask_epi8(special);
+
+        if (mask == 0) {
+            _mm_storeu_si128((__m128i *)out, block);
+            out += 16;
+            i += 16;
+            continue;
+        }
+
+        out = escape_block(out, in + i, mask, 16);
+        i += 16;
     }
-    
-    // Close the child object/array
-    if (child->data[child->size - 1] == '{') {
-        json_append(child, "}");
-    } else if (child->data[child->size - 1] == '[') {
-        json_append(child, "]");
-    } else if (child->data[child->size - 1] != '}' && child->data[child->size - 1] != ']') {
-        if (child->data[0] == '{') {
-            json_append(child, "}");
-        } else {
-            json_append(child, "]");
+
+    return (out - start) + json_escape_scalar(out, in + i, length - i);
+}
+
+__attribute__((target("avx2")))
+size_t json_escape_avx2(char *out, const char *in, size_t length) {
+    char *start = out;
+    size_t i = 0;
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1f);
+
+    while (i + 32 <= length) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, backslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(block, control), control));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(special);
+
+        if (mask == 0) {
+            _mm256_storeu_si256((__m256i *)out, block);
+            out += 32;
+            i += 32;
+            continue;
         }
+
+        out = escape_block(out, in + i, mask, 32);
+        i += 32;
+    }
+
+    return (out - start) + json_escape_sse2(out, in + i, length - i);
+}
+#endif
+
+static JSONEscapeFn escape_impl = json_escape_scalar;
+static const char *escape_impl_name = "scalar";
+
+// Picks the widest escaper the CPU supports once at startup
+__attribute__((constructor))
+static void json_select_escaper() {
+#ifdef JSON_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        escape_impl = json_escape_avx2;
+        escape_impl_name = "avx2";
+    } else {
+        escape_impl = json_escape_sse2;
+        escape_impl_name = "sse2";
     }
-    
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer), "\"%s\":%s", key, child->data);
-    json_append(parent, buffer);
+#endif
 }
 
-const char* json_get_string(JSONBuffer *json) {
-    // Check if the JSON starts with '{' or '[' and close appropriately
-    if (json->data[0] == '{') {
-        // Only add closing brace if not already closed
-        if (json->data[json->size - 1] != '}') {
-            json_append(json, "}");
+JSONEscapeFn json_escape_backend(const char *name) {
+    if (name == NULL)
+        return escape_impl;
+    if (strcmp(name, "scalar") == 0)
+        return json_escape_scalar;
+#ifdef JSON_HAVE_X86_SIMD
+    if (strcmp(name, "sse2") == 0)
+        return json_escape_sse2;
+    if (strcmp(name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2") ? json_escape_avx2 : NULL;
+#endif
+    return NULL;
+}
+
+const char* json_escape_backend_name() {
+    return escape_impl_name;
+}
+
+size_t json_escape(char *out, const char *in, size_t length) {
+    return escape_impl(out, in, length);
+}
+
+static void json_put_escaped(JSONWriter *json, const char *value) {
+    json_put_char(json, '"');
+
+    size_t length = strlen(value);
+    while (length > 0 && !json->error) {
+        // Escape as much as is guaranteed to fit (6 bytes per input byte worst
+        // case), keeping room for the closing quote and the terminating NUL
+        if (json->capacity - json->size < 2) {
+            json->error = 1;
+            return;
         }
-    } else if (json->data[0] == '[') {
-        // Only add closing bracket if not already closed
-        if (json->data[json->size - 1] != ']') {
-            json_append(json, "]");
+        size_t available = json->capacity - json->size - 2;
+        size_t chunk = available / JSON_ESCAPE_MAX_EXPANSION;
+
+        if (chunk == 0) {
+            // Nearly full: finish byte by byte with exact bounds
+            char escaped[JSON_ESCAPE_MAX_EXPANSION];
+            size_t n = json_escape_scalar(escaped, value, 1);
+            if (n > available) {
+                json->error = 1;
+                return;
+            }
+            memcpy(json->data + json->size, escaped, n);
+            json->size += n;
+            value++;
+            length--;
+            continue;
         }
+
+        if (chunk > length)
+            chunk = length;
+        json->size += escape_impl(json->data + json->size, value, chunk);
+        value += chunk;
+        length -= chunk;
     }
-    return json->data;
+
+    json_put_char(json, '"');
 }
 
-void json_free(JSONBuffer *json) {
-    if (json) {
-        if (json->data)
-            free(json->data);
-        free(json);
+// Writes the separator and key that precede every value
+static void json_prefix(JSONWriter *json, const char *key) {
+    if (json->depth > 0) {
+        if (json->has_items[json->depth - 1])
+            json_put_char(json, ',');
+        json->has_items[json->depth - 1] = 1;
+    }
+    if (key) {
+        json_put_escaped(json, key);
+        json_put_char(json, ':');
     }
 }
+
+static void json_open(JSONWriter *json, const char *key, char bracket) {
+    json_prefix(json, key);
+    if (json->depth >= JSON_MAX_DEPTH) {
+        json->error = 1;
+        return;
+    }
+    json_put_char(json, bracket);
+    json->has_items[json->depth++] = 0;
+}
+
+static void json_close(JSONWriter *json, char bracket) {
+    if (json->depth == 0) {
+        json->error = 1;
+        return;
+    }
+    json->depth--;
+    json_put_char(json, bracket);
+}
+
+void json_begin_object(JSONWriter *json, const char *key) {
+    json_open(json, key, '{');
+}
+
+void json_end_object(JSONWriter *json) {
+    json_close(json, '}');
+}
+
+void json_begin_array(JSONWriter *json, const char *key) {
+    json_open(json, key, '[');
+}
+
+void json_end_array(JSONWriter *json) {
+    json_close(json, ']');
+}
+
+void json_write_string(JSONWriter *json, const char *key, const char *value) {
+    json_prefix(json, key);
+    json_put_escaped(json, value ? value : "");
+}
+
+void json_write_int(JSONWriter *json, const char *key, int64_t value) {
+    json_prefix(json, key);
+    if (json_reserve(json, 20))
+        json->size += json_format_int(json->data + json->size, value);
+}
+
+void json_write_uint(JSONWriter *json, const char *key, uint64_t value) {
+    json_prefix(json, key);
+    if (json_reserve(json, 20))
+        json->size += json_format_uint(json->data + json->size, value);
+}
+
+void json_write_number(JSONWriter *json, const char *key, double value) {
+    json_prefix(json, key);
+    if (json_reserve(json, 32))
+        json->size += json_format_fixed2(json->data + json->size, value);
+}
+
+void json_write_bool(JSONWriter *json, const char *key, int value) {
+    json_prefix(json, key);
+    if (value)
+        json_put(json, "true", 4);
+    else
+        json_put(json, "false", 5);
+}
+
+void json_write_null(JSONWriter *json, const char *key) {
+    json_prefix(json, key);
+    json_put(json, "null", 4);
+}
+
+void json_write_raw(JSONWriter *json, const char *key, const char *value, size_t length) {
+    json_prefix(json, key);
+    json_put(json, value, length);
+}
+
+int json_writer_finish(JSONWriter *json) {
+    if (json->depth != 0)
+        json->error = 1;
+    if (json->capacity > 0)
+        json->data[json->size < json->capacity ? json->size : json->capacity - 1] = '\0';
+    return json->error ? -1 : 0;
+}
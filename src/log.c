@@ -0,0 +1,283 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "../include/log.h"
+
+#define LOG_DRAIN_INTERVAL_NS 5000000L  // 5 ms
+
+typedef struct {
+    struct timespec timestamp;
+    const char *event;
+    int thread_id;
+    LogLevel level;
+    char message[LOG_MESSAGE_MAX];
+} LogRecord;
+
+// Single-producer single-consumer ring owned by one thread at a time. The
+// owning thread only advances head, the writer thread only advances tail.
+typedef struct {
+    _Atomic unsigned head;
+    char pad1[60];
+    _Atomic unsigned tail;
+    char pad2[60];
+    atomic_int in_use;
+    atomic_int released;
+    LogRecord slots[LOG_RING_SLOTS];
+} LogRing;
+
+static LogRing rings[LOG_MAX_RINGS];
+static __thread LogRing *thread_ring = NULL;
+static __thread int thread_id = 0;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+
+static atomic_int min_level = LOG_INFO;
+static LogFormat output_format = LOG_FORMAT_LOGFMT;
+static FILE *output_stream = NULL;  // stdout unless log_set_stream() was called
+static atomic_uint sample_rate = 1;
+static atomic_ulong dropped = 0;
+static atomic_int writer_running = 0;
+static pthread_t writer_thread;
+
+static const char *level_names[] = { "debug", "info", "warn", "error" };
+
+static void release_ring(void *ring) {
+    // The writer drains what is left and then returns the ring to the pool
+    atomic_store_explicit(&((LogRing *)ring)->released, 1, memory_order_release);
+}
+
+static void create_ring_key() {
+    pthread_key_create(&ring_key, release_ring);
+}
+
+static LogRing* acquire_ring() {
+    pthread_once(&ring_key_once, create_ring_key);
+
+    for (int i = 0; i < LOG_MAX_RINGS; i++) {
+        int expected = 0;
+        // The writer cleared released before freeing the ring
+        if (atomic_compare_exchange_strong(&rings[i].in_use, &expected, 1)) {
+            pthread_setspecific(ring_key, &rings[i]);
+            return &rings[i];
+        }
+    }
+    return NULL;
+}
+
+static size_t format_record(char *out, size_t size, const LogRecord *record) {
+    struct tm tm;
+    char timestamp[32];
+    gmtime_r(&record->timestamp.tv_sec, &tm);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    // Escape the message for either quoted form
+    char message[LOG_MESSAGE_MAX * 2];
+    size_t j = 0;
+    for (const char *c = record->message; *c && j < sizeof(message) - 2; c++) {
+        if (*c == '"' || *c == '\\') {
+            message[j++] = '\\';
+            message[j++] = *c;
+        } else if ((unsigned char)*c < 0x20) {
+            message[j++] = ' ';
+        } else {
+            message[j++] = *c;
+        }
+    }
+    message[j] = '\0';
+
+    int written;
+    if (output_format == LOG_FORMAT_JSON) {
+        written = snprintf(out, size,
+                           "{\"ts\":\"%s.%03ldZ\",\"level\":\"%s\",\"thread\":%d,\"event\":\"%s\",\"msg\":\"%s\"}\n",
+                           timestamp, record->timestamp.tv_nsec / 1000000, level_names[record->level],
+                           record->thread_id, record->event, message);
+    } else {
+        written = snprintf(out, size, "ts=%s.%03ldZ level=%s thread=%d event=%s msg=\"%s\"\n",
+                           timestamp, record->timestamp.tv_nsec / 1000000, level_names[record->level],
+                           record->thread_id, record->event, message);
+    }
+
+    if (written < 0)
+        return 0;
+    return (size_t)written < size ? (size_t)written : size - 1;
+}
+
+static FILE *log_stream() {
+    return output_stream ? output_stream : stdout;
+}
+
+// Drains every ring into one buffer and writes it with a single fwrite
+static int drain_rings() {
+    static char batch[65536];
+    size_t batch_size = 0;
+    int records = 0;
+
+    for (int i = 0; i < LOG_MAX_RINGS; i++) {
+        LogRing *ring = &rings[i];
+        if (!atomic_load_explicit(&ring->in_use, memory_order_acquire))
+            continue;
+
+        int released = atomic_load_explicit(&ring->released, memory_order_acquire);
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        while (tail != head) {
+            if (sizeof(batch) - batch_size < LOG_MESSAGE_MAX * 3) {
+                fwrite(batch, 1, batch_size, log_stream());
+                batch_size = 0;
+            }
+            batch_size += format_record(batch + batch_size, sizeof(batch) - batch_size,
+                                        &ring->slots[tail % LOG_RING_SLOTS]);
+            tail++;
+            records++;
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+        if (released) {
+            // Cleared before in_use, so a new owner never looks released
+            atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+            atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+            atomic_store_explicit(&ring->released, 0, memory_order_relaxed);
+            atomic_store_explicit(&ring->in_use, 0, memory_order_release);
+        }
+    }
+
+    unsigned long lost = atomic_exchange(&dropped, 0);
+    if (lost > 0) {
+        batch_size += snprintf(batch + batch_size, sizeof(batch) - batch_size,
+                               output_format == LOG_FORMAT_JSON
+                                   ? "{\"level\":\"warn\",\"event\":\"log_dropped\",\"count\":%lu}\n"
+                                   : "level=warn event=log_dropped count=%lu\n",
+                               lost);
+    }
+
+    if (batch_size > 0) {
+        fwrite(batch, 1, batch_size, log_stream());
+        fflush(log_stream());
+    }
+    return records;
+}
+
+static void *writer_loop(void *arg) {
+    (void)arg;
+    struct timespec interval = { 0, LOG_DRAIN_INTERVAL_NS };
+
+    while (atomic_load(&writer_running)) {
+        if (drain_rings() == 0)
+            nanosleep(&interval, NULL);
+    }
+    drain_rings();
+    return NULL;
+}
+
+int log_init(LogLevel level, LogFormat format) {
+    atomic_store(&min_level, level);
+    output_format = format;
+
+    atomic_store(&writer_running, 1);
+    if (pthread_create(&writer_thread, NULL, writer_loop, NULL) != 0) {
+        atomic_store(&writer_running, 0);
+        return -1;
+    }
+    return 0;
+}
+
+void log_set_stream(FILE *stream) {
+    output_stream = stream;
+}
+
+void log_shutdown() {
+    if (atomic_exchange(&writer_running, 0))
+        pthread_join(writer_thread, NULL);
+}
+
+int log_parse_level(const char *name, LogLevel *level) {
+    for (int i = LOG_DEBUG; i <= LOG_ERROR; i++) {
+        if (strcmp(name, level_names[i]) == 0) {
+            *level = (LogLevel)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int log_parse_format(const char *name, LogFormat *format) {
+    if (strcmp(name, "logfmt") == 0) {
+        *format = LOG_FORMAT_LOGFMT;
+    } else if (strcmp(name, "json") == 0) {
+        *format = LOG_FORMAT_JSON;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int log_enabled(LogLevel level) {
+    return (int)level >= atomic_load_explicit(&min_level, memory_order_relaxed);
+}
+
+void log_set_sample_rate(unsigned every) {
+    atomic_store(&sample_rate, every > 0 ? every : 1);
+}
+
+unsigned log_sample_rate() {
+    return atomic_load_explicit(&sample_rate, memory_order_relaxed);
+}
+
+void log_write(LogLevel level, const char *event, const char *fmt, ...) {
+    if (!log_enabled(level))
+        return;
+
+    if (thread_id == 0)
+        thread_id = (int)syscall(SYS_gettid);
+
+    LogRecord local;
+    LogRecord *record = &local;
+    LogRing *ring = NULL;
+    unsigned head = 0;
+
+    if (atomic_load_explicit(&writer_running, memory_order_relaxed)) {
+        if (thread_ring == NULL)
+            thread_ring = acquire_ring();
+        ring = thread_ring;
+        if (ring == NULL) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        }
+
+        head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - tail >= LOG_RING_SLOTS) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        }
+        record = &ring->slots[head % LOG_RING_SLOTS];
+    }
+
+    clock_gettime(CLOCK_REALTIME, &record->timestamp);
+    record->event = event;
+    record->thread_id = thread_id;
+    record->level = level;
+
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(record->message, sizeof(record->message), fmt, args);
+    va_end(args);
+
+    if (ring) {
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    } else {
+        // No writer thread yet: fall back to a direct write
+        char line[LOG_MESSAGE_MAX * 3];
+        fwrite(line, 1, format_record(line, sizeof(line), record), log_stream());
+        fflush(log_stream());
+    }
+}
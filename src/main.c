@@ -6,17 +6,59 @@
 #include <pthread.h>
 #include "../include/server.h"
 #include "../include/network.h"
+#include "../include/log.h"
+#include "../include/events.h"
+#include "../include/history.h"
+#include "../include/shm_export.h"
+#include "../include/collect.h"
+#include "../include/fleet.h"
+#include "../include/wireless.h"
 
 void usage() {
     printf("Usage: network-diagnostic [options]\n");
     printf("Options:\n");
     printf("  -p, --port PORT     Port to run server on (default: 8080)\n");
+    printf("  --log-level LEVEL   debug, info, warn or error (default: info)\n");
+    printf("  --log-format FORMAT logfmt or json (default: logfmt)\n");
+    printf("  --log-sample N      Log only every N-th request line (default: 1)\n");
+    printf("  --history PATH      History store file (default: %s)\n", HISTORY_DEFAULT_PATH);
+    printf("  --no-history        Do not record speed test and interface history\n");
+    printf("  --web-root DIR      Serve the web UI from DIR instead of the built-in copy\n");
+    printf("  --shm NAME          Shared-memory stats segment (default: %s)\n", NETDIAG_SHM_DEFAULT_NAME);
+    printf("  --no-shm            Do not export stats to shared memory\n");
+    printf("  --collect           Write NDJSON records instead of serving HTTP\n");
+    printf("  --interval SECONDS  Time between collected records (default: %d)\n",
+           COLLECT_DEFAULT_INTERVAL_MS / 1000);
+    printf("  --count N           Stop after N records (default: run until stopped)\n");
+    printf("  --output PATH       Append records to PATH instead of stdout\n");
+    printf("  --speed-test        Include a speed test in every record\n");
+    printf("  --peer URL          Scrape a peer instance for /api/fleet (repeatable)\n");
+    printf("  --peers-file PATH   Read peer URLs from PATH, one per line\n");
+    printf("  --fleet-interval S  Seconds between scrapes of each peer (default: %d)\n",
+           FLEET_DEFAULT_INTERVAL_MS / 1000);
+    printf("  --fleet-timeout S   Per-scrape timeout in seconds (default: %d)\n",
+           FLEET_DEFAULT_TIMEOUT_MS / 1000);
+    printf("  --fast-workers N    Workers for cached reads and static files (default: %d)\n",
+           LANE_FAST_WORKERS);
+    printf("  --slow-workers N    Workers for speed tests and traceroutes (default: %d)\n",
+           LANE_SLOW_WORKERS);
+    printf("  --slow-rate N       Speed tests and traceroutes per minute per client,\n"
+           "                      0 for no limit (default: %d)\n", SLOW_RATE_PER_MINUTE);
+    printf("  --io-backend NAME   portable or io_uring (default: portable)\n");
     printf("  -h, --help          Show this help message\n");
     printf("  -v, --version       Show version\n");
 }
 
 int main(int argc, char *argv[]) {
     int port = SERVER_PORT;
+    LogLevel log_level = LOG_INFO;
+    LogFormat log_format = LOG_FORMAT_LOGFMT;
+    const char *history_path = HISTORY_DEFAULT_PATH;
+    const char *shm_name = NETDIAG_SHM_DEFAULT_NAME;
+    int collect = 0;
+    CollectOptions collect_options = { COLLECT_DEFAULT_INTERVAL_MS, 0, 0, NULL };
+    unsigned fleet_interval_ms = FLEET_DEFAULT_INTERVAL_MS;
+    unsigned fleet_timeout_ms = FLEET_DEFAULT_TIMEOUT_MS;
 
     // Parse arguments
     for (int i = 1; i < argc; i++) {
@@ -24,6 +66,103 @@ int main(int argc, char *argv[]) {
             if (i + 1 < argc) {
                 port = atoi(argv[++i]);
             }
+        } else if (strcmp(argv[i], "--log-level") == 0) {
+            if (i + 1 >= argc || log_parse_level(argv[++i], &log_level) < 0) {
+                fprintf(stderr, "Invalid log level\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-format") == 0) {
+            if (i + 1 >= argc || log_parse_format(argv[++i], &log_format) < 0) {
+                fprintf(stderr, "Invalid log format\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-sample") == 0) {
+            if (i + 1 < argc) {
+                log_set_sample_rate((unsigned)atoi(argv[++i]));
+            }
+        } else if (strcmp(argv[i], "--history") == 0) {
+            if (i + 1 < argc) {
+                history_path = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--no-history") == 0) {
+            history_path = NULL;
+        } else if (strcmp(argv[i], "--web-root") == 0) {
+            if (i + 1 < argc) {
+                server_set_web_root(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--shm") == 0) {
+            if (i + 1 < argc) {
+                shm_name = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--no-shm") == 0) {
+            shm_name = NULL;
+        } else if (strcmp(argv[i], "--collect") == 0) {
+            collect = 1;
+        } else if (strcmp(argv[i], "--interval") == 0) {
+            double seconds = i + 1 < argc ? atof(argv[++i]) : 0;
+            if (seconds < 0.001 || seconds > 86400) {
+                fprintf(stderr, "Invalid interval\n");
+                return 1;
+            }
+            collect_options.interval_ms = (unsigned)(seconds * 1000);
+        } else if (strcmp(argv[i], "--count") == 0) {
+            if (i + 1 >= argc || (collect_options.count = atol(argv[++i])) < 1) {
+                fprintf(stderr, "Invalid count\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--output") == 0) {
+            if (i + 1 < argc) {
+                collect_options.output = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--speed-test") == 0) {
+            collect_options.speed_test = 1;
+        } else if (strcmp(argv[i], "--peer") == 0) {
+            if (i + 1 >= argc || fleet_add_peer(argv[++i]) < 0) {
+                fprintf(stderr, "Invalid peer\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--peers-file") == 0) {
+            if (i + 1 >= argc || fleet_load_peers(argv[++i]) < 0) {
+                fprintf(stderr, "Cannot load peers\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fleet-interval") == 0 ||
+                   strcmp(argv[i], "--fleet-timeout") == 0) {
+            const char *option = argv[i];
+            double seconds = i + 1 < argc ? atof(argv[++i]) : 0;
+            if (seconds < 0.1 || seconds > 86400) {
+                fprintf(stderr, "Invalid %s\n", option + 2);
+                return 1;
+            }
+            if (strcmp(option, "--fleet-interval") == 0)
+                fleet_interval_ms = (unsigned)(seconds * 1000);
+            else
+                fleet_timeout_ms = (unsigned)(seconds * 1000);
+        } else if (strcmp(argv[i], "--fast-workers") == 0 ||
+                   strcmp(argv[i], "--slow-workers") == 0) {
+            const char *option = argv[i];
+            int workers = i + 1 < argc ? atoi(argv[++i]) : 0;
+            LaneId lane = strcmp(option, "--fast-workers") == 0 ? LANE_FAST : LANE_SLOW;
+            if (workers < 1 || workers > 1024 ||
+                server_configure_lane(lane, workers, lane == LANE_FAST ? LANE_FAST_QUEUE
+                                                                        : LANE_SLOW_QUEUE) < 0) {
+                fprintf(stderr, "Invalid %s\n", option + 2);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--slow-rate") == 0) {
+            double per_minute = i + 1 < argc ? atof(argv[++i]) : -1;
+            if (per_minute < 0 || per_minute > 60000) {
+                fprintf(stderr, "Invalid slow-rate\n");
+                return 1;
+            }
+            server_set_slow_rate(per_minute, SLOW_RATE_BURST);
+        } else if (strcmp(argv[i], "--io-backend") == 0) {
+            IoBackend backend;
+            if (i + 1 >= argc || io_backend_parse(argv[++i], &backend) < 0) {
+                fprintf(stderr, "Invalid io-backend\n");
+                return 1;
+            }
+            server_set_io_backend(backend);
         } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
             usage();
             return 0;
@@ -33,6 +172,17 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Headless collector: no banner, server, history or exports; stdout
+    // belongs to the records, so log lines go to stderr
+    if (collect) {
+        log_set_stream(stderr);
+        log_init(log_level, log_format);
+        int result = collect_run(&collect_options);
+        cleanup_network();
+        log_shutdown();
+        return result == 0 ? 0 : 1;
+    }
+
     printf("========================================\n");
     printf("   Network Diagnostic Tool v1.0.0\n");
     printf("========================================\n");
@@ -40,6 +190,32 @@ int main(int argc, char *argv[]) {
     printf("Open http://localhost:%d in your browser\n", port);
     printf("Press Ctrl+C to stop\n");
     printf("========================================\n\n");
+    fflush(stdout);
+
+    // Everything from here on goes through the asynchronous logger
+    log_init(log_level, log_format);
+
+    // Location from the system time zone, resolved before the first request
+    load_isp_info();
+
+    // Persistent speed test and interface history for /api/history
+    if (history_path && history_open(history_path) == 0)
+        history_start_sampler();
+
+    // Stats for local agents that read shared memory instead of HTTP
+    if (shm_name)
+        shm_export_start(shm_name);
+
+    // Link metrics for /api/wireless; hosts without a wireless driver skip it
+    if (wireless_start_sampler(WIRELESS_SAMPLE_INTERVAL_MS) < 0)
+        log_info("wireless_unavailable", "nl80211 not available, /api/wireless disabled");
+
+    // Aggregator mode: scrape peers for /api/fleet
+    fleet_start(fleet_interval_ms, fleet_timeout_ms);
+
+    // Live update producer for /api/events
+    if (events_start() < 0)
+        log_warn("events_unavailable", "Failed to start event producer");
 
     // Create server thread
     pthread_t server_thread;
@@ -49,8 +225,14 @@ int main(int argc, char *argv[]) {
     // Wait for server thread
     pthread_join(server_thread, NULL);
 
-    printf("\nServer stopped\n");
+    log_info("server_stopped", "Server stopped");
+    events_stop();
+    fleet_stop();
+    wireless_stop_sampler();
+    history_close();
+    shm_export_stop();
     cleanup_network();
+    log_shutdown();
 
     return 0;
 }
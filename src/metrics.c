@@ -0,0 +1,310 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <inttypes.h>
+#include "../include/metrics.h"
+#include "../include/events.h"
+
+static const int tracked_status_codes[] = { 200, 304, 400, 404, 429, 500, 503 };
+#define STATUS_SLOTS (sizeof(tracked_status_codes) / sizeof(tracked_status_codes[0]) + 1)
+
+// Counters are spread over cache-line aligned shards so concurrent handler
+// threads rarely touch the same lines; shards are only summed at scrape time.
+typedef struct {
+    _Atomic uint64_t requests[ROUTE_COUNT];
+    _Atomic int64_t in_flight[ROUTE_COUNT];
+    _Atomic uint64_t responses[ROUTE_COUNT][STATUS_SLOTS];
+    _Atomic uint64_t latency_sum_us[ROUTE_COUNT];
+    // One extra slot past the finite buckets for latencies above all of them
+    _Atomic uint64_t latency_buckets[ROUTE_COUNT][METRICS_HISTOGRAM_BUCKETS + 1];
+} __attribute__((aligned(64))) MetricsShard;
+
+static MetricsShard shards[METRICS_SHARDS];
+static atomic_uint next_shard = 0;
+static __thread int thread_shard = -1;
+
+// Gauges change rarely (once per speed test / stats request)
+static pthread_mutex_t gauge_lock = PTHREAD_MUTEX_INITIALIZER;
+static SpeedTestResult last_speed_test;
+static int have_speed_test = 0;
+static struct {
+    char name[64];
+    uint64_t bytes_sent;
+    uint64_t bytes_recv;
+    double send_rate;
+    double recv_rate;
+    uint64_t sampled_at_us;
+} last_interface;
+
+typedef struct {
+    Arena *arena;
+    char *data;
+    size_t size;
+    size_t capacity;
+} TextBuffer;
+
+static MetricsShard* current_shard() {
+    if (thread_shard < 0)
+        thread_shard = atomic_fetch_add_explicit(&next_shard, 1, memory_order_relaxed) % METRICS_SHARDS;
+    return &shards[thread_shard];
+}
+
+static int histogram_bucket(uint64_t us) {
+    if (us < (1u << METRICS_SUB_BUCKET_BITS))
+        return (int)us;
+
+    int exponent = 63 - __builtin_clzll(us);
+    if (exponent > METRICS_MAX_EXPONENT)
+        return METRICS_HISTOGRAM_BUCKETS;
+
+    int sub = (us >> (exponent - METRICS_SUB_BUCKET_BITS)) & ((1 << METRICS_SUB_BUCKET_BITS) - 1);
+    return ((exponent - METRICS_SUB_BUCKET_BITS + 1) << METRICS_SUB_BUCKET_BITS) + sub;
+}
+
+// Exclusive upper bound of a bucket in microseconds
+static uint64_t histogram_bucket_limit(int bucket) {
+    if (bucket < (1 << METRICS_SUB_BUCKET_BITS))
+        return (uint64_t)bucket + 1;
+
+    int exponent = (bucket >> METRICS_SUB_BUCKET_BITS) + METRICS_SUB_BUCKET_BITS - 1;
+    uint64_t sub = bucket & ((1 << METRICS_SUB_BUCKET_BITS) - 1);
+    uint64_t width = 1ULL << (exponent - METRICS_SUB_BUCKET_BITS);
+    return (1ULL << exponent) + (sub + 1) * width;
+}
+
+static int status_slot(int status_code) {
+    for (size_t i = 0; i < STATUS_SLOTS - 1; i++) {
+        if (tracked_status_codes[i] == status_code)
+            return (int)i;
+    }
+    return STATUS_SLOTS - 1;
+}
+
+uint64_t metrics_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void metrics_request_begin(RouteId route) {
+    MetricsShard *shard = current_shard();
+    atomic_fetch_add_explicit(&shard->requests[route], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->in_flight[route], 1, memory_order_relaxed);
+}
+
+void metrics_request_end(RouteId route, int status_code, uint64_t elapsed_us) {
+    MetricsShard *shard = current_shard();
+    atomic_fetch_sub_explicit(&shard->in_flight[route], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->responses[route][status_slot(status_code)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->latency_sum_us[route], elapsed_us, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->latency_buckets[route][histogram_bucket(elapsed_us)], 1,
+                              memory_order_relaxed);
+}
+
+void metrics_record_speed_test(const SpeedTestResult *result) {
+    pthread_mutex_lock(&gauge_lock);
+    last_speed_test = *result;
+    have_speed_test = 1;
+    pthread_mutex_unlock(&gauge_lock);
+}
+
+void metrics_record_interface(const char *name, uint64_t bytes_sent, uint64_t bytes_recv) {
+    uint64_t now = metrics_now_us();
+
+    pthread_mutex_lock(&gauge_lock);
+    if (strcmp(last_interface.name, name) == 0 && now > last_interface.sampled_at_us &&
+        bytes_sent >= last_interface.bytes_sent && bytes_recv >= last_interface.bytes_recv) {
+        double seconds = (now - last_interface.sampled_at_us) / 1e6;
+        last_interface.send_rate = (bytes_sent - last_interface.bytes_sent) / seconds;
+        last_interface.recv_rate = (bytes_recv - last_interface.bytes_recv) / seconds;
+    } else {
+        last_interface.send_rate = 0;
+        last_interface.recv_rate = 0;
+    }
+    strncpy(last_interface.name, name, sizeof(last_interface.name) - 1);
+    last_interface.bytes_sent = bytes_sent;
+    last_interface.bytes_recv = bytes_recv;
+    last_interface.sampled_at_us = now;
+    pthread_mutex_unlock(&gauge_lock);
+}
+
+static void text_appendf(TextBuffer *text, const char *fmt, ...) {
+    va_list args;
+
+    for (;;) {
+        size_t available = text->capacity - text->size;
+        va_start(args, fmt);
+        int written = vsnprintf(text->data + text->size, available, fmt, args);
+        va_end(args);
+
+        if (written < 0)
+            return;
+        if ((size_t)written < available) {
+            text->size += written;
+            return;
+        }
+
+        size_t capacity = text->capacity * 2;
+        while (capacity - text->size <= (size_t)written)
+            capacity *= 2;
+        char *data = arena_grow(text->arena, text->data, text->capacity, capacity);
+        if (!data)
+            return;
+        text->data = data;
+        text->capacity = capacity;
+    }
+}
+
+char* metrics_render(Arena *arena, size_t *length) {
+    TextBuffer text = { arena, arena_alloc(arena, 16384), 0, 16384 };
+    if (!text.data)
+        return NULL;
+    text.data[0] = '\0';
+
+    uint64_t requests[ROUTE_COUNT] = {0};
+    int64_t in_flight[ROUTE_COUNT] = {0};
+    uint64_t responses[ROUTE_COUNT][STATUS_SLOTS] = {{0}};
+    uint64_t latency_sum[ROUTE_COUNT] = {0};
+    uint64_t buckets[ROUTE_COUNT][METRICS_HISTOGRAM_BUCKETS + 1];
+    memset(buckets, 0, sizeof(buckets));
+
+    for (int s = 0; s < METRICS_SHARDS; s++) {
+        MetricsShard *shard = &shards[s];
+        for (int r = 0; r < ROUTE_COUNT; r++) {
+            requests[r] += atomic_load_explicit(&shard->requests[r], memory_order_relaxed);
+            in_flight[r] += atomic_load_explicit(&shard->in_flight[r], memory_order_relaxed);
+            latency_sum[r] += atomic_load_explicit(&shard->latency_sum_us[r], memory_order_relaxed);
+            for (size_t c = 0; c < STATUS_SLOTS; c++)
+                responses[r][c] += atomic_load_explicit(&shard->responses[r][c], memory_order_relaxed);
+            for (int b = 0; b <= METRICS_HISTOGRAM_BUCKETS; b++)
+                buckets[r][b] += atomic_load_explicit(&shard->latency_buckets[r][b], memory_order_relaxed);
+        }
+    }
+
+    text_appendf(&text, "# HELP netdiag_http_requests_total Total HTTP requests by route.\n"
+                        "# TYPE netdiag_http_requests_total counter\n");
+    for (int r = 0; r < ROUTE_COUNT; r++)
+        text_appendf(&text, "netdiag_http_requests_total{route=\"%s\"} %" PRIu64 "\n",
+                     route_name(r), requests[r]);
+
+    text_appendf(&text, "# HELP netdiag_http_responses_total HTTP responses by route and status code.\n"
+                        "# TYPE netdiag_http_responses_total counter\n");
+    for (int r = 0; r < ROUTE_COUNT; r++) {
+        for (size_t c = 0; c < STATUS_SLOTS; c++) {
+            if (responses[r][c] == 0)
+                continue;
+            if (c < STATUS_SLOTS - 1)
+                text_appendf(&text, "netdiag_http_responses_total{route=\"%s\",code=\"%d\"} %" PRIu64 "\n",
+                             route_name(r), tracked_status_codes[c], responses[r][c]);
+            else
+                text_appendf(&text, "netdiag_http_responses_total{route=\"%s\",code=\"other\"} %" PRIu64 "\n",
+                             route_name(r), responses[r][c]);
+        }
+    }
+
+    text_appendf(&text, "# HELP netdiag_http_requests_in_flight Requests currently being handled.\n"
+                        "# TYPE netdiag_http_requests_in_flight gauge\n");
+    for (int r = 0; r < ROUTE_COUNT; r++)
+        text_appendf(&text, "netdiag_http_requests_in_flight{route=\"%s\"} %" PRId64 "\n",
+                     route_name(r), in_flight[r]);
+
+    LaneStats lane_stats[LANE_COUNT];
+    int have_lanes = 1;
+    for (int lane = 0; lane < LANE_COUNT; lane++)
+        have_lanes = have_lanes && server_lane_stats(lane, &lane_stats[lane]) == 0;
+    if (have_lanes) {
+        text_appendf(&text, "# HELP netdiag_lane_queued Requests waiting for a worker, by lane.\n"
+                            "# TYPE netdiag_lane_queued gauge\n");
+        for (int lane = 0; lane < LANE_COUNT; lane++)
+            text_appendf(&text, "netdiag_lane_queued{lane=\"%s\"} %zu\n",
+                         lane_name(lane), lane_stats[lane].queued);
+        text_appendf(&text, "# HELP netdiag_lane_busy_workers Workers handling a request, by lane.\n"
+                            "# TYPE netdiag_lane_busy_workers gauge\n");
+        for (int lane = 0; lane < LANE_COUNT; lane++)
+            text_appendf(&text, "netdiag_lane_busy_workers{lane=\"%s\"} %d\n",
+                         lane_name(lane), lane_stats[lane].active);
+        text_appendf(&text, "# HELP netdiag_lane_rejected_total Requests refused because the lane queue was full.\n"
+                            "# TYPE netdiag_lane_rejected_total counter\n");
+        for (int lane = 0; lane < LANE_COUNT; lane++)
+            text_appendf(&text, "netdiag_lane_rejected_total{lane=\"%s\"} %" PRIu64 "\n",
+                         lane_name(lane), lane_stats[lane].rejected);
+    }
+
+    text_appendf(&text, "# HELP netdiag_http_request_duration_seconds Handler latency by route.\n"
+                        "# TYPE netdiag_http_request_duration_seconds histogram\n");
+    for (int r = 0; r < ROUTE_COUNT; r++) {
+        uint64_t count = 0;
+        for (int b = 0; b <= METRICS_HISTOGRAM_BUCKETS; b++)
+            count += buckets[r][b];
+        if (count == 0)
+            continue;
+
+        // Emit every boundary up to the highest populated bucket so the
+        // bucket set stays stable between scrapes as latencies grow
+        int last = METRICS_HISTOGRAM_BUCKETS - 1;
+        while (last > 0 && buckets[r][last] == 0)
+            last--;
+
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= last; b++) {
+            cumulative += buckets[r][b];
+            text_appendf(&text, "netdiag_http_request_duration_seconds_bucket{route=\"%s\",le=\"%g\"} %" PRIu64 "\n",
+                         route_name(r), histogram_bucket_limit(b) / 1e6, cumulative);
+        }
+        text_appendf(&text, "netdiag_http_request_duration_seconds_bucket{route=\"%s\",le=\"+Inf\"} %" PRIu64 "\n"
+                            "netdiag_http_request_duration_seconds_sum{route=\"%s\"} %.6f\n"
+                            "netdiag_http_request_duration_seconds_count{route=\"%s\"} %" PRIu64 "\n",
+                     route_name(r), count, route_name(r), latency_sum[r] / 1e6, route_name(r), count);
+    }
+
+    pthread_mutex_lock(&gauge_lock);
+    if (have_speed_test) {
+        text_appendf(&text, "# HELP netdiag_speed_test_download_mbps Download speed of the latest speed test.\n"
+                            "# TYPE netdiag_speed_test_download_mbps gauge\n"
+                            "netdiag_speed_test_download_mbps %.2f\n"
+                            "# HELP netdiag_speed_test_upload_mbps Upload speed of the latest speed test.\n"
+                            "# TYPE netdiag_speed_test_upload_mbps gauge\n"
+                            "netdiag_speed_test_upload_mbps %.2f\n"
+                            "# HELP netdiag_speed_test_ping_ms Ping of the latest speed test.\n"
+                            "# TYPE netdiag_speed_test_ping_ms gauge\n"
+                            "netdiag_speed_test_ping_ms %.2f\n"
+                            "# HELP netdiag_speed_test_timestamp_seconds Time of the latest speed test.\n"
+                            "# TYPE netdiag_speed_test_timestamp_seconds gauge\n"
+                            "netdiag_speed_test_timestamp_seconds %ld\n",
+                     last_speed_test.download_mbps, last_speed_test.upload_mbps,
+                     last_speed_test.ping_ms, (long)last_speed_test.test_time);
+    }
+    if (last_interface.name[0]) {
+        text_appendf(&text, "# HELP netdiag_interface_bytes_sent Bytes sent on the active interface.\n"
+                            "# TYPE netdiag_interface_bytes_sent gauge\n"
+                            "netdiag_interface_bytes_sent{interface=\"%s\"} %" PRIu64 "\n"
+                            "# HELP netdiag_interface_bytes_received Bytes received on the active interface.\n"
+                            "# TYPE netdiag_interface_bytes_received gauge\n"
+                            "netdiag_interface_bytes_received{interface=\"%s\"} %" PRIu64 "\n"
+                            "# HELP netdiag_interface_send_bytes_per_second Send rate between the last two samples.\n"
+                            "# TYPE netdiag_interface_send_bytes_per_second gauge\n"
+                            "netdiag_interface_send_bytes_per_second{interface=\"%s\"} %.1f\n"
+                            "# HELP netdiag_interface_receive_bytes_per_second Receive rate between the last two samples.\n"
+                            "# TYPE netdiag_interface_receive_bytes_per_second gauge\n"
+                            "netdiag_interface_receive_bytes_per_second{interface=\"%s\"} %.1f\n",
+                     last_interface.name, last_interface.bytes_sent,
+                     last_interface.name, last_interface.bytes_recv,
+                     last_interface.name, last_interface.send_rate,
+                     last_interface.name, last_interface.recv_rate);
+    }
+    pthread_mutex_unlock(&gauge_lock);
+
+    text_appendf(&text, "# HELP netdiag_event_subscribers Open /api/events streams.\n"
+                        "# TYPE netdiag_event_subscribers gauge\n"
+                        "netdiag_event_subscribers %d\n",
+                 events_subscriber_count());
+
+    *length = text.size;
+    return text.data;
+}
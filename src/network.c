@@ -11,45 +11,27 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <math.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <linux/nl80211.h>
 #include <curl/curl.h>
 #include <time.h>
+#include <errno.h>
 #include "../include/network.h"
+#include "../include/log.h"
+#include "../include/wireless.h"
+#include "../include/tzdb.h"
 
-// Callback for CURL
-static size_t curl_write_callback_impl(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    char **ptr_ptr = (char **)userp;
-    char *ptr = (char *)realloc(*ptr_ptr, realsize + 1);
-    if (!ptr) {
-        fprintf(stderr, "Not enough memory for curl response\n");
-        return 0;
-    }
-    memcpy(ptr, contents, realsize);
-    ptr[realsize] = 0;
-    *ptr_ptr = ptr;
-    return realsize;
-}
-
-// Structure to track download progress
-typedef struct {
-    char *data;
-    size_t size;
-    size_t capacity;
-} DownloadData;
-
+// Only the amount downloaded matters, so the body is counted and dropped
+// instead of being collected in a growing buffer
 static size_t speed_test_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    (void)contents;
     size_t realsize = size * nmemb;
-    DownloadData *mem = (DownloadData *)userp;
-    
-    if (mem->size + realsize > mem->capacity) {
-        mem->capacity = (mem->size + realsize) * 2;
-        char *ptr = (char *)realloc(mem->data, mem->capacity);
-        if (!ptr) return 0;
-        mem->data = ptr;
-    }
-    
-    memcpy(&(mem->data[mem->size]), contents, realsize);
-    mem->size += realsize;
+    *(size_t *)userp += realsize;
     return realsize;
 }
 
@@ -77,7 +59,7 @@ int get_ipv4_address(char *ipv4) {
             int s = getnameinfo(ifa->ifa_addr, sizeof(struct sockaddr_in),
                               host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
             if (s != 0) {
-                printf("getnameinfo() failed: %s\n", gai_strerror(s));
+                log_warn("getnameinfo_failed", "getnameinfo() failed: %s", gai_strerror(s));
                 continue;
             }
 
@@ -114,7 +96,7 @@ int get_ipv6_address(char *ipv6) {
             int s = getnameinfo(ifa->ifa_addr, sizeof(struct sockaddr_in6),
                               host, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
             if (s != 0) {
-                printf("getnameinfo() failed: %s\n", gai_strerror(s));
+                log_warn("getnameinfo_failed", "getnameinfo() failed: %s", gai_strerror(s));
                 continue;
             }
 
@@ -128,22 +110,15 @@ int get_ipv6_address(char *ipv6) {
     return found ? 0 : -1;
 }
 
-int get_gateway_address(char *gateway) {
-    FILE *fp = fopen("/proc/net/route", "r");
-    if (fp == NULL) {
-        strcpy(gateway, "N/A");
-        return -1;
-    }
-
+int parse_net_route(FILE *fp, char *gateway) {
     char line[256];
     if (fgets(line, sizeof(line), fp) == NULL) {
-        fclose(fp);
         strcpy(gateway, "N/A");
         return -1;
     }
 
     while (fgets(line, sizeof(line), fp)) {
-        char interface[32], dest[32], gw_str[32];
+        char interface[32], gw_str[32];
         unsigned int gw_addr, dest_addr;
         int flags, refcnt, use, metric;
 
@@ -156,18 +131,28 @@ int get_gateway_address(char *gateway) {
             gw_addr = strtoul(gw_str, NULL, 16);
             struct in_addr addr;
             addr.s_addr = gw_addr;
-            strcpy(gateway, inet_ntoa(addr));
-            fclose(fp);
-            fprintf(stderr, "Gateway found: %s (hex: %s)\n", gateway, gw_str);
+            inet_ntop(AF_INET, &addr, gateway, INET_ADDRSTRLEN);
+            log_debug("gateway_found", "Gateway found: %s (hex: %s)", gateway, gw_str);
             return 0;
         }
     }
 
-    fclose(fp);
     strcpy(gateway, "N/A");
     return -1;
 }
 
+int get_gateway_address(char *gateway) {
+    FILE *fp = fopen("/proc/net/route", "r");
+    if (fp == NULL) {
+        strcpy(gateway, "N/A");
+        return -1;
+    }
+
+    int result = parse_net_route(fp, gateway);
+    fclose(fp);
+    return result;
+}
+
 int get_dns_servers(char *dns1, char *dns2) {
     FILE *fp = fopen("/etc/resolv.conf", "r");
     if (fp == NULL) {
@@ -228,15 +213,381 @@ int get_current_ping(double *ping_ms) {
     return -1;
 }
 
+#define TRACEROUTE_BASE_PORT 33434
+#define TRACEROUTE_ROUND_TIMEOUT_MS 1000
+#define TRACEROUTE_INTERVAL_SEC 1
+
+typedef struct {
+    uint32_t round;
+    uint16_t ttl;
+} TracerouteProbe;
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 +
+           (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Sends one UDP probe per TTL from a single unprivileged socket and collects
+// the ICMP answers from the socket error queue (IP_RECVERR), so every hop is
+// probed in parallel. Returns the TTL at which the target answered, 0 if it
+// was not reached within max_ttl, or -1 on error.
+int traceroute_round(const char *target, double rtt_ms[], char addresses[][64], int max_ttl) {
+    static uint32_t round_counter = 0;
+    struct addrinfo hints, *res;
+
+    if (max_ttl > TRACEROUTE_MAX_HOPS)
+        max_ttl = TRACEROUTE_MAX_HOPS;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(target, NULL, &hints, &res) != 0)
+        return -1;
+
+    int family = res->ai_family;
+    struct sockaddr_storage dest;
+    socklen_t dest_len = res->ai_addrlen;
+    memcpy(&dest, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+
+    int sock = socket(family, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sock < 0) {
+        log_warn("traceroute_failed", "socket: %s", strerror(errno));
+        return -1;
+    }
+
+    int on = 1;
+    int level = family == AF_INET6 ? IPPROTO_IPV6 : IPPROTO_IP;
+    int recverr = family == AF_INET6 ? IPV6_RECVERR : IP_RECVERR;
+    int ttl_opt = family == AF_INET6 ? IPV6_UNICAST_HOPS : IP_TTL;
+    if (setsockopt(sock, level, recverr, &on, sizeof(on)) < 0) {
+        log_warn("traceroute_failed", "setsockopt IP_RECVERR: %s", strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    uint32_t round = __atomic_add_fetch(&round_counter, 1, __ATOMIC_RELAXED);
+    struct timespec sent_at[TRACEROUTE_MAX_HOPS];
+
+    for (int i = 0; i < max_ttl; i++) {
+        rtt_ms[i] = -1;
+        addresses[i][0] = '\0';
+    }
+
+    for (int ttl = 1; ttl <= max_ttl; ttl++) {
+        TracerouteProbe probe = { round, (uint16_t)ttl };
+        uint16_t port = htons(TRACEROUTE_BASE_PORT + ttl - 1);
+
+        if (family == AF_INET6)
+            ((struct sockaddr_in6 *)&dest)->sin6_port = port;
+        else
+            ((struct sockaddr_in *)&dest)->sin_port = port;
+
+        setsockopt(sock, level, ttl_opt, &ttl, sizeof(ttl));
+        clock_gettime(CLOCK_MONOTONIC, &sent_at[ttl - 1]);
+        sendto(sock, &probe, sizeof(probe), 0, (struct sockaddr *)&dest, dest_len);
+    }
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int dest_ttl = 0;
+
+    for (;;) {
+        int limit = dest_ttl ? dest_ttl : max_ttl;
+        int pending = 0;
+        for (int i = 0; i < limit; i++) {
+            if (rtt_ms[i] < 0)
+                pending++;
+        }
+        if (pending == 0)
+            break;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int wait = TRACEROUTE_ROUND_TIMEOUT_MS - (int)elapsed_ms(&start, &now);
+        if (wait <= 0)
+            break;
+
+        struct pollfd pfd = { sock, POLLERR, 0 };
+        if (poll(&pfd, 1, wait) <= 0)
+            break;
+
+        for (;;) {
+            TracerouteProbe probe;
+            char control[512];
+            struct sockaddr_storage from;
+            struct iovec iov = { &probe, sizeof(probe) };
+            struct msghdr msg;
+
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = &from;
+            msg.msg_namelen = sizeof(from);
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (recvmsg(sock, &msg, MSG_ERRQUEUE) < (ssize_t)sizeof(probe))
+                break;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+
+            if (probe.round != round || probe.ttl < 1 || probe.ttl > max_ttl)
+                continue;
+
+            for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+                if (cm->cmsg_level != level || cm->cmsg_type != recverr)
+                    continue;
+
+                struct sock_extended_err *ee = (struct sock_extended_err *)CMSG_DATA(cm);
+                int hop = probe.ttl - 1;
+                if (rtt_ms[hop] >= 0)
+                    break;
+
+                struct sockaddr *offender = SO_EE_OFFENDER(ee);
+                if (offender->sa_family == AF_INET6)
+                    inet_ntop(AF_INET6, &((struct sockaddr_in6 *)offender)->sin6_addr,
+                              addresses[hop], 64);
+                else if (offender->sa_family == AF_INET)
+                    inet_ntop(AF_INET, &((struct sockaddr_in *)offender)->sin_addr,
+                              addresses[hop], 64);
+
+                rtt_ms[hop] = elapsed_ms(&sent_at[hop], &now);
+
+                // Port unreachable means the probe arrived at the target itself
+                int reached = ee->ee_origin == SO_EE_ORIGIN_ICMP6
+                    ? (ee->ee_type == 1 && ee->ee_code == 4)
+                    : (ee->ee_origin == SO_EE_ORIGIN_ICMP && ee->ee_type == 3 && ee->ee_code == 3);
+                if (reached && (dest_ttl == 0 || probe.ttl < dest_ttl))
+                    dest_ttl = probe.ttl;
+                break;
+            }
+        }
+    }
+
+    close(sock);
+    return dest_ttl;
+}
+
+static pthread_mutex_t traceroute_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t traceroute_updated = PTHREAD_COND_INITIALIZER;
+static pthread_t traceroute_thread;
+static int traceroute_running = 0;
+static int traceroute_joinable = 0;  // A thread that has to be joined before the next starts
+static time_t traceroute_last_read = 0;
+static TracerouteReport traceroute_report;
+
+static void traceroute_merge_round(TracerouteReport *report, const double rtt_ms[],
+                                   char addresses[][64], int hop_count, int reached) {
+    report->hop_count = hop_count;
+    report->rounds++;
+    report->last_round = time(NULL);
+
+    for (int i = 0; i < hop_count; i++) {
+        TracerouteHop *hop = &report->hops[i];
+        hop->ttl = i + 1;
+        hop->sent++;
+        if (reached)
+            hop->is_destination = i == hop_count - 1;
+
+        if (rtt_ms[i] < 0)
+            continue;
+
+        strncpy(hop->address, addresses[i], sizeof(hop->address) - 1);
+        hop->received++;
+        hop->last_ms = rtt_ms[i];
+        if (hop->received == 1 || rtt_ms[i] < hop->best_ms)
+            hop->best_ms = rtt_ms[i];
+        if (rtt_ms[i] > hop->worst_ms)
+            hop->worst_ms = rtt_ms[i];
+
+        double delta = rtt_ms[i] - hop->avg_ms;
+        hop->avg_ms += delta / hop->received;
+        hop->m2 += delta * (rtt_ms[i] - hop->avg_ms);
+    }
+}
+
+static void *traceroute_loop(void *arg) {
+    (void)arg;
+    double rtt_ms[TRACEROUTE_MAX_HOPS];
+    char addresses[TRACEROUTE_MAX_HOPS][64];
+    char target[64];
+    int max_ttl = TRACEROUTE_MAX_HOPS;
+    int misses = 0;
+
+    pthread_mutex_lock(&traceroute_lock);
+    while (traceroute_running) {
+        strcpy(target, traceroute_report.target);
+        pthread_mutex_unlock(&traceroute_lock);
+
+        // Rounds start at a fixed cadence regardless of how long probing took
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += TRACEROUTE_INTERVAL_SEC;
+
+        int dest_ttl = traceroute_round(target, rtt_ms, addresses, max_ttl);
+
+        pthread_mutex_lock(&traceroute_lock);
+        if (strcmp(target, traceroute_report.target) != 0) {
+            // Target was switched while probing; start over with a full path
+            max_ttl = TRACEROUTE_MAX_HOPS;
+            misses = 0;
+            continue;
+        }
+
+        if (dest_ttl >= 0) {
+            traceroute_merge_round(&traceroute_report, rtt_ms, addresses,
+                                   dest_ttl > 0 ? dest_ttl : max_ttl, dest_ttl > 0);
+
+            // Once the path length is known, stop probing TTLs past the target,
+            // but widen again if it keeps going unanswered (route change)
+            if (dest_ttl > 0) {
+                max_ttl = dest_ttl;
+                misses = 0;
+            } else if (++misses >= 3) {
+                max_ttl = TRACEROUTE_MAX_HOPS;
+            }
+            pthread_cond_broadcast(&traceroute_updated);
+        }
+
+        // Nobody is looking at the results any more
+        if (time(NULL) - traceroute_last_read >= TRACEROUTE_IDLE_SEC) {
+            traceroute_running = 0;
+            pthread_cond_broadcast(&traceroute_updated);
+            break;
+        }
+
+        pthread_cond_timedwait(&traceroute_updated, &traceroute_lock, &deadline);
+    }
+    pthread_mutex_unlock(&traceroute_lock);
+    return NULL;
+}
+
+int start_traceroute(const char *target) {
+    pthread_mutex_lock(&traceroute_lock);
+    time_t now = time(NULL);
+
+    if (strcmp(traceroute_report.target, target) != 0) {
+        // Switching would wipe the statistics another client is reading
+        if (traceroute_running && now - traceroute_last_read < TRACEROUTE_IDLE_SEC) {
+            pthread_mutex_unlock(&traceroute_lock);
+            return TRACEROUTE_BUSY;
+        }
+        memset(&traceroute_report, 0, sizeof(traceroute_report));
+        strncpy(traceroute_report.target, target, sizeof(traceroute_report.target) - 1);
+        pthread_cond_broadcast(&traceroute_updated);
+    }
+    traceroute_last_read = now;
+
+    // The previous thread stopped itself after going idle; it has released
+    // the lock or is about to. Another caller may start a new thread while
+    // the lock is dropped, so join the handle read under the lock.
+    if (!traceroute_running && traceroute_joinable) {
+        pthread_t previous = traceroute_thread;
+        traceroute_joinable = 0;
+        pthread_mutex_unlock(&traceroute_lock);
+        pthread_join(previous, NULL);
+        pthread_mutex_lock(&traceroute_lock);
+    }
+
+    int result = 0;
+    if (!traceroute_running) {
+        traceroute_running = 1;
+        if (pthread_create(&traceroute_thread, NULL, traceroute_loop, NULL) != 0) {
+            traceroute_running = 0;
+            result = -1;
+        } else {
+            traceroute_joinable = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&traceroute_lock);
+    return result;
+}
+
+int get_traceroute_report(TracerouteReport *report, int wait_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += wait_ms / 1000;
+    deadline.tv_nsec += (wait_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&traceroute_lock);
+    // Give a freshly started trace the chance to complete its first round
+    while (traceroute_running && traceroute_report.rounds == 0) {
+        if (pthread_cond_timedwait(&traceroute_updated, &traceroute_lock, &deadline) != 0)
+            break;
+    }
+    memcpy(report, &traceroute_report, sizeof(*report));
+    traceroute_last_read = time(NULL);
+    int running = traceroute_running;
+    pthread_mutex_unlock(&traceroute_lock);
+
+    return running ? 0 : -1;
+}
+
+double traceroute_hop_stddev(const TracerouteHop *hop) {
+    return hop->received > 1 ? sqrt(hop->m2 / (hop->received - 1)) : 0.0;
+}
+
+void stop_traceroute() {
+    pthread_mutex_lock(&traceroute_lock);
+    int joinable = traceroute_joinable;
+    traceroute_running = 0;
+    traceroute_joinable = 0;
+    pthread_cond_broadcast(&traceroute_updated);
+    pthread_mutex_unlock(&traceroute_lock);
+
+    if (joinable)
+        pthread_join(traceroute_thread, NULL);
+}
+
+static SpeedTestProgressFn speed_test_progress = NULL;
+
+void set_speed_test_progress_callback(SpeedTestProgressFn fn) {
+    speed_test_progress = fn;
+}
+
+static void report_speed_test_progress(const char *phase, double percent, double mbps) {
+    SpeedTestProgressFn fn = speed_test_progress;
+    if (fn)
+        fn(phase, percent, mbps);
+}
+
+// The download covers 10-90% of the overall progress; updates are throttled
+// to one every SPEED_TEST_PROGRESS_INTERVAL_MS
+#define SPEED_TEST_PROGRESS_INTERVAL_MS 200
+
+typedef struct {
+    struct timespec start;
+    struct timespec last_report;
+} DownloadProgress;
+
+static int download_progress_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow,
+                                      curl_off_t ultotal, curl_off_t ulnow) {
+    (void)ultotal;
+    (void)ulnow;
+    DownloadProgress *progress = (DownloadProgress *)clientp;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (dltotal <= 0 || elapsed_ms(&progress->last_report, &now) < SPEED_TEST_PROGRESS_INTERVAL_MS)
+        return 0;
+    progress->last_report = now;
+
+    double seconds = elapsed_ms(&progress->start, &now) / 1000.0;
+    double mbps = seconds > 0 ? (dlnow / seconds) / 1000000.0 * 8.0 : 0.0;
+    report_speed_test_progress("download", 10.0 + 80.0 * dlnow / dltotal, mbps);
+    return 0;
+}
+
 double measure_download_speed() {
     // Perform actual speed test using multiple file sizes for better accuracy
     CURL *curl = curl_easy_init();
     if (!curl) return 0.0;
 
-    DownloadData download = {0};
-    download.capacity = 10 * 1024 * 1024;  // Start with 10MB
-    download.data = (char *)malloc(download.capacity);
-    if (!download.data) return 0.0;
+    size_t downloaded = 0;
 
     struct timespec start, end;
 
@@ -251,36 +602,39 @@ double measure_download_speed() {
     double speed = 0.0;
 
     for (int i = 0; i < url_count && speed == 0.0; i++) {
-        // Reset download buffer
-        download.size = 0;
-        memset(download.data, 0, download.capacity);
+        downloaded = 0;
         
         curl_easy_setopt(curl, CURLOPT_URL, urls[i]);
         curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
         curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, speed_test_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&download);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&downloaded);
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
         curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
         curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
-        
+
+        DownloadProgress progress;
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, download_progress_callback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void *)&progress);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+
         clock_gettime(CLOCK_MONOTONIC, &start);
+        progress.start = progress.last_report = start;
         CURLcode res = curl_easy_perform(curl);
         clock_gettime(CLOCK_MONOTONIC, &end);
 
         double elapsed_seconds = (end.tv_sec - start.tv_sec) +
                                 (end.tv_nsec - start.tv_nsec) / 1e9;
 
-        if (res == CURLE_OK && download.size > 100000 && elapsed_seconds > 0.1) {
+        if (res == CURLE_OK && downloaded > 100000 && elapsed_seconds > 0.1) {
             // Calculate speed: (bytes / seconds) / 1,000,000 * 8 for Mbps
-            speed = (download.size / elapsed_seconds) / 1000000.0 * 8.0;
-            fprintf(stderr, "Speed test: %.1f Mbps (%.0f bytes in %.2f seconds)\n", 
-                    speed, (double)download.size, elapsed_seconds);
+            speed = (downloaded / elapsed_seconds) / 1000000.0 * 8.0;
+            log_info("speed_test", "Speed test: %.1f Mbps (%.0f bytes in %.2f seconds)",
+                     speed, (double)downloaded, elapsed_seconds);
         }
     }
 
-    free(download.data);
     curl_easy_cleanup(curl);
     return speed;
 }
@@ -296,160 +650,150 @@ int perform_speed_test(SpeedTestResult *result) {
     result->test_time = time(NULL);
 
     // Get ping
+    report_speed_test_progress("ping", 0.0, 0.0);
     get_current_ping(&result->ping_ms);
 
     // Get download speed
+    report_speed_test_progress("download", 10.0, 0.0);
     result->download_mbps = measure_download_speed();
     if (result->download_mbps == 0)
         result->download_mbps = 50 + (rand() % 100); // Fallback
 
     // Get upload speed
+    report_speed_test_progress("upload", 90.0, result->download_mbps);
     result->upload_mbps = measure_upload_speed();
 
     result->is_testing = 0;
     return 0;
 }
 
-int get_isp_info(ISPInfo *info) {
-    // Initialize info structure with defaults
-    memset(info, 0, sizeof(ISPInfo));
-    
-    // Get ISP name from system
+static ISPInfo isp_snapshot;
+static pthread_once_t isp_snapshot_once = PTHREAD_ONCE_INIT;
+
+static void build_isp_snapshot(void) {
+    ISPInfo *info = &isp_snapshot;
     strcpy(info->isp_name, "Local Network");
-    
-    // Get timezone from system
-    char timezone_str[128] = "UTC";
-    FILE *tzfp = popen("cat /etc/timezone 2>/dev/null", "r");
-    if (tzfp != NULL) {
-        char buffer[128];
-        if (fgets(buffer, sizeof(buffer), tzfp) != NULL) {
-            char *newline = strchr(buffer, '\n');
-            if (newline) *newline = '\0';
-            if (strlen(buffer) > 0) {
-                strncpy(timezone_str, buffer, sizeof(timezone_str) - 1);
-                strncpy(info->timezone, buffer, sizeof(info->timezone) - 1);
-            } else {
-                strcpy(info->timezone, "UTC");
-            }
-        } else {
-            strcpy(info->timezone, "UTC");
-        }
-        pclose(tzfp);
-    } else {
-        strcpy(info->timezone, "UTC");
-    }
-    
-    // Detect country from timezone
     strcpy(info->country, "Unknown");
     strcpy(info->city, "Unknown");
     strcpy(info->latitude, "N/A");
     strcpy(info->longitude, "N/A");
-    
-    // Map timezone to country and city
-    if (strstr(timezone_str, "Asia/Kolkata") || strstr(timezone_str, "Asia/Calcutta")) {
-        strcpy(info->country, "India");
-        strcpy(info->city, "Kolkata");
-    } else if (strstr(timezone_str, "America/New_York") || strstr(timezone_str, "US/Eastern")) {
-        strcpy(info->country, "United States");
-        strcpy(info->city, "New York");
-    } else if (strstr(timezone_str, "America/Los_Angeles") || strstr(timezone_str, "US/Pacific")) {
-        strcpy(info->country, "United States");
-        strcpy(info->city, "Los Angeles");
-    } else if (strstr(timezone_str, "America/Chicago") || strstr(timezone_str, "US/Central")) {
-        strcpy(info->country, "United States");
-        strcpy(info->city, "Chicago");
-    } else if (strstr(timezone_str, "Europe/London") || strstr(timezone_str, "Europe/Belfast")) {
-        strcpy(info->country, "United Kingdom");
-        strcpy(info->city, "London");
-    } else if (strstr(timezone_str, "Europe/Berlin")) {
-        strcpy(info->country, "Germany");
-        strcpy(info->city, "Berlin");
-    } else if (strstr(timezone_str, "Europe/Paris")) {
-        strcpy(info->country, "France");
-        strcpy(info->city, "Paris");
-    } else if (strstr(timezone_str, "Asia/Tokyo")) {
-        strcpy(info->country, "Japan");
-        strcpy(info->city, "Tokyo");
-    } else if (strstr(timezone_str, "Australia/Sydney")) {
-        strcpy(info->country, "Australia");
-        strcpy(info->city, "Sydney");
-    } else if (strstr(timezone_str, "Asia/Shanghai") || strstr(timezone_str, "Asia/Hong_Kong")) {
-        strcpy(info->country, "China");
-        strcpy(info->city, "Shanghai");
-    } else if (strstr(timezone_str, "UTC") || strstr(timezone_str, "GMT")) {
-        strcpy(info->country, "United Kingdom");
-        strcpy(info->city, "London");
-    }
-
-    fprintf(stderr, "ISP Info: %s, %s, %s, Timezone: %s\n", 
-            info->isp_name, info->country, info->city, info->timezone);
-    return 0;
-}
+    tz_system_zone(info->timezone, sizeof(info->timezone));
+
+    // The index is only needed for this one lookup; the zone cannot change
+    // under a running process, so neither can the answer
+    TzIndex index;
+    if (tz_index_open(&index, TZDB_DEFAULT_DIR) < 0) {
+        log_warn("tzdb_unavailable", "Cannot read %s, location unknown", TZDB_DEFAULT_DIR);
+        return;
+    }
 
-int get_interface_stats(InterfaceStats *stats) {
-    FILE *fp = fopen("/proc/net/dev", "r");
-    if (fp == NULL) {
-        strcpy(stats->interface_name, "Unknown");
-        strcpy(stats->bytes_sent, "0");
-        strcpy(stats->bytes_recv, "0");
-        return -1;
+    TzLocation location;
+    if (tz_lookup(&index, info->timezone, &location) == 0) {
+        snprintf(info->country, sizeof(info->country), "%s",
+                 location.country ? location.country : location.country_code);
+
+        // The zone's principal city: "America/Argentina/Buenos_Aires" -> "Buenos Aires"
+        const char *city = strrchr(location.zone, '/');
+        snprintf(info->city, sizeof(info->city), "%s", city ? city + 1 : location.zone);
+        for (char *c = info->city; *c; c++) {
+            if (*c == '_')
+                *c = ' ';
+        }
+
+        snprintf(info->latitude, sizeof(info->latitude), "%.4f", location.latitude);
+        snprintf(info->longitude, sizeof(info->longitude), "%.4f", location.longitude);
     }
+    tz_index_free(&index);
+
+    log_debug("isp_info", "ISP Info: %s, %s, %s, Timezone: %s",
+              info->isp_name, info->country, info->city, info->timezone);
+}
+
+void load_isp_info() {
+    pthread_once(&isp_snapshot_once, build_isp_snapshot);
+}
+
+int get_isp_info(ISPInfo *info) {
+    load_isp_info();
+    *info = isp_snapshot;
+    return 0;
+}
 
+int parse_net_dev_counters(FILE *fp, InterfaceCounters counters[], int max) {
     char line[256];
     // Skip header lines
     if (fgets(line, sizeof(line), fp) == NULL) {
-        fclose(fp);
         return -1;
     }
     if (fgets(line, sizeof(line), fp) == NULL) {
-        fclose(fp);
         return -1;
     }
 
-    unsigned long max_sent = 0, max_recv = 0;
-    char best_interface[32] = "Unknown";
-    int found = 0;
+    int count = 0;
+    while (count < max && fgets(line, sizeof(line), fp)) {
+        // Format: "  iface: rx_bytes rx_packets (6 more rx fields) tx_bytes ..."
+        // The name and the first counter are not always separated by a space
+        char *colon = strchr(line, ':');
+        if (!colon)
+            continue;
+        *colon = '\0';
 
-    while (fgets(line, sizeof(line), fp)) {
-        char interface[32] = {0};
-        unsigned long bytes_recv = 0, packets_recv = 0, err_recv = 0, drop_recv = 0;
-        unsigned long bytes_sent = 0, packets_sent = 0, err_sent = 0, drop_sent = 0;
-
-        // Parse the line - format: "iface:bytes_recv packets_recv ... bytes_sent packets_sent ..."
-        int n = sscanf(line, "%31s %lu %lu %lu %lu %lu %lu %lu %lu",
-                       interface, &bytes_recv, &packets_recv, &err_recv, &drop_recv,
-                       &bytes_sent, &packets_sent, &err_sent, &drop_sent);
-
-        if (n >= 9) {
-            // Remove colon from interface name if present
-            char *colon = strchr(interface, ':');
-            if (colon) *colon = '\0';
-
-            // Skip loopback and other virtual interfaces
-            if (strcmp(interface, "lo") == 0 || strstr(interface, "docker") || strstr(interface, "veth")) {
-                continue;
-            }
+        char *name = line;
+        while (*name == ' ')
+            name++;
 
-            // Track the interface with most activity
-            unsigned long total = bytes_recv + bytes_sent;
-            if (total > (max_recv + max_sent)) {
-                strcpy(best_interface, interface);
-                max_sent = bytes_sent;
-                max_recv = bytes_recv;
-                found = 1;
-            }
-        }
+        InterfaceCounters *entry = &counters[count];
+        unsigned long long bytes_recv, bytes_sent;
+        if (sscanf(colon + 1, "%llu %*u %*u %*u %*u %*u %*u %*u %llu",
+                   &bytes_recv, &bytes_sent) != 2)
+            continue;
+
+        snprintf(entry->name, sizeof(entry->name), "%.*s", (int)sizeof(entry->name) - 1, name);
+        entry->bytes_recv = bytes_recv;
+        entry->bytes_sent = bytes_sent;
+        count++;
     }
+    return count;
+}
+
+int get_interface_counters(InterfaceCounters counters[], int max) {
+    FILE *fp = fopen("/proc/net/dev", "r");
+    if (fp == NULL)
+        return -1;
 
+    int count = parse_net_dev_counters(fp, counters, max);
     fclose(fp);
+    return count;
+}
+
+int parse_net_dev(FILE *fp, InterfaceStats *stats) {
+    InterfaceCounters counters[MAX_INTERFACES];
+    int count = parse_net_dev_counters(fp, counters, MAX_INTERFACES);
+    const InterfaceCounters *best = NULL;
+
+    for (int i = 0; i < count; i++) {
+        const InterfaceCounters *entry = &counters[i];
+
+        // Skip loopback and other virtual interfaces
+        if (strcmp(entry->name, "lo") == 0 || strstr(entry->name, "docker") ||
+            strstr(entry->name, "veth")) {
+            continue;
+        }
+
+        // Track the interface with most activity
+        if (!best || entry->bytes_recv + entry->bytes_sent > best->bytes_recv + best->bytes_sent)
+            best = entry;
+    }
 
     // Format the output
-    if (found) {
-        strcpy(stats->interface_name, best_interface);
-        sprintf(stats->bytes_sent, "%lu", max_sent);
-        sprintf(stats->bytes_recv, "%lu", max_recv);
-        fprintf(stderr, "Interface stats: %s - sent=%lu, recv=%lu\n", 
-                best_interface, max_sent, max_recv);
+    if (best && best->bytes_recv + best->bytes_sent > 0) {
+        snprintf(stats->interface_name, sizeof(stats->interface_name), "%s", best->name);
+        snprintf(stats->bytes_sent, sizeof(stats->bytes_sent), "%llu",
+                 (unsigned long long)best->bytes_sent);
+        snprintf(stats->bytes_recv, sizeof(stats->bytes_recv), "%llu",
+                 (unsigned long long)best->bytes_recv);
+        log_debug("interface_stats", "Interface stats: %s - sent=%s, recv=%s",
+                  stats->interface_name, stats->bytes_sent, stats->bytes_recv);
         return 0;
     }
 
@@ -459,47 +803,63 @@ int get_interface_stats(InterfaceStats *stats) {
     return -1;
 }
 
-int get_wifi_interface_name(char *interface) {
-    FILE *fp = popen("iwconfig 2>/dev/null | grep ESSID | head -1 | awk '{print $1}'", "r");
+int get_interface_stats(InterfaceStats *stats) {
+    FILE *fp = fopen("/proc/net/dev", "r");
     if (fp == NULL) {
-        strcpy(interface, "wlan0");
+        strcpy(stats->interface_name, "Unknown");
+        strcpy(stats->bytes_sent, "0");
+        strcpy(stats->bytes_recv, "0");
         return -1;
     }
 
-    if (fgets(interface, 64, fp) != NULL) {
-        // Remove newline
-        char *newline = strchr(interface, '\n');
-        if (newline) *newline = '\0';
-        pclose(fp);
-        return strlen(interface) > 0 ? 0 : -1;
+    int result = parse_net_dev(fp, stats);
+    fclose(fp);
+    return result;
+}
+
+// The first client-mode wireless interface, else the first one of any mode
+int get_wifi_interface_name(char *interface) {
+    WirelessSnapshot snapshot;
+    if (wireless_get_snapshot(&snapshot) < 0 || snapshot.interface_count == 0) {
+        strcpy(interface, "wlan0");
+        return -1;
     }
 
-    pclose(fp);
-    strcpy(interface, "wlan0");
-    return -1;
+    const WirelessInterface *found = &snapshot.interfaces[0];
+    for (int i = 0; i < snapshot.interface_count; i++) {
+        if (snapshot.interfaces[i].iftype == NL80211_IFTYPE_STATION) {
+            found = &snapshot.interfaces[i];
+            break;
+        }
+    }
+    snprintf(interface, 64, "%s", found->name);
+    return 0;
 }
 
+// Signal of the first station (the access point) seen on interface, in dBm
 int get_wifi_signal_strength(const char *interface, int *strength) {
-    char command[256];
-    sprintf(command, "iwconfig %s 2>/dev/null | grep -i signal | awk '{print $NF}' | tr -d 'dBm'", interface);
-
-    FILE *fp = popen(command, "r");
-    if (fp == NULL) {
+    WirelessSnapshot snapshot;
+    if (wireless_get_snapshot(&snapshot) < 0) {
         *strength = 0;
         return -1;
     }
 
-    char buffer[32];
-    if (fgets(buffer, sizeof(buffer), fp) != NULL) {
-        *strength = atoi(buffer);
-        pclose(fp);
-        return 0;
+    for (int i = 0; i < snapshot.interface_count; i++) {
+        if (strcmp(snapshot.interfaces[i].name, interface) != 0)
+            continue;
+        for (int j = 0; j < snapshot.station_count; j++) {
+            const WirelessStation *station = &snapshot.stations[j];
+            if (station->ifindex == snapshot.interfaces[i].ifindex &&
+                (station->present & WIRELESS_HAS_SIGNAL)) {
+                *strength = station->signal_dbm;
+                return 0;
+            }
+        }
     }
-
-    pclose(fp);
     return -1;
 }
 
 void cleanup_network() {
+    stop_traceroute();
     curl_global_cleanup();
 }
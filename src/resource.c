@@ -0,0 +1,270 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "../include/resource.h"
+#include "../include/log.h"
+
+typedef struct {
+    ResourceBuildFn build;
+    unsigned ttl_ms;
+    int refreshing;
+    uint64_t refreshed_at_us;  // 0 until the first build
+    uint64_t version;
+    size_t lengths[ENCODING_COUNT];
+    char bodies[ENCODING_COUNT][RESOURCE_BODY_MAX];
+} Resource;
+
+static Resource resources[RESOURCE_COUNT];
+static pthread_mutex_t resource_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resource_rebuilt = PTHREAD_COND_INITIALIZER;
+
+// Distinguishes ETags of this process from those of an earlier run, whose
+// version counters started over
+static uint32_t boot_id;
+static pthread_once_t boot_id_once = PTHREAD_ONCE_INIT;
+
+static void init_boot_id() {
+    boot_id = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16);
+}
+
+static uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void resource_register(ResourceId id, unsigned ttl_ms, ResourceBuildFn build) {
+    pthread_once(&boot_id_once, init_boot_id);
+    pthread_mutex_lock(&resource_lock);
+    resources[id].build = build;
+    resources[id].ttl_ms = ttl_ms;
+    pthread_mutex_unlock(&resource_lock);
+}
+
+static int is_stale(const Resource *resource, uint64_t now) {
+    return resource->refreshed_at_us == 0 ||
+           now - resource->refreshed_at_us >= resource->ttl_ms * 1000ULL;
+}
+
+// Runs outside the lock; the caller has set refreshing for this resource
+static void *rebuild_resource(void *arg) {
+    Resource *resource = &resources[(intptr_t)arg];
+    char bodies[ENCODING_COUNT][RESOURCE_BODY_MAX];
+    Emitter out;
+
+    // One collection pass feeds every encoding
+    emitter_init(&out, ENCODING_JSON, bodies[ENCODING_JSON], sizeof(bodies[ENCODING_JSON]));
+    for (int e = ENCODING_JSON + 1; e < ENCODING_COUNT; e++)
+        emitter_add(&out, e, bodies[e], sizeof(bodies[e]));
+    resource->build(&out);
+    int ok = emitter_finish(&out) == 0;
+    if (!ok)
+        log_warn("resource_build_failed", "resource=%d reason=too_large", (int)(intptr_t)arg);
+
+    size_t lengths[ENCODING_COUNT];
+    int changed = 0;
+    for (int e = 0; e < ENCODING_COUNT; e++)
+        emitter_data(&out, e, &lengths[e]);
+
+    pthread_mutex_lock(&resource_lock);
+    for (int e = 0; ok && e < ENCODING_COUNT && !changed; e++) {
+        changed = lengths[e] != resource->lengths[e] ||
+                  memcmp(bodies[e], resource->bodies[e], lengths[e]) != 0;
+    }
+    if (changed) {
+        for (int e = 0; e < ENCODING_COUNT; e++) {
+            memcpy(resource->bodies[e], bodies[e], lengths[e]);
+            resource->lengths[e] = lengths[e];
+        }
+        resource->version++;
+    }
+    resource->refreshed_at_us = monotonic_us();
+    resource->refreshing = 0;
+    pthread_cond_broadcast(&resource_rebuilt);
+    pthread_mutex_unlock(&resource_lock);
+    return NULL;
+}
+
+// Rebuilds every resource in mask; all but the last on their own threads
+static void rebuild_resources(unsigned mask) {
+    pthread_t threads[RESOURCE_COUNT];
+    int spawned[RESOURCE_COUNT] = { 0 };
+    int last = -1;
+
+    for (int id = 0; id < RESOURCE_COUNT; id++) {
+        if (mask & RESOURCE_MASK(id))
+            last = id;
+    }
+    for (int id = 0; id < last; id++) {
+        if (!(mask & RESOURCE_MASK(id)))
+            continue;
+        if (pthread_create(&threads[id], NULL, rebuild_resource, (void *)(intptr_t)id) == 0)
+            spawned[id] = 1;
+        else
+            rebuild_resource((void *)(intptr_t)id);
+    }
+    if (last >= 0)
+        rebuild_resource((void *)(intptr_t)last);
+    for (int id = 0; id < last; id++) {
+        if (spawned[id])
+            pthread_join(threads[id], NULL);
+    }
+}
+
+static void wait_until(uint64_t wake_us) {
+    uint64_t now = monotonic_us();
+    if (wake_us <= now)
+        return;
+
+    // Condition variables time out against CLOCK_REALTIME
+    uint64_t delta = wake_us - now;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += delta / 1000000;
+    deadline.tv_nsec += (delta % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&resource_rebuilt, &resource_lock, &deadline);
+}
+
+int resource_wait(unsigned mask, Encoding encoding, const uint64_t known[RESOURCE_COUNT],
+                  unsigned timeout_ms, ResourceSnapshot out[RESOURCE_COUNT]) {
+    uint64_t deadline = monotonic_us() + (uint64_t)timeout_ms * 1000;
+    int changed = 0;
+
+    pthread_mutex_lock(&resource_lock);
+    for (;;) {
+        uint64_t now = monotonic_us();
+        unsigned claimed = 0;
+        int busy = 0;
+
+        // Claim stale resources nobody is rebuilding yet; wait for the rest
+        for (int id = 0; id < RESOURCE_COUNT; id++) {
+            Resource *resource = &resources[id];
+            if (!(mask & RESOURCE_MASK(id)) || !resource->build)
+                continue;
+            if (resource->refreshing) {
+                busy = 1;
+            } else if (is_stale(resource, now)) {
+                resource->refreshing = 1;
+                claimed |= RESOURCE_MASK(id);
+            }
+        }
+        if (claimed) {
+            pthread_mutex_unlock(&resource_lock);
+            rebuild_resources(claimed);
+            pthread_mutex_lock(&resource_lock);
+            continue;
+        }
+        if (busy) {
+            pthread_cond_wait(&resource_rebuilt, &resource_lock);
+            continue;
+        }
+
+        changed = known == NULL;
+        for (int id = 0; id < RESOURCE_COUNT && !changed; id++) {
+            if ((mask & RESOURCE_MASK(id)) && resources[id].version != known[id])
+                changed = 1;
+        }
+        if (changed || now >= deadline)
+            break;
+
+        // Sleep until the deadline or until the first resource goes stale
+        uint64_t wake = deadline;
+        for (int id = 0; id < RESOURCE_COUNT; id++) {
+            if (!(mask & RESOURCE_MASK(id)) || !resources[id].build)
+                continue;
+            uint64_t expires = resources[id].refreshed_at_us + resources[id].ttl_ms * 1000ULL;
+            if (expires < wake)
+                wake = expires;
+        }
+        wait_until(wake);
+    }
+
+    for (int id = 0; id < RESOURCE_COUNT; id++) {
+        if (!(mask & RESOURCE_MASK(id)))
+            continue;
+        out[id].length = resources[id].lengths[encoding];
+        out[id].version = resources[id].version;
+        memcpy(out[id].body, resources[id].bodies[encoding], out[id].length);
+    }
+    pthread_mutex_unlock(&resource_lock);
+    return changed;
+}
+
+int resource_fresh(unsigned mask, unsigned margin_ms) {
+    uint64_t now = monotonic_us() + (uint64_t)margin_ms * 1000;
+    int fresh = 1;
+
+    pthread_mutex_lock(&resource_lock);
+    for (int id = 0; id < RESOURCE_COUNT && fresh; id++) {
+        const Resource *resource = &resources[id];
+        if ((mask & RESOURCE_MASK(id)) && resource->build)
+            fresh = !resource->refreshing && !is_stale(resource, now);
+    }
+    pthread_mutex_unlock(&resource_lock);
+    return fresh;
+}
+
+void resource_format_etag(unsigned mask, Encoding encoding,
+                          const ResourceSnapshot snapshots[RESOURCE_COUNT],
+                          char *out, size_t size) {
+    pthread_once(&boot_id_once, init_boot_id);
+    size_t length = snprintf(out, size, "\"%08x", boot_id);
+    char separator = '-';
+
+    for (int id = 0; id < RESOURCE_COUNT && length < size; id++) {
+        if (!(mask & RESOURCE_MASK(id)))
+            continue;
+        length += snprintf(out + length, size - length, "%c%" PRIu64,
+                           separator, snapshots[id].version);
+        separator = '.';
+    }
+    if (length < size && encoding != ENCODING_JSON)
+        length += snprintf(out + length, size - length, "+%s", encoding_name(encoding));
+    if (length < size)
+        snprintf(out + length, size - length, "\"");
+}
+
+int resource_parse_etag(const char *etag, unsigned mask, Encoding encoding,
+                        uint64_t known[RESOURCE_COUNT]) {
+    pthread_once(&boot_id_once, init_boot_id);
+    if (strncmp(etag, "W/", 2) == 0)
+        etag += 2;
+    if (*etag++ != '"')
+        return -1;
+
+    char *end;
+    unsigned long boot = strtoul(etag, &end, 16);
+    if (end == etag || boot != boot_id || *end != '-')
+        return -1;
+    etag = end;
+
+    for (int id = 0; id < RESOURCE_COUNT; id++) {
+        if (!(mask & RESOURCE_MASK(id)))
+            continue;
+        if (*etag != '-' && *etag != '.')
+            return -1;
+        etag++;
+        known[id] = strtoull(etag, &end, 10);
+        if (end == etag)
+            return -1;
+        etag = end;
+    }
+    if (encoding != ENCODING_JSON) {
+        const char *name = encoding_name(encoding);
+        if (*etag++ != '+' || strncmp(etag, name, strlen(name)) != 0)
+            return -1;
+        etag += strlen(name);
+    }
+    return *etag == '"' ? 0 : -1;
+}
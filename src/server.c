@@ -5,16 +5,115 @@
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <ctype.h>
+#include <strings.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <signal.h>
 #include <time.h>
+#include <errno.h>
 #include "../include/server.h"
 #include "../include/network.h"
-#include "../include/json.h"
+#include "../include/emit.h"
+#include "../include/documents.h"
+#include "../include/metrics.h"
+#include "../include/log.h"
+#include "../include/events.h"
+#include "../include/resource.h"
+#include "../include/history.h"
+#include "../include/shm_export.h"
+#include "../include/fleet.h"
+#include "../include/wireless.h"
+#include "../include/sockstat.h"
+#include "../include/assets.h"
+#include "../include/uring.h"
 
 static int server_socket = -1;
 static int running = 0;
+static IoBackend io_backend = IO_BACKEND_PORTABLE;
+
+static const char *io_backend_names[] = {
+    [IO_BACKEND_PORTABLE] = "portable",
+    [IO_BACKEND_URING] = "io_uring",
+};
+
+// Status of the last response sent by this thread, for request accounting
+static __thread int response_status = 0;
+
+// When set, the UI is served from this directory instead of the embedded copy
+static const char *web_root = NULL;
+
+static int get_query_param(const char *query, const char *name, char *out, size_t out_size);
+
+static Lane lanes[LANE_COUNT];
+static int lanes_running = 0;
+static struct {
+    const char *name;
+    int workers;
+    size_t queue;
+} lane_config[LANE_COUNT] = {
+    [LANE_FAST] = { "fast", LANE_FAST_WORKERS, LANE_FAST_QUEUE },
+    [LANE_WAIT] = { "wait", LANE_WAIT_WORKERS, LANE_WAIT_QUEUE },
+    [LANE_SLOW] = { "slow", LANE_SLOW_WORKERS, LANE_SLOW_QUEUE },
+};
+// Connections come from a pool sized for every lane's workers and queue,
+// so a request never allocates its connection state
+static ClientConnection *connection_slots = NULL;
+static ClientConnection *free_connections = NULL;
+static pthread_mutex_t connection_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Set while the io_uring loop handles a request: responses are described
+// here for it to send instead of being written to the socket
+static __thread ResponseCapture *response_capture = NULL;
+
+// Variable-size response memory for the request a worker is handling
+static __thread Arena request_arena;
+static __thread int request_arena_ready = 0;
+
+static double slow_rate_per_minute = SLOW_RATE_PER_MINUTE;
+static double slow_rate_burst = SLOW_RATE_BURST;
+static RateLimiter slow_rate;
+
+static const struct {
+    const char *path;
+    RouteId route;
+} route_table[] = {
+    { "/", ROUTE_INDEX },
+    { "/api/network-info", ROUTE_NETWORK_INFO },
+    { "/api/speed-test", ROUTE_SPEED_TEST },
+    { "/api/isp-info", ROUTE_ISP_INFO },
+    { "/api/interface-stats", ROUTE_INTERFACE_STATS },
+    { "/api/socket-stats", ROUTE_SOCKET_STATS },
+    { "/api/traceroute", ROUTE_TRACEROUTE },
+    { "/api/all", ROUTE_ALL },
+    { "/api/events", ROUTE_EVENTS },
+    { "/api/history", ROUTE_HISTORY },
+    { "/api/fleet", ROUTE_FLEET },
+    { "/api/wireless", ROUTE_WIRELESS },
+    { "/metrics", ROUTE_METRICS },
+};
+
+static const char *route_names[ROUTE_COUNT] = {
+    [ROUTE_INDEX] = "/",
+    [ROUTE_NETWORK_INFO] = "/api/network-info",
+    [ROUTE_SPEED_TEST] = "/api/speed-test",
+    [ROUTE_ISP_INFO] = "/api/isp-info",
+    [ROUTE_INTERFACE_STATS] = "/api/interface-stats",
+    [ROUTE_SOCKET_STATS] = "/api/socket-stats",
+    [ROUTE_TRACEROUTE] = "/api/traceroute",
+    [ROUTE_ALL] = "/api/all",
+    [ROUTE_EVENTS] = "/api/events",
+    [ROUTE_HISTORY] = "/api/history",
+    [ROUTE_FLEET] = "/api/fleet",
+    [ROUTE_WIRELESS] = "/api/wireless",
+    [ROUTE_METRICS] = "/metrics",
+    [ROUTE_STATIC] = "static",
+    [ROUTE_PREFLIGHT] = "preflight",
+    [ROUTE_NOT_FOUND] = "not_found",
+};
 
 void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
@@ -51,11 +150,85 @@ int start_server(int port) {
         return -1;
     }
 
-    printf("Server listening on port %d\n", port);
+    log_info("server_listening", "Server listening on port %d", port);
     running = 1;
     return 0;
 }
 
+RouteId resolve_route(const char *method, const char *path) {
+    if (strcmp(method, "OPTIONS") == 0)
+        return ROUTE_PREFLIGHT;
+    if (strcmp(method, "GET") != 0)
+        return ROUTE_NOT_FOUND;
+
+    for (size_t i = 0; i < sizeof(route_table) / sizeof(route_table[0]); i++) {
+        if (strcmp(path, route_table[i].path) == 0)
+            return route_table[i].route;
+    }
+    if (strncmp(path, "/static/", 8) == 0)
+        return ROUTE_STATIC;
+    return ROUTE_NOT_FOUND;
+}
+
+const char* route_name(RouteId route) {
+    return route < ROUTE_COUNT ? route_names[route] : "unknown";
+}
+
+LaneId route_lane(RouteId route, const char *query) {
+    char wait[32];
+    switch (route) {
+        case ROUTE_SPEED_TEST:
+        case ROUTE_TRACEROUTE:
+            return LANE_SLOW;
+        case ROUTE_NETWORK_INFO:
+        case ROUTE_ISP_INFO:
+        case ROUTE_INTERFACE_STATS:
+        case ROUTE_SOCKET_STATS:
+        case ROUTE_ALL:
+            return get_query_param(query, "wait", wait, sizeof(wait)) == 0 ? LANE_WAIT : LANE_FAST;
+        default:
+            return LANE_FAST;
+    }
+}
+
+const char* lane_name(LaneId lane) {
+    return lane < LANE_COUNT ? lane_config[lane].name : "unknown";
+}
+
+void server_set_io_backend(IoBackend backend) {
+    io_backend = backend;
+}
+
+int io_backend_parse(const char *name, IoBackend *backend) {
+    for (size_t i = 0; i < sizeof(io_backend_names) / sizeof(io_backend_names[0]); i++) {
+        if (strcmp(name, io_backend_names[i]) == 0) {
+            *backend = (IoBackend)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int server_configure_lane(LaneId lane, int workers, size_t queue) {
+    if (lane >= LANE_COUNT || workers < 1 || queue < 1)
+        return -1;
+    lane_config[lane].workers = workers;
+    lane_config[lane].queue = queue;
+    return 0;
+}
+
+void server_set_slow_rate(double slow_per_minute, double burst) {
+    slow_rate_per_minute = slow_per_minute;
+    slow_rate_burst = burst;
+}
+
+int server_lane_stats(LaneId lane, LaneStats *stats) {
+    if (!lanes_running || lane >= LANE_COUNT)
+        return -1;
+    lane_get_stats(&lanes[lane], stats);
+    return 0;
+}
+
 int stop_server() {
     running = 0;
     if (server_socket >= 0) {
@@ -65,29 +238,113 @@ int stop_server() {
     return 0;
 }
 
-void send_response(int client_fd, int status_code, const char *content_type, const char *body) {
-    char response[8192];
+void server_capture_responses(ResponseCapture *capture) {
+    if (capture)
+        capture->iov_count = 0;
+    response_capture = capture;
+}
+
+// Writes one complete response, or hands it to the thread's capture.
+// Persistent data (the embedded assets) is referenced instead of copied;
+// anything else is copied into the capture buffer, or into its overflow
+// arena when it does not fit. A capturing thread never writes itself.
+static void write_response(int client_fd, const struct iovec *iov, int count, int persistent) {
+    ResponseCapture *capture = response_capture;
+    if (capture == NULL) {
+        writev(client_fd, iov, count);
+        return;
+    }
+
+    // Handlers send one response; a second one has nowhere to go
+    if (capture->iov_count != 0 || count > RESPONSE_CAPTURE_PARTS) {
+        log_warn("response_dropped", "Cannot capture a second or %d-part response", count);
+        return;
+    }
+    if (persistent) {
+        memcpy(capture->iov, iov, count * sizeof(*iov));
+        capture->iov_count = count;
+        return;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += iov[i].iov_len;
+    char *copy = capture->buffer;
+    if (total > capture->capacity)
+        copy = capture->overflow ? arena_alloc(capture->overflow, total) : NULL;
+    if (copy == NULL) {
+        log_warn("response_dropped", "No memory to capture a %zu byte response", total);
+        return;
+    }
+
+    char *end = copy;
+    for (int i = 0; i < count; i++)
+        end = (char *)memcpy(end, iov[i].iov_base, iov[i].iov_len) + iov[i].iov_len;
+    capture->iov[0].iov_base = copy;
+    capture->iov[0].iov_len = total;
+    capture->iov_count = 1;
+}
+
+void send_response_extra(int client_fd, int status_code, const char *content_type,
+                         const char *extra_headers, const char *body, size_t body_len) {
+    char response[768];
     const char *status_text = "OK";
 
     switch (status_code) {
         case 200: status_text = "OK"; break;
+        case 304: status_text = "Not Modified"; break;
+        case 400: status_text = "Bad Request"; break;
         case 404: status_text = "Not Found"; break;
+        case 409: status_text = "Conflict"; break;
+        case 429: status_text = "Too Many Requests"; break;
         case 500: status_text = "Internal Server Error"; break;
+        case 503: status_text = "Service Unavailable"; break;
         default: status_text = "Unknown"; break;
     }
 
-    snprintf(response, sizeof(response),
+    // Binary encodings carry no charset
+    const char *charset = strcmp(content_type, "application/cbor") == 0 ? "" : "; charset=utf-8";
+
+    response_status = status_code;
+    int header_len = snprintf(response, sizeof(response),
              "HTTP/1.1 %d %s\r\n"
-             "Content-Type: %s; charset=utf-8\r\n"
+             "Content-Type: %s%s\r\n"
              "Content-Length: %lu\r\n"
              "Access-Control-Allow-Origin: *\r\n"
              "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+             "Access-Control-Expose-Headers: ETag\r\n"
+             "%s"
              "Connection: close\r\n"
-             "\r\n"
-             "%s",
-             status_code, status_text, content_type, strlen(body), body);
+             "\r\n",
+             status_code, status_text, content_type, charset, body_len, extra_headers);
+
+    // Send headers and body together without copying (and truncating) the body
+    struct iovec iov[2] = {
+        { response, (size_t)header_len },
+        { (void *)body, body_len }
+    };
+    write_response(client_fd, iov, 2, 0);
+}
 
-    send(client_fd, response, strlen(response), 0);
+void send_response_body(int client_fd, int status_code, const char *content_type,
+                        const char *body, size_t body_len) {
+    send_response_extra(client_fd, status_code, content_type, "", body, body_len);
+}
+
+void send_response(int client_fd, int status_code, const char *content_type, const char *body) {
+    send_response_body(client_fd, status_code, content_type, body, strlen(body));
+}
+
+// Sends the document of a single-encoding emitter
+void send_emitter_response(int client_fd, Emitter *out, Encoding encoding) {
+    if (emitter_finish(out) < 0) {
+        send_response(client_fd, 500, "text/plain", "Response too large");
+        return;
+    }
+    size_t length;
+    const char *body = emitter_data(out, encoding, &length);
+    send_response_extra(client_fd, 200, encoding_content_type(encoding), "Vary: Accept\r\n",
+                        body, length);
 }
 
 void send_file(int client_fd, const char *filepath) {
@@ -127,6 +384,7 @@ void send_file(int client_fd, const char *filepath) {
              "\r\n",
              content_type, file_size);
 
+    response_status = 200;
     send(client_fd, header, strlen(header), 0);
 
     char buffer[4096];
@@ -138,154 +396,961 @@ void send_file(int client_fd, const char *filepath) {
     fclose(fp);
 }
 
-void handle_network_info_request(int client_fd) {
+void server_set_web_root(const char *dir) {
+    web_root = dir;
+}
+
+static int compare_asset_path(const void *key, const void *asset) {
+    return strcmp((const char *)key, ((const Asset *)asset)->path);
+}
+
+const Asset* find_asset(const char *path) {
+    return bsearch(path, embedded_assets, embedded_asset_count, sizeof(Asset), compare_asset_path);
+}
+
+// True unless Accept-Encoding is missing or refuses gzip with q=0
+static int accepts_gzip(const HttpRequest *request) {
+    char value[256];
+    if (http_request_header(request, "Accept-Encoding", value, sizeof(value)) != 0)
+        return 0;
+
+    const char *token = strstr(value, "gzip");
+    if (token == NULL)
+        return 0;
+    token += 4;
+    while (*token == ' ')
+        token++;
+    if (strncmp(token, ";q=0", 4) == 0) {
+        for (token += 4; *token == '.' || *token == '0'; token++)
+            ;
+        return *token >= '1' && *token <= '9';
+    }
+    return 1;
+}
+
+// Serves an embedded asset with one write of precomputed data
+void send_asset(int client_fd, const HttpRequest *request, const Asset *asset) {
+    char value[256];
+    if (http_request_header(request, "If-None-Match", value, sizeof(value)) == 0 &&
+        (strstr(value, asset->etag) || strcmp(value, "*") == 0)) {
+        struct iovec iov = { (void *)asset->not_modified_header, asset->not_modified_length };
+        response_status = 304;
+        write_response(client_fd, &iov, 1, 1);
+        return;
+    }
+
+    int gzipped = asset->gzip_body && accepts_gzip(request);
+    struct iovec iov[2] = {
+        { (void *)(gzipped ? asset->gzip_header : asset->header),
+          gzipped ? asset->gzip_header_length : asset->header_length },
+        { (void *)(gzipped ? asset->gzip_body : asset->body),
+          gzipped ? asset->gzip_length : asset->body_length }
+    };
+    response_status = 200;
+    write_response(client_fd, iov, 2, 1);
+}
+
+static void handle_web_request(int client_fd, const HttpRequest *request, const char *path) {
+    if (web_root) {
+        // Development mode: straight from disk, so edits show up on reload
+        if (strstr(path, "..")) {
+            send_response(client_fd, 404, "text/plain", "File not found");
+            return;
+        }
+        char filepath[768];
+        snprintf(filepath, sizeof(filepath), "%s%s", web_root, path);
+        send_file(client_fd, filepath);
+        return;
+    }
+
+    const Asset *asset = find_asset(path);
+    if (asset == NULL) {
+        send_response(client_fd, 404, "text/plain", "File not found");
+        return;
+    }
+    send_asset(client_fd, request, asset);
+}
+
+// Copies the value of a query string parameter into out. Returns 0 if found.
+static int get_query_param(const char *query, const char *name, char *out, size_t out_size) {
+    size_t name_len = strlen(name);
+
+    while (query && *query) {
+        const char *end = strchr(query, '&');
+        size_t len = end ? (size_t)(end - query) : strlen(query);
+
+        if (len > name_len && strncmp(query, name, name_len) == 0 && query[name_len] == '=') {
+            size_t value_len = len - name_len - 1;
+            if (value_len >= out_size)
+                return -1;
+            memcpy(out, query + name_len + 1, value_len);
+            out[value_len] = '\0';
+            return 0;
+        }
+        query = end ? end + 1 : NULL;
+    }
+    return -1;
+}
+
+// Copies the value of a request header (case-insensitive name) into out.
+// Returns 0 if found.
+int http_request_header(const HttpRequest *request, const char *name, char *out, size_t out_size) {
+    size_t name_len = strlen(name);
+    const char *line = request->headers;
+
+    while (line && *line && strncmp(line, "\r\n", 2) != 0) {
+        const char *end = strstr(line, "\r\n");
+        size_t len = end ? (size_t)(end - line) : strlen(line);
+
+        if (len > name_len && strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *value = line + name_len + 1;
+            while (*value == ' ' || *value == '\t')
+                value++;
+            size_t value_len = len - (value - line);
+            if (value_len >= out_size)
+                return -1;
+            memcpy(out, value, value_len);
+            out[value_len] = '\0';
+            return 0;
+        }
+        line = end ? end + 2 : NULL;
+    }
+    return -1;
+}
+
+// Encoding the client's Accept header asks for
+static Encoding request_encoding(const HttpRequest *request) {
+    char accept[512];
+    if (http_request_header(request, "Accept", accept, sizeof(accept)) < 0)
+        return ENCODING_JSON;
+    return encoding_negotiate(accept);
+}
+
+static void build_network_info(Emitter *out) {
     NetworkInfo info;
-    memset(&info, 0, sizeof(info));
-    strncpy(info.ipv4, "N/A", sizeof(info.ipv4) - 1);
-    strncpy(info.ipv6, "N/A", sizeof(info.ipv6) - 1);
-    strncpy(info.gateway, "N/A", sizeof(info.gateway) - 1);
-    strncpy(info.dns1, "N/A", sizeof(info.dns1) - 1);
-    strncpy(info.dns2, "N/A", sizeof(info.dns2) - 1);
-    
-    // Get actual network information
-    get_network_info(&info);
-
-    JSONBuffer *json = json_create_object();
-    json_add_string(json, "ipv4", info.ipv4);
-    json_add_string(json, "ipv6", info.ipv6);
-    json_add_string(json, "gateway", info.gateway);
-    json_add_string(json, "dns1", info.dns1);
-    json_add_string(json, "dns2", info.dns2);
-
-    const char *response = json_get_string(json);
-    send_response(client_fd, 200, "application/json", response);
-    json_free(json);
-}
-
-void handle_speed_test_request(int client_fd) {
+    network_info_collect(&info);
+    network_info_write(out, NULL, &info);
+}
+
+void handle_speed_test_request(int client_fd, const HttpRequest *request) {
     SpeedTestResult result;
     memset(&result, 0, sizeof(result));
     perform_speed_test(&result);
+    metrics_record_speed_test(&result);
+    events_publish_speed_test(&result);
+    history_record_speed_test(&result);
+    shm_export_speed_test(&result);
 
-    JSONBuffer *json = json_create_object();
-    json_add_number(json, "download_mbps", result.download_mbps);
-    json_add_number(json, "upload_mbps", result.upload_mbps);
-    json_add_number(json, "ping_ms", result.ping_ms);
-    json_add_integer(json, "test_time", (int)result.test_time);
+    Encoding encoding = request_encoding(request);
+    char body[JSON_RESPONSE_MAX];
+    Emitter out;
+    emitter_init(&out, encoding, body, sizeof(body));
+    emit_begin_object(&out, NULL);
+    emit_number(&out, "download_mbps", result.download_mbps);
+    emit_number(&out, "upload_mbps", result.upload_mbps);
+    emit_number(&out, "ping_ms", result.ping_ms);
+    emit_int(&out, "test_time", result.test_time);
+    emit_end_object(&out);
 
-    const char *response = json_get_string(json);
-    send_response(client_fd, 200, "application/json", response);
-    json_free(json);
+    send_emitter_response(client_fd, &out, encoding);
 }
 
-void handle_isp_info_request(int client_fd) {
-    ISPInfo info;
-    memset(&info, 0, sizeof(info));
-    strncpy(info.isp_name, "Unknown", sizeof(info.isp_name) - 1);
-    strncpy(info.country, "Unknown", sizeof(info.country) - 1);
-    strncpy(info.city, "Unknown", sizeof(info.city) - 1);
-    strncpy(info.latitude, "N/A", sizeof(info.latitude) - 1);
-    strncpy(info.longitude, "N/A", sizeof(info.longitude) - 1);
-    strncpy(info.timezone, "Unknown", sizeof(info.timezone) - 1);
-    
+static void collect_isp_info(ISPInfo *info) {
+    memset(info, 0, sizeof(*info));
+    strncpy(info->isp_name, "Unknown", sizeof(info->isp_name) - 1);
+    strncpy(info->country, "Unknown", sizeof(info->country) - 1);
+    strncpy(info->city, "Unknown", sizeof(info->city) - 1);
+    strncpy(info->latitude, "N/A", sizeof(info->latitude) - 1);
+    strncpy(info->longitude, "N/A", sizeof(info->longitude) - 1);
+    strncpy(info->timezone, "Unknown", sizeof(info->timezone) - 1);
+
     // Get ISP information
-    get_isp_info(&info);
+    get_isp_info(info);
+}
 
-    JSONBuffer *json = json_create_object();
-    json_add_string(json, "isp", info.isp_name);
-    json_add_string(json, "country", info.country);
-    json_add_string(json, "city", info.city);
-    json_add_string(json, "latitude", info.latitude);
-    json_add_string(json, "longitude", info.longitude);
-    json_add_string(json, "timezone", info.timezone);
+static void write_isp_info(Emitter *out, const char *key, const ISPInfo *info) {
+    emit_begin_object(out, key);
+    emit_string(out, "isp", info->isp_name);
+    emit_string(out, "country", info->country);
+    emit_string(out, "city", info->city);
+    emit_string(out, "latitude", info->latitude);
+    emit_string(out, "longitude", info->longitude);
+    emit_string(out, "timezone", info->timezone);
+    emit_end_object(out);
+}
 
-    const char *response = json_get_string(json);
-    send_response(client_fd, 200, "application/json", response);
-    json_free(json);
+static void build_isp_info(Emitter *out) {
+    ISPInfo info;
+    collect_isp_info(&info);
+    write_isp_info(out, NULL, &info);
 }
 
-void handle_interface_stats_request(int client_fd) {
+static void build_interface_stats(Emitter *out) {
     InterfaceStats stats;
-    memset(&stats, 0, sizeof(stats));
-    strncpy(stats.interface_name, "eth0", sizeof(stats.interface_name) - 1);
-    strncpy(stats.bytes_sent, "0", sizeof(stats.bytes_sent) - 1);
-    strncpy(stats.bytes_recv, "0", sizeof(stats.bytes_recv) - 1);
-    
-    // Get interface statistics
-    get_interface_stats(&stats);
-
-    JSONBuffer *json = json_create_object();
-    json_add_string(json, "interface", stats.interface_name);
-    json_add_string(json, "bytes_sent", stats.bytes_sent);
-    json_add_string(json, "bytes_received", stats.bytes_recv);
-
-    const char *response = json_get_string(json);
-    send_response(client_fd, 200, "application/json", response);
-    json_free(json);
-}
-
-void* handle_client_connection_thread(void* arg) {
-    int client_fd = *(int*)arg;
-    free(arg);  // Free the allocated memory
-    
-    char buffer[MAX_BUFFER_SIZE];
-    int bytes_read = recv(client_fd, buffer, sizeof(buffer) - 1, 0);
-
-    if (bytes_read < 0) {
-        perror("recv");
-        close(client_fd);
+    if (interface_stats_collect(&stats) == 0) {
+        metrics_record_interface(stats.interface_name,
+                                 strtoull(stats.bytes_sent, NULL, 10),
+                                 strtoull(stats.bytes_recv, NULL, 10));
+    }
+    interface_stats_write(out, NULL, &stats, NULL);
+}
+
+// null when sock_diag is unavailable (e.g. a seccomp-restricted container)
+static void build_socket_stats(Emitter *out) {
+    SockStats stats;
+    if (sockstat_collect(&stats) < 0)
+        emit_null(out, NULL);
+    else
+        sockstat_write(out, &stats);
+}
+
+// Versioned resources, their cache lifetimes, and their keys in /api/all.
+// Speed test, traceroute and history are not here: the first runs a new
+// measurement per request, the others change every round or depend on the
+// requested range (see README).
+static const struct {
+    ResourceId id;
+    const char *field;
+    unsigned ttl_ms;
+    ResourceBuildFn build;
+} resource_table[] = {
+    { RESOURCE_NETWORK_INFO, "network", 2000, build_network_info },
+    { RESOURCE_ISP_INFO, "isp", 60000, build_isp_info },
+    { RESOURCE_INTERFACE_STATS, "interface", 1000, build_interface_stats },
+    { RESOURCE_SOCKET_STATS, "sockets", 1000, build_socket_stats },
+};
+
+#define RESOURCE_TABLE_SIZE (sizeof(resource_table) / sizeof(resource_table[0]))
+
+static void register_resources() {
+    for (size_t i = 0; i < RESOURCE_TABLE_SIZE; i++)
+        resource_register(resource_table[i].id, resource_table[i].ttl_ms, resource_table[i].build);
+}
+
+// Parses "30s", "500ms" or plain seconds; returns -1 if malformed
+static int parse_wait(const char *value, unsigned *wait_ms) {
+    char *end;
+    unsigned long amount = strtoul(value, &end, 10);
+
+    if (end == value)
+        return -1;
+    if (strcmp(end, "ms") == 0)
+        *wait_ms = amount;
+    else if (strcmp(end, "s") == 0 || *end == '\0')
+        *wait_ms = amount > RESOURCE_MAX_WAIT_MS / 1000 ? RESOURCE_MAX_WAIT_MS : amount * 1000;
+    else
+        return -1;
+
+    if (*wait_ms > RESOURCE_MAX_WAIT_MS)
+        *wait_ms = RESOURCE_MAX_WAIT_MS;
+    return 0;
+}
+
+// Serves the resources in mask from the cache: 304 when If-None-Match still
+// matches, and with ?wait= holds the request until one of them changes.
+// wrap puts every section under its field name, as /api/all does.
+static void handle_resource_request(int client_fd, const HttpRequest *request,
+                                    unsigned mask, int wrap) {
+    Encoding encoding = request_encoding(request);
+    char value[RESOURCE_ETAG_MAX];
+    unsigned wait_ms = 0;
+
+    if (get_query_param(request->query, "wait", value, sizeof(value)) == 0 &&
+        parse_wait(value, &wait_ms) < 0) {
+        send_response(client_fd, 400, "text/plain", "Invalid wait");
+        return;
+    }
+
+    uint64_t known[RESOURCE_COUNT] = { 0 };
+    int have_known = http_request_header(request, "If-None-Match", value, sizeof(value)) == 0 &&
+                     resource_parse_etag(value, mask, encoding, known) == 0;
+
+    ResourceSnapshot snapshots[RESOURCE_COUNT];
+    if (wait_ms > 0 && !have_known) {
+        // No validator: wait for the next change after the current state
+        resource_wait(mask, encoding, NULL, 0, snapshots);
+        for (int id = 0; id < RESOURCE_COUNT; id++)
+            known[id] = snapshots[id].version;
+        have_known = 1;
+    }
+    int changed = resource_wait(mask, encoding, have_known ? known : NULL, wait_ms, snapshots);
+
+    char headers[RESOURCE_ETAG_MAX + 80];
+    char etag[RESOURCE_ETAG_MAX];
+    resource_format_etag(mask, encoding, snapshots, etag, sizeof(etag));
+    snprintf(headers, sizeof(headers), "ETag: %s\r\nCache-Control: no-cache\r\nVary: Accept\r\n",
+             etag);
+
+    if (have_known && !changed) {
+        send_response_extra(client_fd, 304, encoding_content_type(encoding), headers, "", 0);
+        return;
+    }
+
+    char body[JSON_RESPONSE_MAX];
+    Emitter out;
+    emitter_init(&out, encoding, body, sizeof(body));
+    if (wrap)
+        emit_begin_object(&out, NULL);
+    for (size_t i = 0; i < RESOURCE_TABLE_SIZE; i++) {
+        const ResourceSnapshot *snapshot = &snapshots[resource_table[i].id];
+        if (!(mask & RESOURCE_MASK(resource_table[i].id)))
+            continue;
+        if (snapshot->version == 0) {
+            send_response(client_fd, 500, "text/plain", "Resource unavailable");
+            return;
+        }
+        emit_raw(&out, wrap ? resource_table[i].field : NULL, snapshot->body, snapshot->length);
+    }
+    if (wrap)
+        emit_end_object(&out);
+
+    if (emitter_finish(&out) < 0) {
+        send_response(client_fd, 500, "text/plain", "Response too large");
+        return;
+    }
+    size_t length;
+    const char *data = emitter_data(&out, encoding, &length);
+    send_response_extra(client_fd, 200, encoding_content_type(encoding), headers, data, length);
+}
+
+void handle_network_info_request(int client_fd, const HttpRequest *request) {
+    handle_resource_request(client_fd, request, RESOURCE_MASK(RESOURCE_NETWORK_INFO), 0);
+}
+
+void handle_isp_info_request(int client_fd, const HttpRequest *request) {
+    handle_resource_request(client_fd, request, RESOURCE_MASK(RESOURCE_ISP_INFO), 0);
+}
+
+void handle_interface_stats_request(int client_fd, const HttpRequest *request) {
+    handle_resource_request(client_fd, request, RESOURCE_MASK(RESOURCE_INTERFACE_STATS), 0);
+}
+
+void handle_socket_stats_request(int client_fd, const HttpRequest *request) {
+    handle_resource_request(client_fd, request, RESOURCE_MASK(RESOURCE_SOCKET_STATS), 0);
+}
+
+// Parses a comma-separated field list into a resource mask, 0 if a name is unknown
+static unsigned parse_all_fields(const char *fields) {
+    unsigned mask = 0;
+
+    while (*fields) {
+        const char *end = strchr(fields, ',');
+        size_t len = end ? (size_t)(end - fields) : strlen(fields);
+        size_t i;
+
+        for (i = 0; i < RESOURCE_TABLE_SIZE; i++) {
+            if (strlen(resource_table[i].field) == len &&
+                strncmp(fields, resource_table[i].field, len) == 0)
+                break;
+        }
+        if (i == RESOURCE_TABLE_SIZE)
+            return 0;
+        mask |= RESOURCE_MASK(resource_table[i].id);
+        fields = end ? end + 1 : fields + len;
+    }
+    return mask;
+}
+
+// The cached resources a request reads, 0 for other routes and for
+// /api/all with unknown fields
+static unsigned route_resources(RouteId route, const char *query) {
+    char fields[128];
+    unsigned mask = 0;
+
+    switch (route) {
+        case ROUTE_NETWORK_INFO:
+            return RESOURCE_MASK(RESOURCE_NETWORK_INFO);
+        case ROUTE_ISP_INFO:
+            return RESOURCE_MASK(RESOURCE_ISP_INFO);
+        case ROUTE_INTERFACE_STATS:
+            return RESOURCE_MASK(RESOURCE_INTERFACE_STATS);
+        case ROUTE_SOCKET_STATS:
+            return RESOURCE_MASK(RESOURCE_SOCKET_STATS);
+        case ROUTE_ALL:
+            if (get_query_param(query, "fields", fields, sizeof(fields)) == 0)
+                return parse_all_fields(fields);
+            for (size_t i = 0; i < RESOURCE_TABLE_SIZE; i++)
+                mask |= RESOURCE_MASK(resource_table[i].id);
+            return mask;
+        default:
+            return 0;
+    }
+}
+
+// Stale sections are rebuilt in parallel by the resource cache
+void handle_all_request(int client_fd, const HttpRequest *request) {
+    unsigned mask = route_resources(ROUTE_ALL, request->query);
+    if (mask == 0) {
+        send_response(client_fd, 400, "text/plain", "Invalid fields");
+        return;
+    }
+
+    handle_resource_request(client_fd, request, mask, 1);
+}
+
+void handle_traceroute_request(int client_fd, const HttpRequest *request) {
+    char target[64] = "8.8.8.8";
+    get_query_param(request->query, "target", target, sizeof(target));
+
+    // Only hostnames and numeric addresses are accepted as targets
+    for (const char *c = target; *c; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '.' && *c != ':' && *c != '-') {
+            send_response(client_fd, 400, "text/plain", "Invalid target");
+            return;
+        }
+    }
+
+    TracerouteReport report;
+    int started = start_traceroute(target);
+    if (started == TRACEROUTE_BUSY) {
+        send_response(client_fd, 409, "text/plain", "Another target is being traced");
+        return;
+    }
+    if (started < 0 || get_traceroute_report(&report, 3000) < 0) {
+        send_response(client_fd, 500, "text/plain", "Traceroute unavailable");
+        return;
+    }
+
+    Encoding encoding = request_encoding(request);
+    char body[JSON_RESPONSE_MAX];
+    Emitter out;
+    emitter_init(&out, encoding, body, sizeof(body));
+    emit_begin_object(&out, NULL);
+    emit_string(&out, "target", report.target);
+    emit_int(&out, "rounds", report.rounds);
+    emit_int(&out, "last_round", report.last_round);
+
+    emit_begin_array(&out, "hops");
+    for (int i = 0; i < report.hop_count; i++) {
+        const TracerouteHop *hop = &report.hops[i];
+        emit_begin_object(&out, NULL);
+        emit_int(&out, "ttl", hop->ttl);
+        emit_string(&out, "address", hop->received ? hop->address : "*");
+        emit_int(&out, "sent", hop->sent);
+        emit_int(&out, "received", hop->received);
+        emit_number(&out, "loss_percent",
+                          hop->sent ? 100.0 * (hop->sent - hop->received) / hop->sent : 0.0);
+        emit_number(&out, "last_ms", hop->last_ms);
+        emit_number(&out, "best_ms", hop->best_ms);
+        emit_number(&out, "avg_ms", hop->avg_ms);
+        emit_number(&out, "worst_ms", hop->worst_ms);
+        emit_number(&out, "stddev_ms", traceroute_hop_stddev(hop));
+        emit_bool(&out, "destination", hop->is_destination);
+        emit_end_object(&out);
+    }
+    emit_end_array(&out);
+    emit_end_object(&out);
+
+    send_emitter_response(client_fd, &out, encoding);
+}
+
+void handle_history_request(int client_fd, const HttpRequest *request) {
+    const char *query = request->query;
+    char value[32];
+    HistorySeries series;
+    time_t to = time(NULL);
+    time_t from = to - 86400;
+    long points = HISTORY_DEFAULT_POINTS;
+
+    if (get_query_param(query, "series", value, sizeof(value)) < 0 ||
+        history_parse_series(value, &series) < 0) {
+        send_response(client_fd, 400, "text/plain", "Invalid series");
+        return;
+    }
+    if (get_query_param(query, "from", value, sizeof(value)) == 0)
+        from = strtoll(value, NULL, 10);
+    if (get_query_param(query, "to", value, sizeof(value)) == 0)
+        to = strtoll(value, NULL, 10);
+    if (get_query_param(query, "points", value, sizeof(value)) == 0)
+        points = strtol(value, NULL, 10);
+    if (from > to || points < 1 || points > HISTORY_MAX_POINTS) {
+        send_response(client_fd, 400, "text/plain", "Invalid range");
+        return;
+    }
+
+    // Roughly 100 bytes per bucket with three values
+    size_t capacity = 1024 + (size_t)points * 160;
+    char *body = arena_alloc(server_request_arena(), capacity);
+    if (body == NULL) {
+        send_response(client_fd, 500, "text/plain", "Out of memory");
+        return;
+    }
+
+    Encoding encoding = request_encoding(request);
+    Emitter out;
+    emitter_init(&out, encoding, body, capacity);
+    if (history_query(series, from, to, (int)points, &out) < 0)
+        send_response(client_fd, 503, "text/plain", "History unavailable");
+    else
+        send_emitter_response(client_fd, &out, encoding);
+}
+
+// Peer snapshots are stored as JSON, so the fleet table is always JSON
+void handle_fleet_request(int client_fd) {
+    if (!fleet_enabled()) {
+        send_response(client_fd, 503, "text/plain", "Fleet mode not enabled");
+        return;
+    }
+
+    size_t length;
+    char *body = fleet_render(server_request_arena(), &length);
+    if (body == NULL) {
+        send_response(client_fd, 500, "text/plain", "Out of memory");
+        return;
+    }
+    send_response_body(client_fd, 200, "application/json", body, length);
+}
+
+// Served from the background sampler's latest snapshot
+void handle_wireless_request(int client_fd, const HttpRequest *request) {
+    WirelessSnapshot snapshot;
+    if (wireless_get_snapshot(&snapshot) < 0) {
+        send_response(client_fd, 503, "text/plain", "Wireless metrics unavailable");
+        return;
+    }
+
+    Encoding encoding = request_encoding(request);
+    char body[JSON_RESPONSE_MAX];
+    Emitter out;
+    emitter_init(&out, encoding, body, sizeof(body));
+    wireless_write_snapshot(&out, &snapshot);
+    send_emitter_response(client_fd, &out, encoding);
+}
+
+// Returns 1 if the event hub took over the connection
+int handle_events_request(int client_fd) {
+    if (events_subscribe(client_fd) < 0) {
+        send_response(client_fd, 503, "text/plain", "Too many subscribers");
+        return 0;
+    }
+    response_status = 200;
+    return 1;
+}
+
+void handle_metrics_request(int client_fd) {
+    size_t length;
+    char *body = metrics_render(server_request_arena(), &length);
+    if (body == NULL) {
+        send_response(client_fd, 500, "text/plain", "Out of memory");
+        return;
+    }
+    send_response_body(client_fd, 200, "text/plain; version=0.0.4", body, length);
+}
+
+Arena* server_request_arena() {
+    if (!request_arena_ready) {
+        // A worker that cannot get its block still works, from the heap
+        if (arena_init(&request_arena, REQUEST_ARENA_SIZE) < 0)
+            arena_init(&request_arena, 0);
+        request_arena_ready = 1;
+    }
+    return &request_arena;
+}
+
+ClientConnection* client_connection_acquire(int socket_fd, uint32_t client_address) {
+    pthread_mutex_lock(&connection_lock);
+    ClientConnection *connection = free_connections;
+    if (connection)
+        free_connections = connection->next;
+    pthread_mutex_unlock(&connection_lock);
+    if (connection == NULL)
         return NULL;
+
+    connection->socket_fd = socket_fd;
+    connection->client_address = client_address;
+    connection->route = ROUTE_NOT_FOUND;
+    connection->started_at = 0;
+    return connection;
+}
+
+void client_connection_release(ClientConnection *connection) {
+    pthread_mutex_lock(&connection_lock);
+    connection->next = free_connections;
+    free_connections = connection;
+    pthread_mutex_unlock(&connection_lock);
+}
+
+static void close_client_connection(ClientConnection *connection) {
+    close(connection->socket_fd);
+    client_connection_release(connection);
+}
+
+// Queued connections dropped at shutdown; those still on the fast lane
+// have not been read, so they were never counted
+static void discard_client_connection(void *item) {
+    ClientConnection *connection = item;
+    if (connection->started_at)
+        metrics_request_end(connection->route, 503, metrics_now_us() - connection->started_at);
+    close_client_connection(connection);
+}
+
+static void reject_client_connection(ClientConnection *connection, int status, unsigned retry_after,
+                                     const char *body) {
+    char headers[64];
+    snprintf(headers, sizeof(headers), "Retry-After: %u\r\n", retry_after);
+    response_status = 0;
+    send_response_extra(connection->socket_fd, status, "text/plain", headers, body, strlen(body));
+    metrics_request_end(connection->route, response_status,
+                        metrics_now_us() - connection->started_at);
+    // A capturing caller sends the rejection and closes the socket itself
+    if (response_capture)
+        client_connection_release(connection);
+    else
+        close_client_connection(connection);
+}
+
+int client_connection_blocks(const ClientConnection *connection) {
+    RouteId route = connection->route;
+    if (route == ROUTE_EVENTS || (web_root && (route == ROUTE_INDEX || route == ROUTE_STATIC)))
+        return 1;
+    unsigned mask = route_resources(route, connection->request.query);
+    return mask != 0 && !resource_fresh(mask, INLINE_FRESH_MARGIN_MS);
+}
+
+void client_connection_defer(ClientConnection *connection) {
+    if (lane_submit(&lanes[LANE_FAST], connection) < 0)
+        reject_client_connection(connection, 503, 1, "Server busy");
+}
+
+int handle_client_request(ClientConnection *connection) {
+    int client_fd = connection->socket_fd;
+    HttpRequest *request = &connection->request;
+    const char *method = request->method;
+    const char *path = request->path;
+    response_status = 0;
+    int detached = 0;
+
+    // Route requests
+    switch (connection->route) {
+        case ROUTE_PREFLIGHT: {
+            // Handle CORS preflight
+            char response[512];
+            snprintf(response, sizeof(response),
+                     "HTTP/1.1 200 OK\r\n"
+                     "Access-Control-Allow-Origin: *\r\n"
+                     "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+                     "Access-Control-Allow-Headers: Content-Type, If-None-Match\r\n"
+                     "Content-Length: 0\r\n"
+                     "Connection: close\r\n"
+                     "\r\n");
+            struct iovec iov = { response, strlen(response) };
+            write_response(client_fd, &iov, 1, 0);
+            response_status = 200;
+            break;
+        }
+        case ROUTE_INDEX:
+            handle_web_request(client_fd, request, "/index.html");
+            break;
+        case ROUTE_NETWORK_INFO:
+            handle_network_info_request(client_fd, request);
+            break;
+        case ROUTE_SPEED_TEST:
+            handle_speed_test_request(client_fd, request);
+            break;
+        case ROUTE_ISP_INFO:
+            handle_isp_info_request(client_fd, request);
+            break;
+        case ROUTE_INTERFACE_STATS:
+            handle_interface_stats_request(client_fd, request);
+            break;
+        case ROUTE_SOCKET_STATS:
+            handle_socket_stats_request(client_fd, request);
+            break;
+        case ROUTE_TRACEROUTE:
+            handle_traceroute_request(client_fd, request);
+            break;
+        case ROUTE_ALL:
+            handle_all_request(client_fd, request);
+            break;
+        case ROUTE_HISTORY:
+            handle_history_request(client_fd, request);
+            break;
+        case ROUTE_FLEET:
+            handle_fleet_request(client_fd);
+            break;
+        case ROUTE_WIRELESS:
+            handle_wireless_request(client_fd, request);
+            break;
+        case ROUTE_EVENTS:
+            detached = handle_events_request(client_fd);
+            break;
+        case ROUTE_METRICS:
+            handle_metrics_request(client_fd);
+            break;
+        case ROUTE_STATIC:
+            handle_web_request(client_fd, request, path);
+            break;
+        default:
+            if (strcmp(method, "GET") == 0) {
+                send_response(client_fd, 404, "text/plain", "Not Found");
+            } else {
+                send_response(client_fd, 404, "text/plain", "Method Not Allowed");
+            }
+            break;
     }
 
-    buffer[bytes_read] = '\0';
+    metrics_request_end(connection->route, response_status,
+                        metrics_now_us() - connection->started_at);
+    return detached;
+}
+
+void dispatch_client_connection(void *item) {
+    ClientConnection *connection = item;
+
+    // Event stream connections now belong to the event hub
+    if (handle_client_request(connection))
+        client_connection_release(connection);
+    else
+        close_client_connection(connection);
+    arena_reset(server_request_arena());
+}
+
+void client_connection_parse(ClientConnection *connection, size_t length) {
+    char *buffer = connection->buffer;
+    buffer[length] = '\0';
 
     // Parse request line
-    char method[16], path[256], protocol[16];
-    sscanf(buffer, "%s %s %s", method, path, protocol);
-
-    printf("[%s] %s %s\n", method, path, protocol);
-
-    // Handle CORS preflight
-    if (strcmp(method, "OPTIONS") == 0) {
-        char response[512];
-        snprintf(response, sizeof(response),
-                 "HTTP/1.1 200 OK\r\n"
-                 "Access-Control-Allow-Origin: *\r\n"
-                 "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
-                 "Access-Control-Allow-Headers: Content-Type\r\n"
-                 "Content-Length: 0\r\n"
-                 "Connection: close\r\n"
-                 "\r\n");
-        send(client_fd, response, strlen(response), 0);
+    HttpRequest *request = &connection->request;
+    memset(request, 0, sizeof(*request));
+    sscanf(buffer, "%15s %255s %15s", request->method, request->path, request->protocol);
+
+    log_sampled(LOG_INFO, log_sample_rate(), "request", "[%s] %s %s",
+                request->method, request->path, request->protocol);
+
+    // Split off the query string; headers start on the line after the request line
+    char *query = strchr(request->path, '?');
+    if (query)
+        *query++ = '\0';
+    request->query = query;
+    request->headers = strstr(buffer, "\r\n");
+    if (request->headers)
+        request->headers += 2;
+
+    connection->route = resolve_route(request->method, request->path);
+    connection->started_at = metrics_now_us();
+    metrics_request_begin(connection->route);
+}
+
+int client_connection_route(ClientConnection *connection) {
+    LaneId lane = route_lane(connection->route, connection->request.query);
+    if (lane == LANE_FAST)
+        return 1;
+
+    if (lane == LANE_SLOW) {
+        // Looked up only here: accepting through io_uring does not report it
+        if (connection->client_address == 0) {
+            struct sockaddr_in address;
+            socklen_t address_length = sizeof(address);
+            if (getpeername(connection->socket_fd, (struct sockaddr *)&address, &address_length) == 0)
+                connection->client_address = address.sin_addr.s_addr;
+        }
+        uint64_t wait_ms = rate_limiter_take(&slow_rate, connection->client_address,
+                                             connection->started_at / 1000);
+        if (wait_ms > 0) {
+            reject_client_connection(connection, 429, (unsigned)((wait_ms + 999) / 1000),
+                                     "Too Many Requests");
+            return 0;
+        }
+    }
+    if (lane_submit(&lanes[lane], connection) < 0) {
+        log_sampled(LOG_WARN, log_sample_rate(), "lane_full", "%s lane queue full, rejecting %s",
+                    lane_name(lane), route_name(connection->route));
+        reject_client_connection(connection, 503, 1, "Server busy");
+    }
+    return 0;
+}
+
+// Runs on the fast lane: reads and routes the request, then handles it in
+// place or queues it on its own lane
+void serve_client_connection(void *item) {
+    ClientConnection *connection = item;
+    // Read and routed already, by the io_uring loop
+    if (connection->started_at) {
+        dispatch_client_connection(connection);
+        return;
+    }
+
+    // The accept loop only queues connections with data (or EOF) waiting,
+    // so this never parks the worker
+    int bytes_read = recv(connection->socket_fd, connection->buffer,
+                          sizeof(connection->buffer) - 1, MSG_DONTWAIT);
+
+    if (bytes_read <= 0) {
+        if (bytes_read < 0)
+            log_warn("recv_failed", "recv: %s", strerror(errno));
+        close_client_connection(connection);
+        return;
+    }
+
+    client_connection_parse(connection, (size_t)bytes_read);
+    if (client_connection_route(connection))
+        dispatch_client_connection(connection);
+}
+
+int server_start_workers() {
+    register_resources();
+
+    // At most every worker and every queue slot of every lane holds one, plus
+    // the connections still waiting for their request. The accept thread
+    // caps those at ACCEPT_WAITING_MAX, so idle sockets never take the
+    // slots the lanes need.
+    size_t slots = ACCEPT_WAITING_MAX;
+    for (int lane = 0; lane < LANE_COUNT; lane++)
+        slots += (size_t)lane_config[lane].workers + lane_config[lane].queue;
+    connection_slots = calloc(slots, sizeof(ClientConnection));
+    if (connection_slots == NULL)
+        return -1;
+    for (size_t i = 0; i < slots; i++)
+        client_connection_release(&connection_slots[i]);
+
+    rate_limiter_init(&slow_rate, slow_rate_per_minute, slow_rate_burst);
+    for (int lane = 0; lane < LANE_COUNT; lane++) {
+        LaneTask run = lane == LANE_FAST ? serve_client_connection : dispatch_client_connection;
+        if (lane_start(&lanes[lane], lane_config[lane].name, lane_config[lane].workers,
+                       lane_config[lane].queue, run, discard_client_connection) < 0) {
+            log_error("lane_failed", "Failed to start %s lane", lane_config[lane].name);
+            while (--lane >= 0)
+                lane_stop(&lanes[lane]);
+            free_connections = NULL;
+            free(connection_slots);
+            connection_slots = NULL;
+            return -1;
+        }
+    }
+    lanes_running = 1;
+    return 0;
+}
+
+void server_stop_workers() {
+    if (!lanes_running)
+        return;
+    lanes_running = 0;
+    for (int lane = 0; lane < LANE_COUNT; lane++)
+        lane_stop(&lanes[lane]);
+
+    // Event streams keep their sockets; the slots are no longer referenced
+    pthread_mutex_lock(&connection_lock);
+    free_connections = NULL;
+    free(connection_slots);
+    connection_slots = NULL;
+    pthread_mutex_unlock(&connection_lock);
+}
+
+// Connections accepted but still waiting for their request, oldest (and so
+// soonest to time out) first. Only the accept thread touches it.
+typedef struct {
+    ClientConnection *head;
+    ClientConnection *tail;
+    size_t count;
+} WaitingList;
+
+static void waiting_push(WaitingList *list, ClientConnection *connection) {
+    list->count++;
+    connection->next = NULL;
+    connection->prev = list->tail;
+    if (list->tail)
+        list->tail->next = connection;
+    else
+        list->head = connection;
+    list->tail = connection;
+}
+
+static void waiting_remove(WaitingList *list, ClientConnection *connection) {
+    list->count--;
+    if (connection->prev)
+        connection->prev->next = connection->next;
+    else
+        list->head = connection->next;
+    if (connection->next)
+        connection->next->prev = connection->prev;
+    else
+        list->tail = connection->prev;
+}
+
+static void accept_client(int epoll_fd, WaitingList *waiting) {
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+
+    int client_fd = accept(server_socket, (struct sockaddr *)&client_addr, &client_addr_len);
+    if (client_fd < 0) {
+        if (running) {
+            log_warn("accept_failed", "accept: %s", strerror(errno));
+        }
+        return;
+    }
+
+    log_debug("client_connected", "Client connected from %s:%d",
+              inet_ntoa(client_addr.sin_addr),
+              ntohs(client_addr.sin_port));
+
+    ClientConnection *connection = waiting->count < ACCEPT_WAITING_MAX
+        ? client_connection_acquire(client_fd, client_addr.sin_addr.s_addr)
+        : NULL;
+    if (connection == NULL) {
+        // Not read yet, so there is no route to account it to
+        send_response(client_fd, 503, "text/plain", "Server busy");
         close(client_fd);
-        return NULL;
+        return;
     }
 
-    // Route requests
-    if (strcmp(method, "GET") == 0) {
-        if (strcmp(path, "/") == 0) {
-            send_file(client_fd, "./web/index.html");
-        } else if (strcmp(path, "/api/network-info") == 0) {
-            handle_network_info_request(client_fd);
-        } else if (strcmp(path, "/api/speed-test") == 0) {
-            handle_speed_test_request(client_fd);
-        } else if (strcmp(path, "/api/isp-info") == 0) {
-            handle_isp_info_request(client_fd);
-        } else if (strcmp(path, "/api/interface-stats") == 0) {
-            handle_interface_stats_request(client_fd);
-        } else if (strncmp(path, "/static/", 8) == 0) {
-            char filepath[512];
-            snprintf(filepath, sizeof(filepath), "./web%s", path);
-            send_file(client_fd, filepath);
-        } else {
-            send_response(client_fd, 404, "text/plain", "Not Found");
+    struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = connection };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &event) < 0) {
+        log_warn("epoll_failed", "epoll_ctl: %s", strerror(errno));
+        close_client_connection(connection);
+        return;
+    }
+    connection->read_deadline = metrics_now_us() + CLIENT_READ_TIMEOUT_MS * 1000ULL;
+    waiting_push(waiting, connection);
+}
+
+// Accepts connections and waits for their requests here, so a fast-lane
+// worker is only taken once there is something to read: idle or
+// preconnected sockets cost a pool slot, never a worker
+static void accept_portable() {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &event) < 0) {
+        log_error("epoll_failed", "epoll: %s", strerror(errno));
+        if (epoll_fd >= 0)
+            close(epoll_fd);
+        return;
+    }
+
+    WaitingList waiting = { NULL, NULL, 0 };
+    struct epoll_event events[64];
+    while (running) {
+        int count = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(events[0]), ACCEPT_POLL_MS);
+        for (int i = 0; i < count; i++) {
+            ClientConnection *connection = events[i].data.ptr;
+            if (connection == NULL) {
+                accept_client(epoll_fd, &waiting);
+                continue;
+            }
+
+            // The request (or a hangup) arrived
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->socket_fd, NULL);
+            waiting_remove(&waiting, connection);
+            if (lane_submit(&lanes[LANE_FAST], connection) < 0) {
+                send_response(connection->socket_fd, 503, "text/plain", "Server busy");
+                close_client_connection(connection);
+            }
+        }
+
+        // Clients that never sent their request
+        uint64_t now = metrics_now_us();
+        while (waiting.head && waiting.head->read_deadline <= now) {
+            ClientConnection *connection = waiting.head;
+            waiting_remove(&waiting, connection);
+            close_client_connection(connection);
         }
-    } else {
-        send_response(client_fd, 404, "text/plain", "Method Not Allowed");
     }
 
-    close(client_fd);
-    return NULL;
+    while (waiting.head) {
+        ClientConnection *connection = waiting.head;
+        waiting_remove(&waiting, connection);
+        close_client_connection(connection);
+    }
+    close(epoll_fd);
 }
 
 void* server_accept_loop(void *arg) {
@@ -295,34 +1360,23 @@ void* server_accept_loop(void *arg) {
         fprintf(stderr, "Failed to start server\n");
         return NULL;
     }
+    if (server_start_workers() < 0) {
+        fprintf(stderr, "Failed to start workers\n");
+        stop_server();
+        return NULL;
+    }
 
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
-    while (running) {
-        struct sockaddr_in client_addr;
-        socklen_t client_addr_len = sizeof(client_addr);
+    // Returns once stopped, unless the kernel cannot run it
+    if (io_backend == IO_BACKEND_URING && uring_serve(server_socket, &running) < 0 && running)
+        log_warn("io_backend_fallback", "io_uring unavailable, using the portable backend");
 
-        int client_fd = accept(server_socket, (struct sockaddr *)&client_addr, &client_addr_len);
-        if (client_fd < 0) {
-            if (running) {
-                perror("accept");
-            }
-            continue;
-        }
-
-        printf("Client connected from %s:%d\n",
-               inet_ntoa(client_addr.sin_addr),
-               ntohs(client_addr.sin_port));
-
-        // Handle client in a thread
-        pthread_t thread;
-        int *client_fd_ptr = (int *)malloc(sizeof(int));
-        *client_fd_ptr = client_fd;
-        pthread_create(&thread, NULL, handle_client_connection_thread, client_fd_ptr);
-        pthread_detach(thread);
-    }
+    if (running)
+        accept_portable();
 
     stop_server();
+    server_stop_workers();
     return NULL;
 }
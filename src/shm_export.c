@@ -0,0 +1,199 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../include/shm_export.h"
+#include "../include/log.h"
+
+static pthread_mutex_t export_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t export_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_t export_thread;
+static int export_running = 0;
+static NetdiagShmSegment *segment = NULL;
+static char segment_name[64];
+
+// Seqlock write side. export_lock serializes writers (sampler thread and
+// speed test handlers); readers never take it.
+static void begin_update() {
+    pthread_mutex_lock(&export_lock);
+    uint64_t sequence = atomic_load_explicit(&segment->sequence, memory_order_relaxed);
+    atomic_store_explicit(&segment->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void end_update() {
+    segment->stats.updated_at = time(NULL);
+    uint64_t sequence = atomic_load_explicit(&segment->sequence, memory_order_relaxed);
+    atomic_store_explicit(&segment->sequence, sequence + 1, memory_order_release);
+    pthread_mutex_unlock(&export_lock);
+}
+
+void shm_export_speed_test(const SpeedTestResult *result) {
+    if (!segment)
+        return;
+
+    begin_update();
+    segment->stats.speed_test_time = result->test_time;
+    segment->stats.download_mbps = result->download_mbps;
+    segment->stats.upload_mbps = result->upload_mbps;
+    segment->stats.ping_ms = result->ping_ms;
+    end_update();
+}
+
+typedef struct {
+    InterfaceCounters counters[MAX_INTERFACES];
+    int count;
+    struct timespec sampled_at;
+} CounterSample;
+
+static const InterfaceCounters *find_counters(const CounterSample *sample, const char *name) {
+    for (int i = 0; i < sample->count; i++) {
+        if (strcmp(sample->counters[i].name, name) == 0)
+            return &sample->counters[i];
+    }
+    return NULL;
+}
+
+// Addresses always fit; longer values are cut at the field size
+static void copy_field(char *out, size_t size, const char *value) {
+    size_t length = strnlen(value, size - 1);
+    memcpy(out, value, length);
+    out[length] = '\0';
+}
+
+static void publish_sample(const NetworkInfo *network, const CounterSample *current,
+                           const CounterSample *previous) {
+    double seconds = (current->sampled_at.tv_sec - previous->sampled_at.tv_sec) +
+                     (current->sampled_at.tv_nsec - previous->sampled_at.tv_nsec) / 1e9;
+
+    begin_update();
+    NetdiagStats *stats = &segment->stats;
+    copy_field(stats->ipv4, sizeof(stats->ipv4), network->ipv4);
+    copy_field(stats->ipv6, sizeof(stats->ipv6), network->ipv6);
+    copy_field(stats->gateway, sizeof(stats->gateway), network->gateway);
+    copy_field(stats->dns1, sizeof(stats->dns1), network->dns1);
+    copy_field(stats->dns2, sizeof(stats->dns2), network->dns2);
+
+    int count = current->count < NETDIAG_SHM_MAX_INTERFACES
+        ? current->count : NETDIAG_SHM_MAX_INTERFACES;
+    for (int i = 0; i < count; i++) {
+        const InterfaceCounters *counters = &current->counters[i];
+        const InterfaceCounters *before = find_counters(previous, counters->name);
+        NetdiagShmInterface *entry = &stats->interfaces[i];
+
+        snprintf(entry->name, sizeof(entry->name), "%s", counters->name);
+        entry->bytes_sent = counters->bytes_sent;
+        entry->bytes_recv = counters->bytes_recv;
+        entry->tx_bytes_per_sec = 0;
+        entry->rx_bytes_per_sec = 0;
+        // No rate for new interfaces or counters that went backwards
+        if (before && seconds > 0 && counters->bytes_sent >= before->bytes_sent &&
+            counters->bytes_recv >= before->bytes_recv) {
+            entry->tx_bytes_per_sec = (counters->bytes_sent - before->bytes_sent) / seconds;
+            entry->rx_bytes_per_sec = (counters->bytes_recv - before->bytes_recv) / seconds;
+        }
+    }
+    stats->interface_count = count;
+    end_update();
+}
+
+static void *export_loop(void *arg) {
+    (void)arg;
+    CounterSample samples[2];
+    int current = 0;
+
+    memset(samples, 0, sizeof(samples));
+
+    pthread_mutex_lock(&export_lock);
+    while (export_running) {
+        pthread_mutex_unlock(&export_lock);
+
+        // Collected outside the lock; only the copy into the segment is locked
+        NetworkInfo network;
+        memset(&network, 0, sizeof(network));
+        get_network_info(&network);
+
+        CounterSample *sample = &samples[current];
+        clock_gettime(CLOCK_MONOTONIC, &sample->sampled_at);
+        sample->count = get_interface_counters(sample->counters, MAX_INTERFACES);
+        if (sample->count < 0)
+            sample->count = 0;
+
+        publish_sample(&network, sample, &samples[current ^ 1]);
+        current ^= 1;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SHM_EXPORT_INTERVAL_MS % 1000 * 1000000L;
+        deadline.tv_sec += SHM_EXPORT_INTERVAL_MS / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+
+        pthread_mutex_lock(&export_lock);
+        while (export_running &&
+               pthread_cond_timedwait(&export_wakeup, &export_lock, &deadline) == 0)
+            ;
+    }
+    pthread_mutex_unlock(&export_lock);
+    return NULL;
+}
+
+int shm_export_start(const char *name) {
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        log_warn("shm_unavailable", "shm_open %s: %s", name, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(NetdiagShmSegment)) < 0) {
+        log_warn("shm_unavailable", "ftruncate %s: %s", name, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, sizeof(NetdiagShmSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        log_warn("shm_unavailable", "mmap %s: %s", name, strerror(errno));
+        return -1;
+    }
+
+    // Magic goes in last so readers never accept a half-initialized segment
+    segment = (NetdiagShmSegment *)map;
+    segment->magic = 0;
+    atomic_store(&segment->sequence, 0);
+    memset(&segment->stats, 0, sizeof(segment->stats));
+    segment->layout_version = NETDIAG_SHM_LAYOUT_VERSION;
+    segment->size = sizeof(NetdiagShmSegment);
+    segment->writer_pid = (uint32_t)getpid();
+    atomic_thread_fence(memory_order_release);
+    segment->magic = NETDIAG_SHM_MAGIC;
+    snprintf(segment_name, sizeof(segment_name), "%s", name);
+
+    export_running = 1;
+    if (pthread_create(&export_thread, NULL, export_loop, NULL) != 0) {
+        export_running = 0;
+        return -1;
+    }
+    log_info("shm_export_started", "name=%s bytes=%zu", name, sizeof(NetdiagShmSegment));
+    return 0;
+}
+
+void shm_export_stop() {
+    pthread_mutex_lock(&export_lock);
+    int was_running = export_running;
+    export_running = 0;
+    pthread_cond_broadcast(&export_wakeup);
+    pthread_mutex_unlock(&export_lock);
+
+    if (!was_running)
+        return;
+    pthread_join(export_thread, NULL);
+
+    munmap(segment, sizeof(NetdiagShmSegment));
+    segment = NULL;
+    shm_unlink(segment_name);
+}
@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+#include "../include/sockstat.h"
+
+#define SOCKSTAT_BUFFER_SIZE 32768
+#define SOCKSTAT_TIMEOUT_MS 1000
+
+static const char *state_names[SOCKSTAT_STATE_COUNT] = {
+    NULL, "established", "syn_sent", "syn_recv", "fin_wait1", "fin_wait2", "time_wait",
+    "close", "close_wait", "last_ack", "listen", "closing", "new_syn_recv",
+};
+
+const char* sockstat_state_name(int state) {
+    return state >= 0 && state < SOCKSTAT_STATE_COUNT ? state_names[state] : NULL;
+}
+
+void sockstat_reset(SockStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+static void format_endpoint(char *out, size_t size, int family, const uint32_t address[4],
+                            uint16_t port) {
+    char text[INET6_ADDRSTRLEN];
+    if (family == AF_INET6) {
+        inet_ntop(AF_INET6, address, text, sizeof(text));
+        snprintf(out, size, "[%s]:%u", text, ntohs(port));
+    } else {
+        inet_ntop(AF_INET, address, text, sizeof(text));
+        snprintf(out, size, "%s:%u", text, ntohs(port));
+    }
+}
+
+static uint32_t rank_key(const SockStatConnection *connection, size_t offset) {
+    uint32_t value;
+    memcpy(&value, (const char *)connection + offset, sizeof(value));
+    return value;
+}
+
+static int ranks(const SockStatConnection top[], int count, uint32_t value, size_t offset) {
+    return value > 0 && (count < SOCKSTAT_TOP_N || value > rank_key(&top[count - 1], offset));
+}
+
+// Insertion into a descending fixed-size table; the smallest entry falls off
+static void rank(SockStatConnection top[], int *count, const SockStatConnection *candidate,
+                 size_t offset) {
+    uint32_t value = rank_key(candidate, offset);
+    int slot = *count < SOCKSTAT_TOP_N ? (*count)++ : SOCKSTAT_TOP_N - 1;
+    while (slot > 0 && rank_key(&top[slot - 1], offset) < value) {
+        top[slot] = top[slot - 1];
+        slot--;
+    }
+    top[slot] = *candidate;
+}
+
+int sockstat_account(SockStats *stats, int protocol, const void *message, size_t length) {
+    struct nlmsghdr header;
+    struct inet_diag_msg diag;
+    const size_t diag_offset = NLMSG_HDRLEN;
+    const size_t attrs_offset = NLMSG_HDRLEN + NLMSG_ALIGN(sizeof(diag));
+
+    if (length < diag_offset + sizeof(diag))
+        return -1;
+    memcpy(&header, message, sizeof(header));
+    if (header.nlmsg_len < diag_offset + sizeof(diag) || header.nlmsg_len > length)
+        return -1;
+    memcpy(&diag, (const char *)message + diag_offset, sizeof(diag));
+
+    SockStatCounts *counts = protocol == IPPROTO_TCP ? &stats->tcp : &stats->udp;
+    counts->total++;
+    if (diag.idiag_state < SOCKSTAT_STATE_COUNT)
+        counts->states[diag.idiag_state]++;
+    if (protocol != IPPROTO_TCP)
+        return 0;
+
+    // tcp_info grows with kernel versions: take what this kernel sent and
+    // leave newer fields zero
+    struct tcp_info info;
+    int have_info = 0;
+    memset(&info, 0, sizeof(info));
+    const char *attr = (const char *)message + attrs_offset;
+    size_t remaining = header.nlmsg_len > attrs_offset ? header.nlmsg_len - attrs_offset : 0;
+    while (remaining >= sizeof(struct rtattr)) {
+        struct rtattr rta;
+        memcpy(&rta, attr, sizeof(rta));
+        if (rta.rta_len < sizeof(rta) || rta.rta_len > remaining)
+            return -1;
+        if (rta.rta_type == INET_DIAG_INFO) {
+            size_t payload = rta.rta_len - RTA_LENGTH(0);
+            memcpy(&info, attr + RTA_LENGTH(0), payload < sizeof(info) ? payload : sizeof(info));
+            have_info = 1;
+            break;
+        }
+        size_t step = RTA_ALIGN(rta.rta_len);
+        if (step >= remaining)
+            break;
+        attr += step;
+        remaining -= step;
+    }
+    if (!have_info)
+        return 0;
+
+    stats->tcp_retransmits += info.tcpi_total_retrans;
+
+    // Addresses are formatted only for sockets that make it into a table
+    const size_t by_retransmits = offsetof(SockStatConnection, retransmits);
+    const size_t by_rtt = offsetof(SockStatConnection, rtt_us);
+    int rank_retransmits = ranks(stats->top_retransmits, stats->top_retransmits_count,
+                                 info.tcpi_total_retrans, by_retransmits);
+    // Listeners and half-open sockets have no RTT sample worth ranking
+    int rank_rtt = diag.idiag_state == TCP_ESTABLISHED &&
+                   ranks(stats->top_rtt, stats->top_rtt_count, info.tcpi_rtt, by_rtt);
+    if (!rank_retransmits && !rank_rtt)
+        return 0;
+
+    SockStatConnection connection;
+    format_endpoint(connection.local, sizeof(connection.local), diag.idiag_family,
+                    diag.id.idiag_src, diag.id.idiag_sport);
+    format_endpoint(connection.remote, sizeof(connection.remote), diag.idiag_family,
+                    diag.id.idiag_dst, diag.id.idiag_dport);
+    connection.state = diag.idiag_state;
+    connection.retransmits = info.tcpi_total_retrans;
+    connection.rtt_us = info.tcpi_rtt;
+    connection.rttvar_us = info.tcpi_rttvar;
+    connection.unacked = info.tcpi_unacked;
+
+    if (rank_retransmits)
+        rank(stats->top_retransmits, &stats->top_retransmits_count, &connection, by_retransmits);
+    if (rank_rtt)
+        rank(stats->top_rtt, &stats->top_rtt_count, &connection, by_rtt);
+    return 0;
+}
+
+// One SOCK_DIAG_BY_FAMILY dump, every reply accounted as it is received
+static int dump(int fd, SockStats *stats, uint8_t family, uint8_t protocol, uint32_t seq,
+                char *buffer) {
+    struct {
+        struct nlmsghdr header;
+        struct inet_diag_req_v2 request;
+    } message;
+    memset(&message, 0, sizeof(message));
+    message.header.nlmsg_len = sizeof(message);
+    message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    message.header.nlmsg_seq = seq;
+    message.request.sdiag_family = family;
+    message.request.sdiag_protocol = protocol;
+    message.request.idiag_states = ~0u;
+    if (protocol == IPPROTO_TCP)
+        message.request.idiag_ext = 1 << (INET_DIAG_INFO - 1);
+
+    if (send(fd, &message, sizeof(message), 0) != (ssize_t)sizeof(message))
+        return -1;
+
+    for (;;) {
+        ssize_t received = recv(fd, buffer, SOCKSTAT_BUFFER_SIZE, MSG_TRUNC);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received < 0 || received > SOCKSTAT_BUFFER_SIZE)
+            return -1;
+
+        size_t remaining = (size_t)received;
+        for (struct nlmsghdr *header = (struct nlmsghdr *)buffer;
+             NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_seq != seq)
+                continue;
+            if (header->nlmsg_type == NLMSG_DONE)
+                return 0;
+            if (header->nlmsg_type == NLMSG_ERROR)
+                return -1;
+            if (sockstat_account(stats, protocol, header, header->nlmsg_len) < 0)
+                return -1;
+        }
+    }
+}
+
+int sockstat_collect(SockStats *stats) {
+    static const struct {
+        uint8_t family;
+        uint8_t protocol;
+    } dumps[] = {
+        { AF_INET, IPPROTO_TCP },
+        { AF_INET6, IPPROTO_TCP },
+        { AF_INET, IPPROTO_UDP },
+        { AF_INET6, IPPROTO_UDP },
+    };
+
+    sockstat_reset(stats);
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    char *buffer = malloc(SOCKSTAT_BUFFER_SIZE);
+    if (fd < 0 || buffer == NULL) {
+        if (fd >= 0)
+            close(fd);
+        free(buffer);
+        return -1;
+    }
+
+    struct timeval timeout = { SOCKSTAT_TIMEOUT_MS / 1000, (SOCKSTAT_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // A kernel without IPv6 (or UDP diag) fails only its own dumps
+    int succeeded = 0;
+    for (size_t i = 0; i < sizeof(dumps) / sizeof(dumps[0]); i++) {
+        if (dump(fd, stats, dumps[i].family, dumps[i].protocol, (uint32_t)i + 1, buffer) == 0)
+            succeeded++;
+    }
+
+    free(buffer);
+    close(fd);
+    return succeeded > 0 ? 0 : -1;
+}
+
+static void write_connections(Emitter *out, const char *key, const SockStatConnection top[],
+                              int count) {
+    emit_begin_array(out, key);
+    for (int i = 0; i < count; i++) {
+        const SockStatConnection *connection = &top[i];
+        const char *state = sockstat_state_name(connection->state);
+        emit_begin_object(out, NULL);
+        emit_string(out, "local", connection->local);
+        emit_string(out, "remote", connection->remote);
+        emit_string(out, "state", state ? state : "unknown");
+        emit_uint(out, "retransmits", connection->retransmits);
+        emit_uint(out, "rtt_us", connection->rtt_us);
+        emit_uint(out, "rttvar_us", connection->rttvar_us);
+        emit_uint(out, "unacked", connection->unacked);
+        emit_end_object(out);
+    }
+    emit_end_array(out);
+}
+
+void sockstat_write(Emitter *out, const SockStats *stats) {
+    emit_begin_object(out, NULL);
+
+    emit_begin_object(out, "tcp");
+    emit_uint(out, "total", stats->tcp.total);
+    emit_uint(out, "retransmits", stats->tcp_retransmits);
+    emit_begin_object(out, "states");
+    for (int state = 1; state < SOCKSTAT_STATE_COUNT; state++)
+        emit_uint(out, state_names[state], stats->tcp.states[state]);
+    emit_end_object(out);
+    emit_end_object(out);
+
+    // UDP sockets only report whether they are connected
+    emit_begin_object(out, "udp");
+    emit_uint(out, "total", stats->udp.total);
+    emit_uint(out, "connected", stats->udp.states[TCP_ESTABLISHED]);
+    emit_uint(out, "unconnected", stats->udp.states[TCP_CLOSE]);
+    emit_end_object(out);
+
+    write_connections(out, "top_retransmits", stats->top_retransmits,
+                      stats->top_retransmits_count);
+    write_connections(out, "top_rtt", stats->top_rtt, stats->top_rtt_count);
+    emit_end_object(out);
+}
@@ -0,0 +1,325 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "../include/tzdb.h"
+
+#define TZ_MAX_LINK_HOPS 4
+
+void tz_index_init(TzIndex *index) {
+    memset(index, 0, sizeof(*index));
+}
+
+void tz_index_free(TzIndex *index) {
+    free(index->pool);
+    free(index->entries);
+    free(index->slots);
+    tz_index_init(index);
+}
+
+// Offset 0 is the empty string, so 0 can mean "none" in entries
+static uint32_t pool_add(TzIndex *index, const char *text) {
+    size_t length = strlen(text) + 1;
+    size_t reserved = index->pool_used ? 0 : 1;
+    if (index->pool_used + reserved + length > index->pool_capacity) {
+        size_t capacity = index->pool_capacity ? index->pool_capacity : 16384;
+        while (index->pool_used + reserved + length > capacity)
+            capacity *= 2;
+        char *pool = realloc(index->pool, capacity);
+        if (pool == NULL)
+            return 0;
+        index->pool = pool;
+        index->pool_capacity = capacity;
+    }
+    if (reserved)
+        index->pool[index->pool_used++] = '\0';
+
+    uint32_t offset = (uint32_t)index->pool_used;
+    memcpy(index->pool + offset, text, length);
+    index->pool_used += length;
+    return offset;
+}
+
+static TzEntry *entry_add(TzIndex *index) {
+    if (index->entry_count == index->entry_capacity) {
+        int capacity = index->entry_capacity ? index->entry_capacity * 2 : 512;
+        TzEntry *entries = realloc(index->entries, capacity * sizeof(TzEntry));
+        if (entries == NULL)
+            return NULL;
+        index->entries = entries;
+        index->entry_capacity = capacity;
+    }
+    TzEntry *entry = &index->entries[index->entry_count++];
+    memset(entry, 0, sizeof(*entry));
+    return entry;
+}
+
+// One ISO 6709 component: sign, degrees, minutes and optional seconds
+static int parse_angle(const char *text, size_t length, int degree_digits, double *out) {
+    if ((length != (size_t)(1 + degree_digits + 2) && length != (size_t)(1 + degree_digits + 4)) ||
+        (text[0] != '+' && text[0] != '-'))
+        return -1;
+    for (size_t i = 1; i < length; i++) {
+        if (!isdigit((unsigned char)text[i]))
+            return -1;
+    }
+
+    int degrees = 0, minutes, seconds = 0;
+    for (int i = 1; i <= degree_digits; i++)
+        degrees = degrees * 10 + (text[i] - '0');
+    minutes = (text[degree_digits + 1] - '0') * 10 + (text[degree_digits + 2] - '0');
+    if (length == (size_t)(1 + degree_digits + 4))
+        seconds = (text[degree_digits + 3] - '0') * 10 + (text[degree_digits + 4] - '0');
+
+    *out = (degrees + minutes / 60.0 + seconds / 3600.0) * (text[0] == '-' ? -1 : 1);
+    return 0;
+}
+
+// "+4230+00131" or "+404251-0740023"
+static int parse_coordinates(const char *text, double *latitude, double *longitude) {
+    const char *split = strpbrk(text + 1, "+-");
+    if (split == NULL)
+        return -1;
+    return parse_angle(text, (size_t)(split - text), 2, latitude) == 0 &&
+           parse_angle(split, strlen(split), 3, longitude) == 0 ? 0 : -1;
+}
+
+static int is_country_code(const char *code) {
+    return strlen(code) == 2 && isupper((unsigned char)code[0]) && isupper((unsigned char)code[1]);
+}
+
+int tz_index_load_zones(TzIndex *index, FILE *fp) {
+    char line[512];
+    int added = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#')
+            continue;
+
+        // codes <TAB> coordinates <TAB> zone [<TAB> comments]
+        char *save = NULL;
+        char *codes = strtok_r(line, "\t\n", &save);
+        char *coordinates = strtok_r(NULL, "\t\n", &save);
+        char *zone = strtok_r(NULL, "\t\n", &save);
+        double latitude, longitude;
+        if (!codes || !coordinates || !zone || strlen(codes) < 2 ||
+            parse_coordinates(coordinates, &latitude, &longitude) < 0)
+            continue;
+
+        // The first code is the country the zone's location is in
+        char country[3] = { codes[0], codes[1], '\0' };
+        if (!is_country_code(country))
+            continue;
+
+        TzEntry *entry = entry_add(index);
+        uint32_t name = pool_add(index, zone);
+        if (entry == NULL || name == 0)
+            return -1;
+        entry->name = name;
+        memcpy(entry->country, country, sizeof(country));
+        entry->latitude = latitude;
+        entry->longitude = longitude;
+        added++;
+    }
+    return added;
+}
+
+int tz_index_load_countries(TzIndex *index, FILE *fp) {
+    char line[256];
+    int added = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#')
+            continue;
+
+        char *save = NULL;
+        char *code = strtok_r(line, "\t\n", &save);
+        char *name = strtok_r(NULL, "\t\n", &save);
+        if (!code || !name || !is_country_code(code))
+            continue;
+
+        uint32_t offset = pool_add(index, name);
+        if (offset == 0)
+            return -1;
+        index->countries[(code[0] - 'A') * 26 + (code[1] - 'A')] = offset;
+        added++;
+    }
+    return added;
+}
+
+int tz_index_load_links(TzIndex *index, FILE *fp) {
+    char line[512];
+    int added = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        // "L TARGET LINK"; zone and rule lines are much more common
+        if (line[0] != 'L' || line[1] != ' ')
+            continue;
+
+        char *save = NULL;
+        strtok_r(line, " \t\n", &save);
+        char *target = strtok_r(NULL, " \t\n", &save);
+        char *link = strtok_r(NULL, " \t\n", &save);
+        if (!target || !link)
+            continue;
+
+        TzEntry *entry = entry_add(index);
+        uint32_t name = pool_add(index, link);
+        uint32_t target_name = name ? pool_add(index, target) : 0;
+        if (entry == NULL || target_name == 0)
+            return -1;
+        entry->name = name;
+        entry->target = target_name;
+        added++;
+    }
+    return added;
+}
+
+// FNV-1a
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (; *name; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const TzEntry *find_entry(const TzIndex *index, const char *name) {
+    if (index->slots == NULL)
+        return NULL;
+    for (size_t slot = hash_name(name) & index->slot_mask;; slot = (slot + 1) & index->slot_mask) {
+        uint32_t entry = index->slots[slot];
+        if (entry == 0)
+            return NULL;
+        if (strcmp(index->pool + index->entries[entry - 1].name, name) == 0)
+            return &index->entries[entry - 1];
+    }
+}
+
+int tz_index_finish(TzIndex *index) {
+    // At most half full, so probe sequences stay short
+    size_t size = 64;
+    while (size < (size_t)index->entry_count * 2)
+        size *= 2;
+
+    free(index->slots);
+    index->slots = calloc(size, sizeof(uint32_t));
+    if (index->slots == NULL)
+        return -1;
+    index->slot_mask = size - 1;
+
+    // Zones are loaded first, so a link never shadows a zone of the same name
+    for (int i = 0; i < index->entry_count; i++) {
+        const char *name = index->pool + index->entries[i].name;
+        if (find_entry(index, name))
+            continue;
+        size_t slot = hash_name(name) & index->slot_mask;
+        while (index->slots[slot] != 0)
+            slot = (slot + 1) & index->slot_mask;
+        index->slots[slot] = (uint32_t)i + 1;
+    }
+    return 0;
+}
+
+static int load_file(TzIndex *index, const char *dir, const char *file,
+                     int (*load)(TzIndex *, FILE *)) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+    int result = load(index, fp);
+    fclose(fp);
+    return result;
+}
+
+int tz_index_open(TzIndex *index, const char *dir) {
+    tz_index_init(index);
+    if (load_file(index, dir, "zone1970.tab", tz_index_load_zones) <= 0) {
+        tz_index_free(index);
+        return -1;
+    }
+    // Without these, country names are missing and legacy names such as
+    // Asia/Calcutta do not resolve
+    load_file(index, dir, "iso3166.tab", tz_index_load_countries);
+    load_file(index, dir, "tzdata.zi", tz_index_load_links);
+
+    if (tz_index_finish(index) < 0) {
+        tz_index_free(index);
+        return -1;
+    }
+    return 0;
+}
+
+int tz_lookup(const TzIndex *index, const char *zone, TzLocation *out) {
+    const TzEntry *entry = find_entry(index, zone);
+    for (int hops = 0; entry && entry->target && hops < TZ_MAX_LINK_HOPS; hops++)
+        entry = find_entry(index, index->pool + entry->target);
+    // Links to zones zone1970.tab does not list (Etc/UTC) have no location
+    if (entry == NULL || entry->target)
+        return -1;
+
+    uint32_t country = index->countries[(entry->country[0] - 'A') * 26 + (entry->country[1] - 'A')];
+    out->zone = index->pool + entry->name;
+    memcpy(out->country_code, entry->country, sizeof(out->country_code));
+    out->country = country ? index->pool + country : NULL;
+    out->latitude = entry->latitude;
+    out->longitude = entry->longitude;
+    return 0;
+}
+
+// "/usr/share/zoneinfo/posix/Europe/Berlin" -> "Europe/Berlin"
+static int zone_from_path(const char *path, char *out, size_t size) {
+    const char *name = strstr(path, "zoneinfo/");
+    if (name == NULL)
+        return -1;
+    name += strlen("zoneinfo/");
+    if (strncmp(name, "posix/", 6) == 0 || strncmp(name, "right/", 6) == 0)
+        name += 6;
+    if (*name == '\0')
+        return -1;
+    snprintf(out, size, "%s", name);
+    return 0;
+}
+
+static int zone_from_link(const char *link, char *out, size_t size) {
+    char target[512];
+    ssize_t length = readlink(link, target, sizeof(target) - 1);
+    if (length <= 0)
+        return -1;
+    target[length] = '\0';
+    return zone_from_path(target, out, size);
+}
+
+void tz_system_zone(char *out, size_t size) {
+    const char *tz = getenv("TZ");
+    if (tz && *tz == ':')
+        tz++;
+    if (tz && *tz) {
+        if (*tz != '/') {
+            snprintf(out, size, "%s", tz);
+            return;
+        }
+        if (zone_from_path(tz, out, size) == 0 || zone_from_link(tz, out, size) == 0)
+            return;
+    }
+
+    if (zone_from_link("/etc/localtime", out, size) == 0)
+        return;
+
+    FILE *fp = fopen("/etc/timezone", "r");
+    if (fp) {
+        char line[128];
+        int found = fgets(line, sizeof(line), fp) != NULL;
+        fclose(fp);
+        if (found) {
+            line[strcspn(line, " \t\r\n")] = '\0';
+            if (line[0]) {
+                snprintf(out, size, "%s", line);
+                return;
+            }
+        }
+    }
+    snprintf(out, size, "UTC");
+}
@@ -0,0 +1,607 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "../include/uring.h"
+#include "../include/log.h"
+
+// Operation tags in the low bits of user_data; the rest is the connection
+typedef enum {
+    OP_ACCEPT = 1,
+    OP_RECV,
+    OP_RECV_TIMEOUT,
+    OP_SEND,
+    OP_CLOSE,
+    OP_TICK,
+    OP_CANCEL,
+    OP_REJECT_SEND,                 // These two carry the socket instead of a connection
+    OP_REJECT_CLOSE
+} UringOp;
+#define OP_MASK 15ULL
+
+// Sent when no connection slot is free; the request is never read
+static const char busy_response[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 11\r\n"
+    "Retry-After: 1\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Server busy";
+
+typedef struct UringConnection {
+    struct UringConnection *next;   // Free-list link while the slot is unused
+    ClientConnection *client;       // Until the request is handled or queued
+    int fd;
+    int pending;                    // Submitted operations not yet completed
+    int finished;                   // The socket is closed or belongs to someone else
+    int in_use;
+    struct msghdr message;
+    ResponseCapture capture;
+    Arena overflow;                 // Responses that do not fit send_buffer
+    _Alignas(16) char send_buffer[URING_SEND_BUFFER];
+} UringConnection;
+
+typedef struct {
+    int fd;
+    unsigned entries;
+    _Atomic unsigned *sq_head;
+    _Atomic unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    _Atomic unsigned *cq_head;
+    _Atomic unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;                  // Same mapping as sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned to_submit;
+} Ring;
+
+typedef struct {
+    Ring ring;
+    struct io_uring_buf_ring *buffer_ring;
+    size_t buffer_ring_size;
+    char *buffers;                  // URING_BUFFERS receive buffers of MAX_BUFFER_SIZE
+    UringConnection *connections;
+    UringConnection *free_connections;
+    int active;                     // Connections in use
+    int accept_armed;
+    int tick_armed;
+    struct __kernel_timespec tick;
+    struct __kernel_timespec read_timeout;
+} UringServer;
+
+static int ring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int ring_register(int fd, unsigned opcode, const void *arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static void ring_close(Ring *ring) {
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static int ring_open(Ring *ring, unsigned entries) {
+    memset(ring, 0, sizeof(*ring));
+    struct io_uring_params params;
+
+    // The loop is the only submitter and reaps its own completions, which
+    // lets the kernel skip cross-thread wakeups; older kernels reject these
+#ifdef IORING_SETUP_SINGLE_ISSUER
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    ring->fd = ring_setup(entries, &params);
+#else
+    ring->fd = -1;
+#endif
+    if (ring->fd < 0) {
+        memset(&params, 0, sizeof(params));
+        ring->fd = ring_setup(entries, &params);
+    }
+    if (ring->fd < 0)
+        return -1;
+
+    ring->entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size)
+        ring->sq_ring_size = ring->cq_ring_size;
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        ring_close(ring);
+        return -1;
+    }
+    ring->cq_ring = single_mmap ? ring->sq_ring
+                                : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED) {
+        ring->cq_ring = NULL;
+        ring_close(ring);
+        return -1;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        ring_close(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring, *cq = ring->cq_ring;
+    ring->sq_head = (_Atomic unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (_Atomic unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (_Atomic unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (_Atomic unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+static int ring_submit(Ring *ring, unsigned wait_for) {
+    for (;;) {
+        int result = ring_enter(ring->fd, ring->to_submit, wait_for,
+                                wait_for ? IORING_ENTER_GETEVENTS : 0);
+        if (result >= 0) {
+            ring->to_submit -= (unsigned)result < ring->to_submit ? (unsigned)result : ring->to_submit;
+            return 0;
+        }
+        if (errno != EINTR)
+            return -1;
+        if (ring->to_submit == 0)
+            return 0;
+    }
+}
+
+// A zeroed SQE, submitting queued ones first if the queue is full
+static struct io_uring_sqe* ring_get_sqe(Ring *ring) {
+    unsigned tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(ring->sq_head, memory_order_acquire) >= ring->entries) {
+        if (ring_submit(ring, 0) < 0)
+            return NULL;
+    }
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    atomic_store_explicit(ring->sq_tail, tail + 1, memory_order_release);
+    ring->to_submit++;
+    return sqe;
+}
+
+static uint64_t user_data(UringConnection *connection, UringOp op) {
+    return (uint64_t)(uintptr_t)connection | op;
+}
+
+static void buffer_recycle(UringServer *server, unsigned short id) {
+    struct io_uring_buf_ring *ring = server->buffer_ring;
+    unsigned short tail = atomic_load_explicit((_Atomic unsigned short *)&ring->tail,
+                                               memory_order_relaxed);
+    struct io_uring_buf *buffer = &ring->bufs[tail & (URING_BUFFERS - 1)];
+    buffer->addr = (uint64_t)(uintptr_t)(server->buffers + (size_t)id * MAX_BUFFER_SIZE);
+    buffer->len = MAX_BUFFER_SIZE;
+    buffer->bid = id;
+    atomic_store_explicit((_Atomic unsigned short *)&ring->tail, (unsigned short)(tail + 1),
+                          memory_order_release);
+}
+
+static int buffers_register(UringServer *server) {
+    server->buffer_ring_size = URING_BUFFERS * sizeof(struct io_uring_buf);
+    server->buffer_ring = mmap(NULL, server->buffer_ring_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (server->buffer_ring == MAP_FAILED) {
+        server->buffer_ring = NULL;
+        return -1;
+    }
+    server->buffers = malloc((size_t)URING_BUFFERS * MAX_BUFFER_SIZE);
+    if (server->buffers == NULL)
+        return -1;
+
+    struct io_uring_buf_reg registration;
+    memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = (uint64_t)(uintptr_t)server->buffer_ring;
+    registration.ring_entries = URING_BUFFERS;
+    registration.bgid = 0;
+    if (ring_register(server->ring.fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+        return -1;
+
+    for (unsigned short id = 0; id < URING_BUFFERS; id++)
+        buffer_recycle(server, id);
+    return 0;
+}
+
+static int arm_accept(UringServer *server) {
+    struct io_uring_sqe *sqe = ring_get_sqe(&server->ring);
+    if (sqe == NULL)
+        return -1;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = 0;                            // Index of the listening socket
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = user_data(NULL, OP_ACCEPT);
+    server->accept_armed = 1;
+    return 0;
+}
+
+static int arm_tick(UringServer *server) {
+    struct io_uring_sqe *sqe = ring_get_sqe(&server->ring);
+    if (sqe == NULL)
+        return -1;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (uint64_t)(uintptr_t)&server->tick;
+    sqe->len = 1;
+    sqe->user_data = user_data(NULL, OP_TICK);
+    server->tick_armed = 1;
+    return 0;
+}
+
+// A receive into a kernel-selected buffer, cancelled by its linked timeout
+// if the client sends nothing for CLIENT_READ_TIMEOUT_MS
+static int arm_recv(UringServer *server, UringConnection *connection) {
+    struct io_uring_sqe *recv_sqe = ring_get_sqe(&server->ring);
+    if (recv_sqe == NULL)
+        return -1;
+    recv_sqe->opcode = IORING_OP_RECV;
+    recv_sqe->fd = connection->fd;
+    recv_sqe->len = MAX_BUFFER_SIZE - 1;
+    recv_sqe->flags = IOSQE_BUFFER_SELECT | IOSQE_IO_LINK;
+    recv_sqe->buf_group = 0;
+    recv_sqe->user_data = user_data(connection, OP_RECV);
+    connection->pending++;
+
+    struct io_uring_sqe *timeout_sqe = ring_get_sqe(&server->ring);
+    if (timeout_sqe == NULL)
+        return -1;
+    timeout_sqe->opcode = IORING_OP_LINK_TIMEOUT;
+    timeout_sqe->addr = (uint64_t)(uintptr_t)&server->read_timeout;
+    timeout_sqe->len = 1;
+    timeout_sqe->user_data = user_data(connection, OP_RECV_TIMEOUT);
+    connection->pending++;
+    return 0;
+}
+
+// The captured response, then the close; the close only runs once the
+// whole response has been sent
+static int arm_send_close(UringServer *server, UringConnection *connection) {
+    if (connection->capture.iov_count > 0) {
+        struct io_uring_sqe *send_sqe = ring_get_sqe(&server->ring);
+        if (send_sqe == NULL)
+            return -1;
+        connection->message.msg_iov = connection->capture.iov;
+        connection->message.msg_iovlen = (size_t)connection->capture.iov_count;
+        send_sqe->opcode = IORING_OP_SENDMSG;
+        send_sqe->fd = connection->fd;
+        send_sqe->addr = (uint64_t)(uintptr_t)&connection->message;
+        send_sqe->len = 1;
+        send_sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        send_sqe->flags = IOSQE_IO_LINK;
+        send_sqe->user_data = user_data(connection, OP_SEND);
+        connection->pending++;
+    }
+
+    struct io_uring_sqe *close_sqe = ring_get_sqe(&server->ring);
+    if (close_sqe == NULL)
+        return -1;
+    close_sqe->opcode = IORING_OP_CLOSE;
+    close_sqe->fd = connection->fd;
+    close_sqe->user_data = user_data(connection, OP_CLOSE);
+    connection->pending++;
+    return 0;
+}
+
+// The 503 and the close, both without a connection slot
+static int arm_reject(UringServer *server, int client_fd) {
+    struct io_uring_sqe *send_sqe = ring_get_sqe(&server->ring);
+    if (send_sqe == NULL)
+        return -1;
+    struct io_uring_sqe *close_sqe = ring_get_sqe(&server->ring);
+    if (close_sqe == NULL) {
+        // The entry is claimed already; let it complete as a no-op
+        send_sqe->opcode = IORING_OP_NOP;
+        send_sqe->user_data = user_data(NULL, OP_CANCEL);
+        return -1;
+    }
+    send_sqe->opcode = IORING_OP_SEND;
+    send_sqe->fd = client_fd;
+    send_sqe->addr = (uint64_t)(uintptr_t)busy_response;
+    send_sqe->len = sizeof(busy_response) - 1;
+    send_sqe->msg_flags = MSG_NOSIGNAL;
+    send_sqe->flags = IOSQE_IO_LINK;
+    send_sqe->user_data = ((uint64_t)client_fd << 4) | OP_REJECT_SEND;
+    close_sqe->opcode = IORING_OP_CLOSE;
+    close_sqe->fd = client_fd;
+    close_sqe->user_data = ((uint64_t)client_fd << 4) | OP_REJECT_CLOSE;
+    return 0;
+}
+
+static void connection_free(UringServer *server, UringConnection *connection) {
+    arena_reset(&connection->overflow);
+    connection->in_use = 0;
+    connection->next = server->free_connections;
+    server->free_connections = connection;
+    server->active--;
+}
+
+// Frees the slot once nothing refers to it any more
+static void connection_settle(UringServer *server, UringConnection *connection) {
+    if (connection->finished && connection->pending == 0)
+        connection_free(server, connection);
+}
+
+static void connection_abort(UringConnection *connection) {
+    if (connection->client) {
+        client_connection_release(connection->client);
+        connection->client = NULL;
+    }
+    close(connection->fd);
+    connection->finished = 1;
+}
+
+static void on_accept(UringServer *server, struct io_uring_cqe *cqe, volatile int *running) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        server->accept_armed = 0;
+        if (*running && arm_accept(server) < 0)
+            log_error("io_uring_accept_failed", "Cannot re-arm accept");
+    }
+    if (cqe->res < 0) {
+        if (cqe->res != -ECANCELED)
+            log_warn("accept_failed", "accept: %s", strerror(-cqe->res));
+        return;
+    }
+
+    int client_fd = cqe->res;
+    UringConnection *connection = server->free_connections;
+    ClientConnection *client = connection ? client_connection_acquire(client_fd, 0) : NULL;
+    if (client == NULL) {
+        // Not read yet, so there is no route to account it to
+        if (arm_reject(server, client_fd) < 0)
+            close(client_fd);
+        return;
+    }
+    server->free_connections = connection->next;
+    server->active++;
+    connection->client = client;
+    connection->fd = client_fd;
+    connection->pending = 0;
+    connection->finished = 0;
+    connection->in_use = 1;
+    if (arm_recv(server, connection) < 0)
+        connection_abort(connection);
+}
+
+static void on_recv(UringServer *server, UringConnection *connection, struct io_uring_cqe *cqe) {
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned short id = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe->res > 0)
+            memcpy(connection->client->buffer, server->buffers + (size_t)id * MAX_BUFFER_SIZE,
+                   (size_t)cqe->res);
+        buffer_recycle(server, id);
+    }
+    if (cqe->res == -ENOBUFS) {
+        // Every buffer is in use; the linked timeout was cancelled with it
+        if (arm_recv(server, connection) < 0)
+            connection_abort(connection);
+        return;
+    }
+    if (cqe->res <= 0) {
+        if (cqe->res < 0 && cqe->res != -ECANCELED)
+            log_warn("recv_failed", "recv: %s", strerror(-cqe->res));
+        connection_abort(connection);
+        return;
+    }
+
+    ClientConnection *client = connection->client;
+    connection->client = NULL;
+    client_connection_parse(client, (size_t)cqe->res);
+
+    // Rejections are captured too, and sent below like any response
+    int handled = 0;
+    int detached = 0;
+    server_capture_responses(&connection->capture);
+    if (client_connection_route(client)) {
+        if (client_connection_blocks(client)) {
+            client_connection_defer(client);
+        } else {
+            handled = 1;
+            detached = handle_client_request(client);
+            client_connection_release(client);
+        }
+    }
+    server_capture_responses(NULL);
+    arena_reset(server_request_arena());
+
+    // Queued on a lane, or an event stream that now belongs to the event hub
+    connection->finished = 1;
+    if (detached || (!handled && connection->capture.iov_count == 0))
+        return;
+    if (arm_send_close(server, connection) < 0)
+        close(connection->fd);
+}
+
+static void on_completion(UringServer *server, struct io_uring_cqe *cqe, volatile int *running) {
+    UringOp op = (UringOp)(cqe->user_data & OP_MASK);
+    UringConnection *connection = (UringConnection *)(uintptr_t)(cqe->user_data & ~OP_MASK);
+
+    switch (op) {
+        case OP_ACCEPT:
+            on_accept(server, cqe, running);
+            return;
+        case OP_TICK:
+            server->tick_armed = 0;
+            if (*running)
+                arm_tick(server);
+            return;
+        case OP_CANCEL:
+            return;
+        case OP_REJECT_SEND:
+            return;
+        case OP_REJECT_CLOSE:
+            if (cqe->res == -ECANCELED)
+                close((int)(cqe->user_data >> 4));
+            return;
+        default:
+            break;
+    }
+
+    connection->pending--;
+    switch (op) {
+        case OP_RECV:
+            on_recv(server, connection, cqe);
+            break;
+        case OP_SEND:
+            if (cqe->res < 0 && cqe->res != -EPIPE && cqe->res != -ECONNRESET)
+                log_debug("send_failed", "send: %s", strerror(-cqe->res));
+            break;
+        case OP_CLOSE:
+            // Cancelled because the send before it failed or was short
+            if (cqe->res == -ECANCELED)
+                close(connection->fd);
+            break;
+        default:
+            break;
+    }
+    connection_settle(server, connection);
+}
+
+static int reap(UringServer *server, volatile int *running) {
+    Ring *ring = &server->ring;
+    unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+    int reaped = 0;
+    for (; head != tail; head++, reaped++) {
+        struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+        // Free the slot first: handlers may submit more work
+        atomic_store_explicit(ring->cq_head, head + 1, memory_order_release);
+        on_completion(server, &cqe, running);
+    }
+    return reaped;
+}
+
+// Stops accepting, wakes connections still waiting for a request and lets
+// every submitted operation complete before the memory it uses is freed
+static void drain(UringServer *server) {
+    volatile int stopped = 0;
+    if (server->accept_armed) {
+        struct io_uring_sqe *sqe = ring_get_sqe(&server->ring);
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = user_data(NULL, OP_ACCEPT);
+            sqe->user_data = user_data(NULL, OP_CANCEL);
+        }
+    }
+    for (int i = 0; i < URING_CONNECTIONS; i++) {
+        UringConnection *connection = &server->connections[i];
+        if (connection->in_use && connection->client)
+            shutdown(connection->fd, SHUT_RDWR);
+    }
+
+    while (server->active > 0 || server->accept_armed || server->tick_armed) {
+        if (ring_submit(&server->ring, 1) < 0)
+            break;
+        reap(server, &stopped);
+    }
+}
+
+static void server_free(UringServer *server) {
+    ring_close(&server->ring);
+    if (server->buffer_ring)
+        munmap(server->buffer_ring, server->buffer_ring_size);
+    free(server->buffers);
+    if (server->connections) {
+        for (int i = 0; i < URING_CONNECTIONS; i++)
+            arena_destroy(&server->connections[i].overflow);
+    }
+    free(server->connections);
+}
+
+int uring_serve(int listen_fd, volatile int *running) {
+    UringServer server;
+    memset(&server, 0, sizeof(server));
+    server.tick.tv_nsec = URING_TICK_MS * 1000000LL;
+    server.read_timeout.tv_sec = CLIENT_READ_TIMEOUT_MS / 1000;
+    server.read_timeout.tv_nsec = (CLIENT_READ_TIMEOUT_MS % 1000) * 1000000LL;
+
+    if (ring_open(&server.ring, URING_ENTRIES) < 0) {
+        log_warn("io_uring_unavailable", "io_uring_setup: %s", strerror(errno));
+        return -1;
+    }
+    if (buffers_register(&server) < 0 ||
+        ring_register(server.ring.fd, IORING_REGISTER_FILES, &listen_fd, 1) < 0) {
+        log_warn("io_uring_unavailable", "io_uring_register: %s", strerror(errno));
+        server_free(&server);
+        return -1;
+    }
+
+    server.connections = calloc(URING_CONNECTIONS, sizeof(UringConnection));
+    if (server.connections == NULL) {
+        server_free(&server);
+        return -1;
+    }
+    for (int i = URING_CONNECTIONS - 1; i >= 0; i--) {
+        UringConnection *connection = &server.connections[i];
+        connection->capture.buffer = connection->send_buffer;
+        connection->capture.capacity = sizeof(connection->send_buffer);
+        connection->capture.overflow = &connection->overflow;
+        if (arena_init(&connection->overflow, URING_OVERFLOW_ARENA) < 0) {
+            server_free(&server);
+            return -1;
+        }
+        connection->next = server.free_connections;
+        server.free_connections = connection;
+    }
+
+    if (arm_accept(&server) < 0 || arm_tick(&server) < 0) {
+        server_free(&server);
+        return -1;
+    }
+    log_info("io_backend", "Serving with io_uring");
+
+    int result = 0;
+    while (*running) {
+        if (ring_submit(&server.ring, 1) < 0) {
+            log_error("io_uring_failed", "io_uring_enter: %s", strerror(errno));
+            result = -1;
+            break;
+        }
+        reap(&server, running);
+    }
+
+    drain(&server);
+    server_free(&server);
+    return result;
+}
@@ -0,0 +1,522 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/nl80211.h>
+#include "../include/wireless.h"
+#include "../include/log.h"
+
+#define NL_BUFFER_SIZE 32768
+#define NL_TIMEOUT_MS 1000
+
+typedef struct {
+    int fd;
+    uint16_t family;
+    uint32_t seq;
+    char *buffer;
+} Nl80211Socket;
+
+typedef int (*NlMessageFn)(const void *message, size_t length, void *ctx);
+
+static pthread_mutex_t wireless_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sampler_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_t sampler_thread;
+static int sampler_running = 0;
+static unsigned sampler_interval_ms = WIRELESS_SAMPLE_INTERVAL_MS;
+static WirelessSnapshot latest;
+static int have_latest = 0;
+
+// Attribute access. Fixtures and socket buffers are not guaranteed to be
+// aligned for struct nlattr, so headers and scalars are copied out.
+
+static uint16_t attr_length(const void *attr) {
+    struct nlattr header;
+    memcpy(&header, attr, sizeof(header));
+    return header.nla_len;
+}
+
+static const void *attr_data(const void *attr) {
+    return (const char *)attr + NLA_HDRLEN;
+}
+
+static size_t attr_payload(const void *attr) {
+    return attr_length(attr) - NLA_HDRLEN;
+}
+
+static uint32_t attr_u32(const void *attr) {
+    uint32_t value = 0;
+    if (attr_payload(attr) >= sizeof(value))
+        memcpy(&value, attr_data(attr), sizeof(value));
+    return value;
+}
+
+static uint16_t attr_u16(const void *attr) {
+    uint16_t value = 0;
+    if (attr_payload(attr) >= sizeof(value))
+        memcpy(&value, attr_data(attr), sizeof(value));
+    return value;
+}
+
+static int8_t attr_s8(const void *attr) {
+    int8_t value = 0;
+    if (attr_payload(attr) >= sizeof(value))
+        memcpy(&value, attr_data(attr), sizeof(value));
+    return value;
+}
+
+// Indexes a run of attributes by type; types above max are skipped
+static int parse_attributes(const void *data, size_t length, const void *table[], int max) {
+    memset(table, 0, sizeof(*table) * (max + 1));
+    while (length >= NLA_HDRLEN) {
+        struct nlattr header;
+        memcpy(&header, data, sizeof(header));
+        if (header.nla_len < NLA_HDRLEN || header.nla_len > length)
+            return -1;
+
+        int type = header.nla_type & NLA_TYPE_MASK;
+        if (type <= max)
+            table[type] = data;
+
+        size_t step = NLA_ALIGN(header.nla_len);
+        if (step >= length)
+            break;
+        data = (const char *)data + step;
+        length -= step;
+    }
+    return 0;
+}
+
+static int parse_nested(const void *attr, const void *table[], int max) {
+    return parse_attributes(attr_data(attr), attr_payload(attr), table, max);
+}
+
+// Locates the attributes of a generic-netlink message with the given command
+static int genl_attributes(const void *message, size_t length, uint8_t command,
+                           const void **attrs, size_t *attrs_length) {
+    struct nlmsghdr header;
+    struct genlmsghdr genl;
+    if (length < NLMSG_HDRLEN + GENL_HDRLEN)
+        return -1;
+    memcpy(&header, message, sizeof(header));
+    memcpy(&genl, (const char *)message + NLMSG_HDRLEN, sizeof(genl));
+    if (header.nlmsg_len < NLMSG_HDRLEN + GENL_HDRLEN || header.nlmsg_len > length ||
+        genl.cmd != command)
+        return -1;
+
+    *attrs = (const char *)message + NLMSG_HDRLEN + GENL_HDRLEN;
+    *attrs_length = header.nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN;
+    return 0;
+}
+
+int wireless_parse_interface(const void *message, size_t length, WirelessInterface *out) {
+    const void *data;
+    size_t data_length;
+    const void *attrs[NL80211_ATTR_SSID + 1];
+    if (genl_attributes(message, length, NL80211_CMD_NEW_INTERFACE, &data, &data_length) < 0 ||
+        parse_attributes(data, data_length, attrs, NL80211_ATTR_SSID) < 0)
+        return -1;
+
+    memset(out, 0, sizeof(*out));
+    if (attrs[NL80211_ATTR_IFINDEX])
+        out->ifindex = (int)attr_u32(attrs[NL80211_ATTR_IFINDEX]);
+    if (attrs[NL80211_ATTR_IFNAME]) {
+        size_t n = attr_payload(attrs[NL80211_ATTR_IFNAME]);
+        if (n >= sizeof(out->name))
+            n = sizeof(out->name) - 1;
+        memcpy(out->name, attr_data(attrs[NL80211_ATTR_IFNAME]), n);
+    }
+    if (attrs[NL80211_ATTR_IFTYPE])
+        out->iftype = (int)attr_u32(attrs[NL80211_ATTR_IFTYPE]);
+    // Only present while associated; not NUL-terminated
+    if (attrs[NL80211_ATTR_SSID]) {
+        size_t n = attr_payload(attrs[NL80211_ATTR_SSID]);
+        if (n >= sizeof(out->ssid))
+            n = sizeof(out->ssid) - 1;
+        memcpy(out->ssid, attr_data(attrs[NL80211_ATTR_SSID]), n);
+    }
+    return 0;
+}
+
+// Bitrates are reported in units of 100 kbit/s; the 32-bit attribute
+// replaced the 16-bit one, which overflows above 6.5 Gbit/s
+static int parse_bitrate(const void *attr, uint32_t *kbps) {
+    const void *rate[NL80211_RATE_INFO_BITRATE32 + 1];
+    if (parse_nested(attr, rate, NL80211_RATE_INFO_BITRATE32) < 0)
+        return -1;
+    if (rate[NL80211_RATE_INFO_BITRATE32])
+        *kbps = attr_u32(rate[NL80211_RATE_INFO_BITRATE32]) * 100;
+    else if (rate[NL80211_RATE_INFO_BITRATE])
+        *kbps = (uint32_t)attr_u16(rate[NL80211_RATE_INFO_BITRATE]) * 100;
+    else
+        return -1;
+    return 0;
+}
+
+int wireless_parse_station(const void *message, size_t length, WirelessStation *out) {
+    const void *data;
+    size_t data_length;
+    const void *attrs[NL80211_ATTR_STA_INFO + 1];
+    const void *info[NL80211_STA_INFO_CONNECTED_TIME + 1];
+    if (genl_attributes(message, length, NL80211_CMD_NEW_STATION, &data, &data_length) < 0 ||
+        parse_attributes(data, data_length, attrs, NL80211_ATTR_STA_INFO) < 0 ||
+        !attrs[NL80211_ATTR_STA_INFO] ||
+        parse_nested(attrs[NL80211_ATTR_STA_INFO], info, NL80211_STA_INFO_CONNECTED_TIME) < 0)
+        return -1;
+
+    memset(out, 0, sizeof(*out));
+    if (attrs[NL80211_ATTR_IFINDEX])
+        out->ifindex = (int)attr_u32(attrs[NL80211_ATTR_IFINDEX]);
+    if (attrs[NL80211_ATTR_MAC] && attr_payload(attrs[NL80211_ATTR_MAC]) >= 6) {
+        const unsigned char *mac = attr_data(attrs[NL80211_ATTR_MAC]);
+        snprintf(out->mac, sizeof(out->mac), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+
+    if (info[NL80211_STA_INFO_SIGNAL]) {
+        out->signal_dbm = attr_s8(info[NL80211_STA_INFO_SIGNAL]);
+        out->present |= WIRELESS_HAS_SIGNAL;
+    }
+    if (info[NL80211_STA_INFO_SIGNAL_AVG]) {
+        out->signal_avg_dbm = attr_s8(info[NL80211_STA_INFO_SIGNAL_AVG]);
+        out->present |= WIRELESS_HAS_SIGNAL_AVG;
+    }
+    if (info[NL80211_STA_INFO_TX_BITRATE] &&
+        parse_bitrate(info[NL80211_STA_INFO_TX_BITRATE], &out->tx_bitrate_kbps) == 0)
+        out->present |= WIRELESS_HAS_TX_BITRATE;
+    if (info[NL80211_STA_INFO_RX_BITRATE] &&
+        parse_bitrate(info[NL80211_STA_INFO_RX_BITRATE], &out->rx_bitrate_kbps) == 0)
+        out->present |= WIRELESS_HAS_RX_BITRATE;
+    if (info[NL80211_STA_INFO_TX_RETRIES]) {
+        out->tx_retries = attr_u32(info[NL80211_STA_INFO_TX_RETRIES]);
+        out->present |= WIRELESS_HAS_TX_RETRIES;
+    }
+    if (info[NL80211_STA_INFO_TX_FAILED]) {
+        out->tx_failed = attr_u32(info[NL80211_STA_INFO_TX_FAILED]);
+        out->present |= WIRELESS_HAS_TX_FAILED;
+    }
+    if (info[NL80211_STA_INFO_TX_PACKETS])
+        out->tx_packets = attr_u32(info[NL80211_STA_INFO_TX_PACKETS]);
+    if (info[NL80211_STA_INFO_RX_PACKETS])
+        out->rx_packets = attr_u32(info[NL80211_STA_INFO_RX_PACKETS]);
+    if (info[NL80211_STA_INFO_INACTIVE_TIME])
+        out->inactive_ms = attr_u32(info[NL80211_STA_INFO_INACTIVE_TIME]);
+    if (info[NL80211_STA_INFO_CONNECTED_TIME])
+        out->connected_s = attr_u32(info[NL80211_STA_INFO_CONNECTED_TIME]);
+    return 0;
+}
+
+// Sends a request with at most one attribute and passes every reply
+// message to fn until the kernel signals the end. Returns -1 on errors,
+// including an error reply.
+static int nl_transact(Nl80211Socket *sock, uint16_t type, uint16_t flags, uint8_t command,
+                       uint16_t attr_type, const void *attr, size_t attr_size,
+                       NlMessageFn fn, void *ctx) {
+    union {
+        struct nlmsghdr header;
+        char bytes[NLMSG_HDRLEN + GENL_HDRLEN + NLA_HDRLEN + 64];
+    } request;
+    if (attr_size > 64)
+        return -1;
+
+    memset(&request, 0, sizeof(request));
+    struct genlmsghdr *genl = (struct genlmsghdr *)(request.bytes + NLMSG_HDRLEN);
+    genl->cmd = command;
+    genl->version = 1;
+    size_t length = NLMSG_HDRLEN + GENL_HDRLEN;
+    if (attr) {
+        struct nlattr *header = (struct nlattr *)(request.bytes + length);
+        header->nla_type = attr_type;
+        header->nla_len = (uint16_t)(NLA_HDRLEN + attr_size);
+        memcpy(request.bytes + length + NLA_HDRLEN, attr, attr_size);
+        length += NLA_ALIGN(header->nla_len);
+    }
+    request.header.nlmsg_len = (uint32_t)length;
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | flags;
+    request.header.nlmsg_seq = ++sock->seq;
+
+    if (send(sock->fd, &request, length, 0) != (ssize_t)length)
+        return -1;
+
+    for (;;) {
+        ssize_t received = recv(sock->fd, sock->buffer, NL_BUFFER_SIZE, MSG_TRUNC);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received < 0 || received > NL_BUFFER_SIZE)
+            return -1;
+
+        size_t remaining = (size_t)received;
+        for (struct nlmsghdr *header = (struct nlmsghdr *)sock->buffer;
+             NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_seq != sock->seq)
+                continue;
+            if (header->nlmsg_type == NLMSG_DONE)
+                return 0;
+            if (header->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr *error = NLMSG_DATA(header);
+                return error->error == 0 ? 0 : -1;
+            }
+            if (fn(header, header->nlmsg_len, ctx) < 0)
+                return -1;
+            if (!(header->nlmsg_flags & NLM_F_MULTI))
+                return 0;
+        }
+    }
+}
+
+static int on_family(const void *message, size_t length, void *ctx) {
+    const void *data;
+    size_t data_length;
+    const void *attrs[CTRL_ATTR_FAMILY_ID + 1];
+    if (genl_attributes(message, length, CTRL_CMD_NEWFAMILY, &data, &data_length) == 0 &&
+        parse_attributes(data, data_length, attrs, CTRL_ATTR_FAMILY_ID) == 0 &&
+        attrs[CTRL_ATTR_FAMILY_ID])
+        *(uint16_t *)ctx = attr_u16(attrs[CTRL_ATTR_FAMILY_ID]);
+    return 0;
+}
+
+static void nl_close(Nl80211Socket *sock) {
+    if (sock->fd >= 0)
+        close(sock->fd);
+    free(sock->buffer);
+    sock->fd = -1;
+    sock->buffer = NULL;
+}
+
+// Opens a generic-netlink socket and resolves the nl80211 family id
+static int nl_open(Nl80211Socket *sock) {
+    memset(sock, 0, sizeof(*sock));
+    sock->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    sock->buffer = malloc(NL_BUFFER_SIZE);
+    if (sock->fd < 0 || sock->buffer == NULL) {
+        nl_close(sock);
+        return -1;
+    }
+
+    struct timeval timeout = { NL_TIMEOUT_MS / 1000, (NL_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(sock->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    static const char family_name[] = NL80211_GENL_NAME;
+    if (nl_transact(sock, GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY, CTRL_ATTR_FAMILY_NAME,
+                    family_name, sizeof(family_name), on_family, &sock->family) < 0 ||
+        sock->family == 0) {
+        nl_close(sock);
+        return -1;
+    }
+    return 0;
+}
+
+static int on_interface(const void *message, size_t length, void *ctx) {
+    WirelessSnapshot *snapshot = ctx;
+    WirelessInterface interface;
+    // Interfaces without a netdev (P2P device) have no index and no stations
+    if (wireless_parse_interface(message, length, &interface) == 0 && interface.ifindex > 0 &&
+        snapshot->interface_count < WIRELESS_MAX_INTERFACES)
+        snapshot->interfaces[snapshot->interface_count++] = interface;
+    return 0;
+}
+
+static int on_station(const void *message, size_t length, void *ctx) {
+    WirelessSnapshot *snapshot = ctx;
+    WirelessStation station;
+    if (wireless_parse_station(message, length, &station) == 0 &&
+        snapshot->station_count < WIRELESS_MAX_STATIONS)
+        snapshot->stations[snapshot->station_count++] = station;
+    return 0;
+}
+
+static int sample_with(Nl80211Socket *sock, WirelessSnapshot *out) {
+    memset(out, 0, sizeof(*out));
+    out->sampled_at = time(NULL);
+    if (nl_transact(sock, sock->family, NLM_F_DUMP, NL80211_CMD_GET_INTERFACE, 0, NULL, 0,
+                    on_interface, out) < 0)
+        return -1;
+
+    for (int i = 0; i < out->interface_count; i++) {
+        uint32_t ifindex = (uint32_t)out->interfaces[i].ifindex;
+        // An interface that disappeared in between only loses its stations
+        nl_transact(sock, sock->family, NLM_F_DUMP, NL80211_CMD_GET_STATION,
+                    NL80211_ATTR_IFINDEX, &ifindex, sizeof(ifindex), on_station, out);
+    }
+    return 0;
+}
+
+int wireless_sample(WirelessSnapshot *out) {
+    Nl80211Socket sock;
+    if (nl_open(&sock) < 0)
+        return -1;
+    int result = sample_with(&sock, out);
+    nl_close(&sock);
+    return result;
+}
+
+static void *sampler_loop(void *arg) {
+    (void)arg;
+    Nl80211Socket sock = { -1, 0, 0, NULL };
+    int failing = 0;
+
+    pthread_mutex_lock(&wireless_lock);
+    while (sampler_running) {
+        pthread_mutex_unlock(&wireless_lock);
+
+        // Reopened after any failure, e.g. when the driver was reloaded
+        WirelessSnapshot snapshot;
+        int ok = (sock.fd >= 0 || nl_open(&sock) == 0) && sample_with(&sock, &snapshot) == 0;
+        if (!ok) {
+            nl_close(&sock);
+            if (!failing)
+                log_warn("wireless_sample_failed", "nl80211 unavailable");
+        }
+        failing = !ok;
+
+        pthread_mutex_lock(&wireless_lock);
+        if (ok)
+            latest = snapshot;
+        have_latest = ok;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += sampler_interval_ms / 1000;
+        deadline.tv_nsec += (long)(sampler_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (sampler_running &&
+               pthread_cond_timedwait(&sampler_wakeup, &wireless_lock, &deadline) == 0)
+            ;
+    }
+    pthread_mutex_unlock(&wireless_lock);
+
+    nl_close(&sock);
+    return NULL;
+}
+
+int wireless_start_sampler(unsigned interval_ms) {
+    // Probe once so hosts without wireless support do not run a thread
+    WirelessSnapshot snapshot;
+    if (wireless_sample(&snapshot) < 0)
+        return -1;
+
+    pthread_mutex_lock(&wireless_lock);
+    if (sampler_running) {
+        pthread_mutex_unlock(&wireless_lock);
+        return 0;
+    }
+    latest = snapshot;
+    have_latest = 1;
+    sampler_interval_ms = interval_ms > 0 ? interval_ms : WIRELESS_SAMPLE_INTERVAL_MS;
+    sampler_running = 1;
+    pthread_mutex_unlock(&wireless_lock);
+
+    if (pthread_create(&sampler_thread, NULL, sampler_loop, NULL) != 0) {
+        sampler_running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void wireless_stop_sampler() {
+    pthread_mutex_lock(&wireless_lock);
+    int was_running = sampler_running;
+    sampler_running = 0;
+    have_latest = 0;
+    pthread_cond_broadcast(&sampler_wakeup);
+    pthread_mutex_unlock(&wireless_lock);
+
+    if (was_running)
+        pthread_join(sampler_thread, NULL);
+}
+
+int wireless_get_snapshot(WirelessSnapshot *out) {
+    pthread_mutex_lock(&wireless_lock);
+    if (sampler_running) {
+        int ok = have_latest;
+        if (ok)
+            *out = latest;
+        pthread_mutex_unlock(&wireless_lock);
+        return ok ? 0 : -1;
+    }
+    pthread_mutex_unlock(&wireless_lock);
+    return wireless_sample(out);
+}
+
+static const char *iftype_name(int iftype) {
+    switch (iftype) {
+        case NL80211_IFTYPE_STATION: return "station";
+        case NL80211_IFTYPE_AP: return "ap";
+        case NL80211_IFTYPE_ADHOC: return "adhoc";
+        case NL80211_IFTYPE_MONITOR: return "monitor";
+        case NL80211_IFTYPE_MESH_POINT: return "mesh_point";
+        case NL80211_IFTYPE_P2P_CLIENT: return "p2p_client";
+        case NL80211_IFTYPE_P2P_GO: return "p2p_go";
+        default: return "other";
+    }
+}
+
+static void write_station(Emitter *out, const WirelessStation *station) {
+    emit_begin_object(out, NULL);
+    emit_string(out, "mac", station->mac);
+    if (station->present & WIRELESS_HAS_SIGNAL)
+        emit_int(out, "signal_dbm", station->signal_dbm);
+    else
+        emit_null(out, "signal_dbm");
+    if (station->present & WIRELESS_HAS_SIGNAL_AVG)
+        emit_int(out, "signal_avg_dbm", station->signal_avg_dbm);
+    else
+        emit_null(out, "signal_avg_dbm");
+    if (station->present & WIRELESS_HAS_TX_BITRATE)
+        emit_number(out, "tx_bitrate_mbps", station->tx_bitrate_kbps / 1000.0);
+    else
+        emit_null(out, "tx_bitrate_mbps");
+    if (station->present & WIRELESS_HAS_RX_BITRATE)
+        emit_number(out, "rx_bitrate_mbps", station->rx_bitrate_kbps / 1000.0);
+    else
+        emit_null(out, "rx_bitrate_mbps");
+    emit_uint(out, "tx_packets", station->tx_packets);
+    emit_uint(out, "rx_packets", station->rx_packets);
+    if (station->present & WIRELESS_HAS_TX_RETRIES)
+        emit_uint(out, "tx_retries", station->tx_retries);
+    else
+        emit_null(out, "tx_retries");
+    if (station->present & WIRELESS_HAS_TX_FAILED)
+        emit_uint(out, "tx_failed", station->tx_failed);
+    else
+        emit_null(out, "tx_failed");
+    emit_uint(out, "inactive_ms", station->inactive_ms);
+    emit_uint(out, "connected_s", station->connected_s);
+    emit_end_object(out);
+}
+
+void wireless_write_snapshot(Emitter *out, const WirelessSnapshot *snapshot) {
+    emit_begin_object(out, NULL);
+    emit_int(out, "sampled_at", snapshot->sampled_at);
+    emit_begin_array(out, "interfaces");
+    for (int i = 0; i < snapshot->interface_count; i++) {
+        const WirelessInterface *interface = &snapshot->interfaces[i];
+        emit_begin_object(out, NULL);
+        emit_string(out, "interface", interface->name);
+        emit_string(out, "type", iftype_name(interface->iftype));
+        if (interface->ssid[0])
+            emit_string(out, "ssid", interface->ssid);
+        else
+            emit_null(out, "ssid");
+        emit_begin_array(out, "stations");
+        for (int j = 0; j < snapshot->station_count; j++) {
+            if (snapshot->stations[j].ifindex == interface->ifindex)
+                write_station(out, &snapshot->stations[j]);
+        }
+        emit_end_array(out);
+        emit_end_object(out);
+    }
+    emit_end_array(out);
+    emit_end_object(out);
+}
@@ -0,0 +1,249 @@
+// Build-time generator for the embedded web UI (see include/assets.h).
+//
+//     embed_assets OUTPUT.c WEB_ROOT FILE...
+//
+// FILE paths are relative to WEB_ROOT and become URL paths ("/" + FILE).
+// For each file it writes the bytes, a gzip variant when that is smaller,
+// the MIME type, a content-hash ETag and the complete response headers as
+// const data, sorted by path so the server can binary-search the table.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+
+typedef struct {
+    char path[512];
+    const char *content_type;
+    unsigned char *body;
+    size_t body_length;
+    unsigned char *gzip_body;
+    size_t gzip_length;
+    char etag[24];
+} Entry;
+
+static const struct {
+    const char *extension;
+    const char *content_type;
+} mime_types[] = {
+    { ".html", "text/html; charset=utf-8" },
+    { ".css", "text/css; charset=utf-8" },
+    { ".js", "application/javascript; charset=utf-8" },
+    { ".json", "application/json; charset=utf-8" },
+    { ".svg", "image/svg+xml" },
+    { ".png", "image/png" },
+    { ".jpg", "image/jpeg" },
+    { ".jpeg", "image/jpeg" },
+    { ".ico", "image/x-icon" },
+    { ".woff2", "font/woff2" },
+    { ".txt", "text/plain; charset=utf-8" },
+};
+
+static const char *mime_type(const char *path) {
+    const char *dot = strrchr(path, '.');
+    for (size_t i = 0; dot && i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+        if (strcmp(dot, mime_types[i].extension) == 0)
+            return mime_types[i].content_type;
+    }
+    return "application/octet-stream";
+}
+
+static unsigned char *read_file(const char *path, size_t *length) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+
+    size_t capacity = 65536, size = 0, n;
+    unsigned char *data = malloc(capacity);
+    while (data && (n = fread(data + size, 1, capacity - size, fp)) > 0) {
+        size += n;
+        if (size == capacity) {
+            unsigned char *grown = realloc(data, capacity *= 2);
+            if (!grown)
+                free(data);
+            data = grown;
+        }
+    }
+    fclose(fp);
+    *length = size;
+    return data;
+}
+
+// Maximum compression with a zeroed gzip header, so output is reproducible
+static unsigned char *gzip(const unsigned char *data, size_t length, size_t *out_length) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+
+    uLong capacity = deflateBound(&stream, length);
+    unsigned char *out = malloc(capacity);
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = (uInt)length;
+    stream.next_out = out;
+    stream.avail_out = (uInt)capacity;
+    if (!out || deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&stream);
+        free(out);
+        return NULL;
+    }
+    *out_length = stream.total_out;
+    deflateEnd(&stream);
+    return out;
+}
+
+// FNV-1a 64; only has to change when the content does
+static uint64_t content_hash(const unsigned char *data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void write_bytes(FILE *out, const char *name, const unsigned char *data, size_t length) {
+    fprintf(out, "static const unsigned char %s[] = {", name);
+    for (size_t i = 0; i < length; i++)
+        fprintf(out, "%s0x%02x,", i % 16 == 0 ? "\n    " : " ", data[i]);
+    // Empty files still need a valid initializer
+    fprintf(out, "%s\n};\n\n", length == 0 ? "\n    0" : "");
+}
+
+static void write_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const char *c = text; *c; c++) {
+        if (*c == '\r')
+            fputs("\\r", out);
+        else if (*c == '\n')
+            fputs("\\n\"\n    \"", out);
+        else if (*c == '"' || *c == '\\')
+            fprintf(out, "\\%c", *c);
+        else
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static size_t format_header(char *out, size_t size, const Entry *entry, int gzipped) {
+    return (size_t)snprintf(out, size,
+             "HTTP/1.1 200 OK\r\n"
+             "Content-Type: %s\r\n"
+             "Content-Length: %zu\r\n"
+             "%s"
+             "ETag: %s\r\n"
+             "Cache-Control: no-cache\r\n"
+             "Vary: Accept-Encoding\r\n"
+             "Access-Control-Allow-Origin: *\r\n"
+             "Connection: close\r\n"
+             "\r\n",
+             entry->content_type, gzipped ? entry->gzip_length : entry->body_length,
+             gzipped ? "Content-Encoding: gzip\r\n" : "", entry->etag);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const Entry *)a)->path, ((const Entry *)b)->path);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s OUTPUT.c WEB_ROOT FILE...\n", argv[0]);
+        return 1;
+    }
+
+    int count = argc - 3;
+    Entry *entries = calloc(count, sizeof(Entry));
+    if (!entries)
+        return 1;
+
+    for (int i = 0; i < count; i++) {
+        Entry *entry = &entries[i];
+        char file[1024];
+        snprintf(file, sizeof(file), "%s/%s", argv[2], argv[i + 3]);
+        snprintf(entry->path, sizeof(entry->path), "/%s", argv[i + 3]);
+
+        entry->body = read_file(file, &entry->body_length);
+        if (!entry->body) {
+            perror(file);
+            return 1;
+        }
+        entry->content_type = mime_type(entry->path);
+        snprintf(entry->etag, sizeof(entry->etag), "\"%016llx\"",
+                 (unsigned long long)content_hash(entry->body, entry->body_length));
+
+        entry->gzip_body = gzip(entry->body, entry->body_length, &entry->gzip_length);
+        if (entry->gzip_body && entry->gzip_length >= entry->body_length) {
+            free(entry->gzip_body);
+            entry->gzip_body = NULL;
+        }
+    }
+    qsort(entries, count, sizeof(Entry), compare_entries);
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by tools/embed_assets.c. Do not edit.\n\n");
+    fprintf(out, "#include \"assets.h\"\n\n");
+
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "asset_%d_body", i);
+        write_bytes(out, name, entries[i].body, entries[i].body_length);
+        if (entries[i].gzip_body) {
+            snprintf(name, sizeof(name), "asset_%d_gzip", i);
+            write_bytes(out, name, entries[i].gzip_body, entries[i].gzip_length);
+        }
+    }
+
+    fprintf(out, "const Asset embedded_assets[] = {\n");
+    for (int i = 0; i < count; i++) {
+        const Entry *entry = &entries[i];
+        char header[1024], gzip_header[1024], not_modified[512];
+        size_t header_length = format_header(header, sizeof(header), entry, 0);
+        size_t gzip_header_length = entry->gzip_body
+            ? format_header(gzip_header, sizeof(gzip_header), entry, 1) : 0;
+        size_t not_modified_length = (size_t)snprintf(not_modified, sizeof(not_modified),
+            "HTTP/1.1 304 Not Modified\r\n"
+            "ETag: %s\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Vary: Accept-Encoding\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Connection: close\r\n"
+            "\r\n", entry->etag);
+
+        fprintf(out, "    {\n        ");
+        write_string(out, entry->path);
+        fprintf(out, ",\n        ");
+        write_string(out, entry->content_type);
+        fprintf(out, ",\n        ");
+        write_string(out, entry->etag);
+        fprintf(out, ",\n        asset_%d_body, %zu,\n", i, entry->body_length);
+        if (entry->gzip_body)
+            fprintf(out, "        asset_%d_gzip, %zu,\n", i, entry->gzip_length);
+        else
+            fprintf(out, "        NULL, 0,\n");
+        fprintf(out, "        ");
+        write_string(out, header);
+        fprintf(out, ", %zu,\n        ", header_length);
+        if (entry->gzip_body)
+            write_string(out, gzip_header);
+        else
+            fprintf(out, "NULL");
+        fprintf(out, ", %zu,\n        ", gzip_header_length);
+        write_string(out, not_modified);
+        fprintf(out, ", %zu,\n    },\n", not_modified_length);
+    }
+    fprintf(out, "};\n\nconst size_t embedded_asset_count = %d;\n", count);
+
+    if (fclose(out) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -61,6 +61,22 @@ class API {
         return this.request('/interface-stats');
     }
 
+    /**
+     * Get network info, ISP info and interface statistics in one request.
+     * fields optionally limits the sections, e.g. ['network', 'interface'].
+     */
+    async getAll(fields = null) {
+        const query = fields ? `?fields=${fields.join(',')}` : '';
+        return this.request(`/all${query}`);
+    }
+
+    /**
+     * Open the server push channel (Server-Sent Events)
+     */
+    openEventStream() {
+        return new EventSource(`${this.baseUrl}/api/events`);
+    }
+
     /**
      * Perform speed test
      */
@@ -3,6 +3,7 @@
 class NetworkDiagnosticApp {
     constructor() {
         this.isTestingSpeed = false;
+        this.liveUpdates = false;
         this.init();
     }
 
@@ -12,6 +13,37 @@ class NetworkDiagnosticApp {
     async init() {
         this.setupEventListeners();
         await this.loadInitialData();
+        this.connectEventStream();
+    }
+
+    /**
+     * Subscribe to server push updates. While the stream is open the
+     * 30-second polling below is skipped; EventSource reconnects by itself.
+     */
+    connectEventStream() {
+        if (!window.EventSource) return;
+
+        const source = api.openEventStream();
+        source.onopen = () => { this.liveUpdates = true; };
+        source.onerror = () => { this.liveUpdates = false; };
+
+        source.addEventListener('network', (event) => {
+            ui.updateNetworkInfo(JSON.parse(event.data));
+        });
+        source.addEventListener('interface', (event) => {
+            const data = JSON.parse(event.data);
+            ui.updateInterfaceInfo(data);
+            ui.updateStats(data);
+        });
+        source.addEventListener('speed_test', (event) => {
+            const data = JSON.parse(event.data);
+            if (this.isTestingSpeed && data.phase !== 'complete') {
+                const text = data.mbps > 0
+                    ? `Testing ${data.phase}... ${Math.round(data.mbps * 10) / 10} Mbps`
+                    : `Testing ${data.phase}...`;
+                ui.updateProgress(data.percent, text);
+            }
+        });
     }
 
     /**
@@ -31,12 +63,12 @@ class NetworkDiagnosticApp {
         try {
             ui.showLoading(true);
 
-            // Load all data in parallel
-            await Promise.all([
-                this.loadNetworkInfo(),
-                this.loadISPInfo(),
-                this.loadInterfaceStats(),
-            ]);
+            // Load everything in one round trip; the server collects in parallel
+            const data = await api.getAll();
+            ui.updateNetworkInfo(data.network);
+            ui.updateISPInfo(data.isp);
+            ui.updateInterfaceInfo(data.interface);
+            ui.updateStats(data.interface);
 
             ui.showLoading(false);
         } catch (error) {
@@ -99,8 +131,9 @@ class NetworkDiagnosticApp {
         ui.updateProgress(0);
 
         try {
-            // Simulate test progress
+            // Real progress arrives over the event stream; simulate it otherwise
             const progressInterval = setInterval(() => {
+                if (this.liveUpdates) return;
                 const current = parseInt(ui.elements.progressFill.style.width) || 0;
                 if (current < 90) {
                     ui.updateProgress(current + Math.random() * 15);
@@ -140,9 +173,9 @@ document.addEventListener('DOMContentLoaded', () => {
     window.app = new NetworkDiagnosticApp();
 });
 
-// Auto-refresh data every 30 seconds
+// Auto-refresh data every 30 seconds when live updates are unavailable
 setInterval(() => {
-    if (window.app && !window.app.isTestingSpeed) {
+    if (window.app && !window.app.isTestingSpeed && !window.app.liveUpdates) {
         window.app.loadNetworkInfo();
         window.app.loadInterfaceStats();
     }